@@ -0,0 +1,367 @@
+#if !defined(BROADPHASE_H)
+
+// NOTE: uniform grid broad phase. Rebuilt from scratch every frame out of an AabbArray: every box is
+// counted into the cells it touches, a prefix sum turns the counts into cell offsets and a second pass
+// scatters the boxes (a counting sort by cell, two linear passes, no per cell lists). The scatter
+// also copies each box into cell order, so the pair tests walk memory front to back instead of jumping
+// around the AabbArray. Queries then only test boxes that share a cell.
+//
+// A pair that shares more than one cell is reported once, by the cell that holds the lower left corner
+// of the two boxes' intersection. Overlap is strict like rect_collide_rect, touching edges do not count.
+//
+// Everything, grid and results, is pushed onto the Arena passed in, reset it between frames.
+
+typedef struct AabbArray{
+    ui32 count;
+    f32 *min_x;
+    f32 *min_y;
+    f32 *max_x;
+    f32 *max_y;
+} AabbArray;
+
+typedef struct OverlapPair{
+    ui32 a;
+    ui32 b;
+} OverlapPair;
+
+// NOTE: one per box per cell it touches, ordered by cell. A copy of the box rather than an index, the
+// scatter writes one cache line per entry and the pair tests then read them in order.
+typedef struct SpatialGridEntry{
+    f32 min_x;
+    f32 min_y;
+    f32 max_x;
+    f32 max_y;
+    ui32 box;
+    ui32 first_cell; // NOTE: the lower left cell of the box, x | (y << 16)
+} SpatialGridEntry;
+
+typedef struct SpatialGrid{
+    AabbArray *boxes;
+    f32 origin_x;
+    f32 origin_y;
+    f32 cell_size;
+    f32 inv_cell_size;
+    i32 cells_x;
+    i32 cells_y;
+    ui32 *cell_start; // NOTE: cells_x * cells_y + 1 offsets into entries
+    SpatialGridEntry *entries;
+    ui32 entry_count;
+} SpatialGrid;
+
+// NOTE: more cells than this per box only costs memory and clearing time, 0xFFFF per axis fits
+// SpatialGridEntry.first_cell
+#define SPATIAL_GRID_CELLS_PER_BOX 2
+#define SPATIAL_GRID_MAX_CELLS_PER_AXIS 0xFFFF
+
+static bool
+aabb_array_init(AabbArray *boxes, Arena *arena, ui32 count){
+    boxes->count = count;
+    boxes->min_x = push_array(arena, f32, count);
+    boxes->min_y = push_array(arena, f32, count);
+    boxes->max_x = push_array(arena, f32, count);
+    boxes->max_y = push_array(arena, f32, count);
+    return(boxes->min_x && boxes->min_y && boxes->max_x && boxes->max_y);
+}
+
+static void
+aabb_array_set_rect(AabbArray *boxes, ui32 index, Rect r){
+    boxes->min_x[index] = r.x;
+    boxes->min_y[index] = r.y;
+    boxes->max_x[index] = r.x + r.w;
+    boxes->max_y[index] = r.y + r.h;
+}
+
+static bool
+aabb_overlap(AabbArray *boxes, ui32 a, ui32 b){
+    return((boxes->min_x[a] < boxes->max_x[b]) && (boxes->max_x[a] > boxes->min_x[b]) &&
+           (boxes->min_y[a] < boxes->max_y[b]) && (boxes->max_y[a] > boxes->min_y[b]));
+}
+
+static i32
+spatial_grid_cell_x(SpatialGrid *grid, f32 x){
+    i32 result = (i32)((x - grid->origin_x) * grid->inv_cell_size);
+    result = (result < 0) ? 0 : result;
+    return((result >= grid->cells_x) ? grid->cells_x - 1 : result);
+}
+
+static i32
+spatial_grid_cell_y(SpatialGrid *grid, f32 y){
+    i32 result = (i32)((y - grid->origin_y) * grid->inv_cell_size);
+    result = (result < 0) ? 0 : result;
+    return((result >= grid->cells_y) ? grid->cells_y - 1 : result);
+}
+
+// NOTE: cell_size 0 picks twice the average box extent. Returns false when the arena is too small or the
+// boxes are not finite.
+static bool
+spatial_grid_build(SpatialGrid *grid, Arena *arena, AabbArray *boxes, f32 cell_size){
+    grid->boxes = boxes;
+    grid->entry_count = 0;
+    grid->cells_x = grid->cells_y = 1;
+
+    f32 min_x = 0.0f, min_y = 0.0f, max_x = 0.0f, max_y = 0.0f;
+    f32 extent_sum = 0.0f;
+    if(boxes->count){
+        min_x = boxes->min_x[0];
+        min_y = boxes->min_y[0];
+        max_x = boxes->max_x[0];
+        max_y = boxes->max_y[0];
+    }
+    for(ui32 i=0; i < boxes->count; ++i){
+        min_x = (boxes->min_x[i] < min_x) ? boxes->min_x[i] : min_x;
+        min_y = (boxes->min_y[i] < min_y) ? boxes->min_y[i] : min_y;
+        max_x = (boxes->max_x[i] > max_x) ? boxes->max_x[i] : max_x;
+        max_y = (boxes->max_y[i] > max_y) ? boxes->max_y[i] : max_y;
+        f32 w = boxes->max_x[i] - boxes->min_x[i];
+        f32 h = boxes->max_y[i] - boxes->min_y[i];
+        extent_sum += (w > h) ? w : h;
+    }
+
+    if(cell_size <= 0.0f){
+        cell_size = boxes->count ? 2.0f * (extent_sum / (f32)boxes->count) : 1.0f;
+    }
+    f32 world_w = max_x - min_x;
+    f32 world_h = max_y - min_y;
+    cell_size = (cell_size > 0.0f) ? cell_size : 1.0f;
+    // NOTE: an inf or NaN extent never fits the budget, the loop below would grow cell_size forever
+    if(!isfinite(world_w) || !isfinite(world_h) || !isfinite(cell_size)){
+        return(false);
+    }
+
+    // NOTE: grow the cells until the grid fits the cell budget
+    f64 max_cells = (f64)boxes->count * SPATIAL_GRID_CELLS_PER_BOX + 1.0;
+    while(((f64)(world_w / cell_size) + 1.0) * ((f64)(world_h / cell_size) + 1.0) > max_cells ||
+          (world_w / cell_size) >= SPATIAL_GRID_MAX_CELLS_PER_AXIS || (world_h / cell_size) >= SPATIAL_GRID_MAX_CELLS_PER_AXIS){
+        cell_size *= 1.5f;
+    }
+
+    grid->origin_x = min_x;
+    grid->origin_y = min_y;
+    grid->cell_size = cell_size;
+    grid->inv_cell_size = 1.0f / cell_size;
+    grid->cells_x = (i32)(world_w * grid->inv_cell_size) + 1;
+    grid->cells_y = (i32)(world_h * grid->inv_cell_size) + 1;
+
+    ui32 cell_count = (ui32)(grid->cells_x * grid->cells_y);
+    grid->cell_start = push_array(arena, ui32, cell_count + 1);
+    if(!grid->cell_start){
+        return(false);
+    }
+    memset(grid->cell_start, 0, sizeof(ui32) * (cell_count + 1));
+
+    // NOTE: count, shifted by one so the prefix sum below leaves the start of every cell in place. The
+    // cell range of every box is kept for the scatter.
+    i32 *ranges = push_array(arena, i32, boxes->count * 4);
+    if(!ranges){
+        return(false);
+    }
+    ui32 *counts = grid->cell_start + 1;
+    for(ui32 i=0; i < boxes->count; ++i){
+        i32 *range = ranges + (i * 4);
+        range[0] = spatial_grid_cell_x(grid, boxes->min_x[i]);
+        range[1] = spatial_grid_cell_y(grid, boxes->min_y[i]);
+        range[2] = spatial_grid_cell_x(grid, boxes->max_x[i]);
+        range[3] = spatial_grid_cell_y(grid, boxes->max_y[i]);
+        // NOTE: an inverted box (min > max) keeps its min cell, a negative dx / dy would index off the grid
+        range[2] = (range[2] < range[0]) ? range[0] : range[2];
+        range[3] = (range[3] < range[1]) ? range[1] : range[3];
+
+        // NOTE: almost every box touches one to four cells. Those go through without branching on the
+        // range, a data dependent loop count mispredicts about once per box and that was most of the
+        // build time. dx / dy of 0 land on the first cell again and add nothing.
+        i32 dx = range[2] - range[0];
+        i32 dy = range[3] - range[1];
+        if((dx | dy) <= 1){
+            ui32 c = (ui32)((range[1] * grid->cells_x) + range[0]);
+            ui32 step_y = (ui32)(dy * grid->cells_x);
+            counts[c] += 1;
+            counts[c + dx] += (ui32)dx;
+            counts[c + step_y] += (ui32)dy;
+            counts[c + dx + step_y] += (ui32)(dx & dy);
+        }
+        else{
+            for(i32 y=range[1]; y <= range[3]; ++y){
+                for(i32 x=range[0]; x <= range[2]; ++x){
+                    ++counts[(y * grid->cells_x) + x];
+                }
+            }
+        }
+    }
+    for(ui32 c=0; c < cell_count; ++c){
+        grid->cell_start[c + 1] += grid->cell_start[c];
+    }
+    grid->entry_count = grid->cell_start[cell_count];
+
+    grid->entries = push_array(arena, SpatialGridEntry, grid->entry_count);
+    ui32 *cursor = push_array(arena, ui32, cell_count);
+    if(!grid->entries || !cursor){
+        return(false);
+    }
+    memcpy(cursor, grid->cell_start, sizeof(ui32) * cell_count);
+    for(ui32 i=0; i < boxes->count; ++i){
+        i32 *range = ranges + (i * 4);
+        SpatialGridEntry entry;
+        entry.min_x = boxes->min_x[i];
+        entry.min_y = boxes->min_y[i];
+        entry.max_x = boxes->max_x[i];
+        entry.max_y = boxes->max_y[i];
+        entry.box = i;
+        entry.first_cell = (ui32)range[0] | ((ui32)range[1] << 16);
+
+        // NOTE: same trick as the count. A cell the box does not reach is one of the cells it does reach,
+        // written first without moving its cursor, so the slot is overwritten by the real write after it
+        // and never spills into the next cell.
+        i32 dx = range[2] - range[0];
+        i32 dy = range[3] - range[1];
+        if((dx | dy) <= 1){
+            ui32 c = (ui32)((range[1] * grid->cells_x) + range[0]);
+            ui32 step_y = (ui32)(dy * grid->cells_x);
+            grid->entries[cursor[c + dx + step_y]] = entry;
+            cursor[c + dx + step_y] += (ui32)(dx & dy);
+            grid->entries[cursor[c + step_y]] = entry;
+            cursor[c + step_y] += (ui32)dy;
+            grid->entries[cursor[c + dx]] = entry;
+            cursor[c + dx] += (ui32)dx;
+            grid->entries[cursor[c]++] = entry;
+        }
+        else{
+            for(i32 y=range[1]; y <= range[3]; ++y){
+                for(i32 x=range[0]; x <= range[2]; ++x){
+                    grid->entries[cursor[(y * grid->cells_x) + x]++] = entry;
+                }
+            }
+        }
+    }
+    return(true);
+}
+
+// NOTE: results are written straight into the free end of the arena and pushed once at the end
+static OverlapPair *
+overlap_pairs_begin(Arena *arena, ui32 *capacity){
+    ui64 begin = (arena->used + 63) & ~63ULL;
+    ui64 available = (begin < arena->size) ? (arena->size - begin) : 0;
+    ui64 count = available / sizeof(OverlapPair);
+    *capacity = (count > 0xFFFFFFFF) ? 0xFFFFFFFF : (ui32)count;
+    return((OverlapPair *)(arena->base + begin));
+}
+
+static void
+overlap_pairs_end(Arena *arena, ui32 count){
+    arena_push(arena, sizeof(OverlapPair) * count, 64);
+}
+
+// NOTE: every overlapping pair of boxes once, a < b. Stops early and returns true in overflowed when
+// the arena runs out.
+static ui32
+spatial_grid_pairs(SpatialGrid *grid, Arena *arena, OverlapPair **pairs, bool *overflowed){
+    ui32 capacity;
+    OverlapPair *out = overlap_pairs_begin(arena, &capacity);
+    ui32 count = 0;
+    *overflowed = false;
+
+    for(i32 cy=0; cy < grid->cells_y; ++cy){
+        for(i32 cx=0; cx < grid->cells_x; ++cx){
+            ui32 c = (ui32)((cy * grid->cells_x) + cx);
+            ui32 begin = grid->cell_start[c];
+            ui32 end = grid->cell_start[c + 1];
+
+            // NOTE: the loop below writes every candidate and only keeps it by moving count, roughly half
+            // the tests hit and a branch on them mispredicts all the time. That needs one free slot past
+            // count, only checked when the cell could produce more pairs than there is room for.
+            ui64 most = ((ui64)(end - begin) * (end - begin - (end > begin))) / 2;
+            bool tight = (most >= (ui64)(capacity - count));
+
+            for(ui32 i=begin; i < end; ++i){
+                SpatialGridEntry *first = &grid->entries[i];
+                ui32 first_x = first->first_cell & 0xFFFF;
+                ui32 first_y = first->first_cell >> 16;
+                for(ui32 j=i + 1; j < end; ++j){
+                    SpatialGridEntry *second = &grid->entries[j];
+                    ui32 overlap = (first->min_x < second->max_x) & (first->max_x > second->min_x) &
+                                   (first->min_y < second->max_y) & (first->max_y > second->min_y);
+
+                    // NOTE: the intersection starts in the later of the two first cells on each axis
+                    ui32 second_x = second->first_cell & 0xFFFF;
+                    ui32 second_y = second->first_cell >> 16;
+                    ui32 owner_x = (first_x > second_x) ? first_x : second_x;
+                    ui32 owner_y = (first_y > second_y) ? first_y : second_y;
+                    ui32 owned = (owner_x == (ui32)cx) & (owner_y == (ui32)cy);
+
+                    if(tight && count == capacity){
+                        *overflowed = (overlap & owned) != 0;
+                        if(*overflowed){
+                            overlap_pairs_end(arena, count);
+                            *pairs = out;
+                            return(count);
+                        }
+                        continue;
+                    }
+                    ui32 a = first->box;
+                    ui32 b = second->box;
+                    out[count].a = (a < b) ? a : b;
+                    out[count].b = (a < b) ? b : a;
+                    count += overlap & owned;
+                }
+            }
+        }
+    }
+
+    overlap_pairs_end(arena, count);
+    *pairs = out;
+    return(count);
+}
+
+// NOTE: for many query boxes at once, a is the index into queries and b the index into the grid's boxes
+static ui32
+spatial_grid_query(SpatialGrid *grid, AabbArray *queries, Arena *arena, OverlapPair **pairs, bool *overflowed){
+    ui32 capacity;
+    OverlapPair *out = overlap_pairs_begin(arena, &capacity);
+    ui32 count = 0;
+    *overflowed = false;
+
+    for(ui32 q=0; q < queries->count; ++q){
+        f32 query_min_x = queries->min_x[q];
+        f32 query_min_y = queries->min_y[q];
+        f32 query_max_x = queries->max_x[q];
+        f32 query_max_y = queries->max_y[q];
+        i32 x0 = spatial_grid_cell_x(grid, query_min_x);
+        i32 x1 = spatial_grid_cell_x(grid, query_max_x);
+        i32 y0 = spatial_grid_cell_y(grid, query_min_y);
+        i32 y1 = spatial_grid_cell_y(grid, query_max_y);
+        for(i32 y=y0; y <= y1; ++y){
+            for(i32 x=x0; x <= x1; ++x){
+                ui32 c = (ui32)((y * grid->cells_x) + x);
+                for(ui32 i=grid->cell_start[c]; i < grid->cell_start[c + 1]; ++i){
+                    SpatialGridEntry *entry = &grid->entries[i];
+                    if(!((query_min_x < entry->max_x) && (query_max_x > entry->min_x) &&
+                         (query_min_y < entry->max_y) && (query_max_y > entry->min_y))){
+                        continue;
+                    }
+
+                    i32 first_x = (i32)(entry->first_cell & 0xFFFF);
+                    i32 first_y = (i32)(entry->first_cell >> 16);
+                    if(((x0 > first_x) ? x0 : first_x) != x || ((y0 > first_y) ? y0 : first_y) != y){
+                        continue;
+                    }
+
+                    if(count == capacity){
+                        *overflowed = true;
+                        overlap_pairs_end(arena, count);
+                        *pairs = out;
+                        return(count);
+                    }
+                    out[count].a = q;
+                    out[count].b = entry->box;
+                    ++count;
+                }
+            }
+        }
+    }
+
+    overlap_pairs_end(arena, count);
+    *pairs = out;
+    return(count);
+}
+
+#define BROADPHASE_H
+#endif
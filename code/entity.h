@@ -0,0 +1,283 @@
+#if !defined(ENTITY_H)
+
+// NOTE: entities as structure of arrays, one array per field, packed densely at 0..count-1 so the
+// update kernels stream straight through memory with no holes or alive checks. Removing swaps the last
+// entity into the hole, which moves it, so outside code keeps an EntityHandle instead of an index. The
+// handle id is stable for the life of the entity, id_to_dense follows it around as it is swapped, and
+// the generation is bumped on remove so a handle to a dead entity stops resolving even after its id
+// is reused.
+//
+// Position is the center of the box and the extents are half sizes, min/max are then one add and one
+// sub each. Velocity is in pixels per second.
+
+#include "simd.h"
+#include "broadphase.h"
+
+struct EntityStore{
+    ui32 count;
+    ui32 capacity;
+
+    f32 *x;
+    f32 *y;
+    f32 *vx;
+    f32 *vy;
+    f32 *half_w;
+    f32 *half_h;
+    PackedColor *color;
+
+    ui32 *dense_to_id;
+    ui32 *id_to_dense;
+    ui32 *generation; // NOTE: by id, 0 is never valid so a zeroed EntityHandle is null
+
+    ui32 *free_ids;
+    ui32 free_count;
+    ui32 next_id; // NOTE: ids below this have been handed out at least once
+};
+
+// NOTE: returns 0 when the arena can't fit capacity entities
+static EntityStore *
+entity_store(Arena *arena, ui32 capacity){
+    EntityStore *result = push_array(arena, EntityStore, 1);
+    if(result){
+        result->x = push_array(arena, f32, capacity);
+        result->y = push_array(arena, f32, capacity);
+        result->vx = push_array(arena, f32, capacity);
+        result->vy = push_array(arena, f32, capacity);
+        result->half_w = push_array(arena, f32, capacity);
+        result->half_h = push_array(arena, f32, capacity);
+        result->color = push_array(arena, PackedColor, capacity);
+        result->dense_to_id = push_array(arena, ui32, capacity);
+        result->id_to_dense = push_array(arena, ui32, capacity);
+        result->generation = push_array(arena, ui32, capacity);
+        result->free_ids = push_array(arena, ui32, capacity);
+        if(!result->x || !result->y || !result->vx || !result->vy || !result->half_w || !result->half_h ||
+           !result->color || !result->dense_to_id || !result->id_to_dense || !result->generation || !result->free_ids){
+            return(0);
+        }
+        result->capacity = capacity;
+        result->count = 0;
+        result->free_count = 0;
+        result->next_id = 0;
+    }
+    return(result);
+}
+
+// NOTE: returns a null handle when the store is full
+static EntityHandle
+entity_add(EntityStore *store, Vec2 center, Vec2 half_size, Vec2 velocity, PackedColor color){
+    EntityHandle result = {0};
+    if(store->count >= store->capacity){
+        return(result);
+    }
+
+    ui32 id;
+    if(store->free_count){
+        id = store->free_ids[--store->free_count];
+    }
+    else{
+        id = store->next_id++;
+        store->generation[id] = 1;
+    }
+
+    ui32 index = store->count++;
+    store->x[index] = center.x;
+    store->y[index] = center.y;
+    store->vx[index] = velocity.x;
+    store->vy[index] = velocity.y;
+    store->half_w[index] = half_size.x;
+    store->half_h[index] = half_size.y;
+    store->color[index] = color;
+    store->dense_to_id[index] = id;
+    store->id_to_dense[id] = index;
+
+    result.id = id;
+    result.generation = store->generation[id];
+    return(result);
+}
+
+static EntityHandle
+entity_add_rect(EntityStore *store, Rect r, Vec2 velocity, PackedColor color){
+    Vec2 half_size = vec2(r.w * 0.5f, r.h * 0.5f);
+    return(entity_add(store, vec2(r.x + half_size.x, r.y + half_size.y), half_size, velocity, color));
+}
+
+// NOTE: dense index of the entity, -1 once it has been removed
+static i32
+entity_index(EntityStore *store, EntityHandle handle){
+    if(handle.id < store->next_id && handle.generation && store->generation[handle.id] == handle.generation){
+        return((i32)store->id_to_dense[handle.id]);
+    }
+    return(-1);
+}
+
+static bool
+entity_alive(EntityStore *store, EntityHandle handle){
+    return(entity_index(store, handle) >= 0);
+}
+
+// NOTE: swap remove, the last entity takes the hole so dense indices past this call are invalid. Stale
+// handles are ignored.
+static bool
+entity_remove(EntityStore *store, EntityHandle handle){
+    i32 found = entity_index(store, handle);
+    if(found < 0){
+        return(false);
+    }
+
+    ui32 index = (ui32)found;
+    ui32 last = --store->count;
+    if(index != last){
+        ui32 moved = store->dense_to_id[last];
+        store->x[index] = store->x[last];
+        store->y[index] = store->y[last];
+        store->vx[index] = store->vx[last];
+        store->vy[index] = store->vy[last];
+        store->half_w[index] = store->half_w[last];
+        store->half_h[index] = store->half_h[last];
+        store->color[index] = store->color[last];
+        store->dense_to_id[index] = moved;
+        store->id_to_dense[moved] = index;
+    }
+
+    ui32 generation = store->generation[handle.id] + 1;
+    store->generation[handle.id] = generation ? generation : 1;
+    store->free_ids[store->free_count++] = handle.id;
+    return(true);
+}
+
+static void
+entity_clear(EntityStore *store){
+    // NOTE: every id handed out goes back on the free list with a new generation, old handles miss
+    for(ui32 i=0; i < store->count; ++i){
+        ui32 id = store->dense_to_id[i];
+        ui32 generation = store->generation[id] + 1;
+        store->generation[id] = generation ? generation : 1;
+        store->free_ids[store->free_count++] = id;
+    }
+    store->count = 0;
+}
+
+static void
+entity_integrate_scalar(EntityStore *store, f32 dt, ui32 begin, ui32 end){
+    for(ui32 i=begin; i < end; ++i){
+        store->x[i] += store->vx[i] * dt;
+        store->y[i] += store->vy[i] * dt;
+    }
+}
+
+static ui32
+entity_integrate_sse2(EntityStore *store, f32 dt, ui32 count){
+    f32 *x = store->x;
+    f32 *y = store->y;
+    f32 *vx = store->vx;
+    f32 *vy = store->vy;
+    __m128 step = _mm_set1_ps(dt);
+
+    ui32 i = 0;
+    for(; i + 4 <= count; i += 4){
+        __m128 px = _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(_mm_loadu_ps(vx + i), step));
+        __m128 py = _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(_mm_loadu_ps(vy + i), step));
+        _mm_storeu_ps(x + i, px);
+        _mm_storeu_ps(y + i, py);
+    }
+    return(i);
+}
+
+SIMD_TARGET_AVX static ui32
+entity_integrate_avx(EntityStore *store, f32 dt, ui32 count){
+    f32 *x = store->x;
+    f32 *y = store->y;
+    f32 *vx = store->vx;
+    f32 *vy = store->vy;
+    __m256 step = _mm256_set1_ps(dt);
+
+    ui32 i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m256 px = _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(_mm256_loadu_ps(vx + i), step));
+        __m256 py = _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(_mm256_loadu_ps(vy + i), step));
+        _mm256_storeu_ps(x + i, px);
+        _mm256_storeu_ps(y + i, py);
+    }
+    _mm256_zeroupper();
+    return(i);
+}
+
+static void
+entity_integrate(EntityStore *store, f32 dt){
+    ui32 done = 0;
+    if(simd_level() >= SIMD_AVX){
+        done = entity_integrate_avx(store, dt, store->count);
+    }
+    else{
+        done = entity_integrate_sse2(store, dt, store->count);
+    }
+    entity_integrate_scalar(store, dt, done, store->count);
+}
+
+static void
+entity_bounds_scalar(EntityStore *store, AabbArray *bounds, ui32 begin, ui32 end){
+    for(ui32 i=begin; i < end; ++i){
+        bounds->min_x[i] = store->x[i] - store->half_w[i];
+        bounds->min_y[i] = store->y[i] - store->half_h[i];
+        bounds->max_x[i] = store->x[i] + store->half_w[i];
+        bounds->max_y[i] = store->y[i] + store->half_h[i];
+    }
+}
+
+static ui32
+entity_bounds_sse2(EntityStore *store, AabbArray *bounds, ui32 count){
+    ui32 i = 0;
+    for(; i + 4 <= count; i += 4){
+        __m128 x = _mm_loadu_ps(store->x + i);
+        __m128 y = _mm_loadu_ps(store->y + i);
+        __m128 hw = _mm_loadu_ps(store->half_w + i);
+        __m128 hh = _mm_loadu_ps(store->half_h + i);
+        _mm_storeu_ps(bounds->min_x + i, _mm_sub_ps(x, hw));
+        _mm_storeu_ps(bounds->min_y + i, _mm_sub_ps(y, hh));
+        _mm_storeu_ps(bounds->max_x + i, _mm_add_ps(x, hw));
+        _mm_storeu_ps(bounds->max_y + i, _mm_add_ps(y, hh));
+    }
+    return(i);
+}
+
+SIMD_TARGET_AVX static ui32
+entity_bounds_avx(EntityStore *store, AabbArray *bounds, ui32 count){
+    ui32 i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m256 x = _mm256_loadu_ps(store->x + i);
+        __m256 y = _mm256_loadu_ps(store->y + i);
+        __m256 hw = _mm256_loadu_ps(store->half_w + i);
+        __m256 hh = _mm256_loadu_ps(store->half_h + i);
+        _mm256_storeu_ps(bounds->min_x + i, _mm256_sub_ps(x, hw));
+        _mm256_storeu_ps(bounds->min_y + i, _mm256_sub_ps(y, hh));
+        _mm256_storeu_ps(bounds->max_x + i, _mm256_add_ps(x, hw));
+        _mm256_storeu_ps(bounds->max_y + i, _mm256_add_ps(y, hh));
+    }
+    _mm256_zeroupper();
+    return(i);
+}
+
+// NOTE: bounds needs room for store->count boxes, box i is dense entity i so the pairs out of the
+// broadphase or sweep_prune_update index straight back into the store. Map them to handles with
+// dense_to_id before removing anything.
+static void
+entity_bounds(EntityStore *store, AabbArray *bounds){
+    ui32 done = 0;
+    if(simd_level() >= SIMD_AVX){
+        done = entity_bounds_avx(store, bounds, store->count);
+    }
+    else{
+        done = entity_bounds_sse2(store, bounds, store->count);
+    }
+    entity_bounds_scalar(store, bounds, done, store->count);
+    bounds->count = store->count;
+}
+
+static Rect
+entity_rect(EntityStore *store, ui32 index){
+    return(rect(vec2(store->x[index] - store->half_w[index], store->y[index] - store->half_h[index]),
+                vec2(store->half_w[index] * 2.0f, store->half_h[index] * 2.0f)));
+}
+
+#define ENTITY_H
+#endif
@@ -0,0 +1,47 @@
+#if !defined(FRAME_EXPORT_H)
+
+// NOTE: layout of the shared memory frame export (win_platform.exe -export), shared by the platform and
+// any reader process such as frame_reader.c.
+//
+//   [FrameExportHeader, FRAME_EXPORT_HEADER_SIZE bytes][slot 0 pixels][slot 1 pixels]...
+//
+// The game renders straight into slot (frame % slot_count), nothing is copied. Every slot has a sequence
+// that is 2 * frame + 1 while the frame is being rendered and 2 * frame + 2 once it is complete, after
+// which latest_frame moves to frame + 1. A reader takes latest_frame, checks the slot sequence before and
+// after reading the pixels and throws the frame away if they differ, that means the writer lapped it.
+
+#define FRAME_EXPORT_NAME "Local\\game_frame_export"
+#define FRAME_EXPORT_MAGIC 0x4D524647 // NOTE: "GFRM"
+#define FRAME_EXPORT_VERSION 1
+#define FRAME_EXPORT_SLOT_COUNT 4
+#define FRAME_EXPORT_HEADER_SIZE 4096
+
+typedef struct FrameExportSlot{
+    ui64 volatile sequence;
+    ui64 timestamp; // NOTE: QueryPerformanceCounter when the frame was completed
+} FrameExportSlot;
+
+typedef struct FrameExportHeader{
+    ui32 volatile magic; // NOTE: written last, a reader waits for it before trusting the rest
+    ui32 version;
+
+    ui32 width;
+    ui32 height;
+    ui32 pitch;
+    ui32 bytes_per_pixel; // NOTE: 0x00RRGGBB, top down
+    ui32 slot_count;
+    ui32 slot_size;
+    ui32 header_size;
+    ui64 qpc_frequency;
+
+    ui64 volatile latest_frame; // NOTE: newest complete frame + 1, 0 until the first one
+    FrameExportSlot slots[FRAME_EXPORT_SLOT_COUNT];
+} FrameExportHeader;
+
+static ui8 *
+frame_export_pixels(FrameExportHeader *header, ui32 slot){
+    return((ui8 *)header + header->header_size + ((ui64)slot * header->slot_size));
+}
+
+#define FRAME_EXPORT_H
+#endif
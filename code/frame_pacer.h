@@ -0,0 +1,132 @@
+#if !defined(FRAME_PACER_H)
+
+// NOTE: platform independent half of frame pacing. The platform sleeps for frame_pacer_sleep_seconds,
+// reports how long it actually slept with frame_pacer_record_wake, spins for whatever is left and then
+// reports the finished frame with frame_pacer_record_frame.
+//
+// The wake up error of the scheduler is tracked as a running mean and variance, the pacer always asks
+// to wake up mean + 3 deviations early so the spin only has to cover the jitter instead of a whole
+// timer tick.
+
+#define FRAME_PACER_BUCKETS 12
+
+// NOTE: upper bound in microseconds of every overshoot bucket, the last one catches everything else
+global f64 frame_pacer_bucket_limits[FRAME_PACER_BUCKETS] = {
+    10.0, 25.0, 50.0, 100.0, 250.0, 500.0, 1000.0, 2000.0, 4000.0, 8000.0, 16000.0, 1e30,
+};
+
+typedef struct FramePacer{
+    f64 target_seconds;
+
+    f64 wake_error_mean;     // NOTE: seconds overslept past the requested sleep
+    f64 wake_error_variance;
+    f64 wake_margin_seconds;
+
+    ui64 frames;
+    ui64 missed_frames;      // NOTE: frame work alone took longer than target_seconds
+    ui64 missed_sleeps;      // NOTE: woke up past the deadline because of the sleep itself
+    ui32 overshoot_histogram[FRAME_PACER_BUCKETS];
+    f64 worst_overshoot_seconds;
+
+    f64 slept_seconds;
+    f64 spun_seconds;
+} FramePacer;
+
+static void
+frame_pacer_init(FramePacer *pacer, f64 target_seconds, f64 initial_margin_seconds){
+    memset(pacer, 0, sizeof(*pacer));
+    pacer->target_seconds = target_seconds;
+    pacer->wake_error_mean = initial_margin_seconds;
+    pacer->wake_margin_seconds = initial_margin_seconds;
+}
+
+// NOTE: how long to ask the os to sleep with seconds_remaining left in the frame, 0 means just spin
+static f64
+frame_pacer_sleep_seconds(FramePacer *pacer, f64 seconds_remaining){
+    f64 result = seconds_remaining - pacer->wake_margin_seconds;
+    if(result < 0.0){
+        result = 0.0;
+    }
+    return(result);
+}
+
+static void
+frame_pacer_record_wake(FramePacer *pacer, f64 requested_seconds, f64 slept_seconds, f64 seconds_remaining){
+    pacer->slept_seconds += slept_seconds;
+    if(slept_seconds > seconds_remaining){
+        ++pacer->missed_sleeps;
+    }
+
+    // NOTE: exponentially weighted mean/variance, alpha 1/16 settles in about a second at 60hz
+    f64 alpha = 1.0 / 16.0;
+    f64 error = slept_seconds - requested_seconds;
+    f64 delta = error - pacer->wake_error_mean;
+    pacer->wake_error_mean += alpha * delta;
+    pacer->wake_error_variance = (1.0 - alpha) * (pacer->wake_error_variance + alpha * delta * delta);
+
+    f64 deviation = sqrt(pacer->wake_error_variance);
+    f64 margin = pacer->wake_error_mean + 3.0 * deviation;
+    if(margin < 0.0){
+        margin = 0.0;
+    }
+    if(margin > pacer->target_seconds * 0.5){
+        margin = pacer->target_seconds * 0.5;
+    }
+    pacer->wake_margin_seconds = margin;
+}
+
+static void
+frame_pacer_record_spin(FramePacer *pacer, f64 spun_seconds){
+    pacer->spun_seconds += spun_seconds;
+}
+
+// NOTE: frame_seconds is the time from frame start until the pacer let go of the frame
+static void
+frame_pacer_record_frame(FramePacer *pacer, f64 frame_seconds, bool work_missed_target){
+    ++pacer->frames;
+    if(work_missed_target){
+        ++pacer->missed_frames;
+    }
+
+    f64 overshoot = frame_seconds - pacer->target_seconds;
+    if(overshoot < 0.0){
+        overshoot = 0.0;
+    }
+    if(overshoot > pacer->worst_overshoot_seconds){
+        pacer->worst_overshoot_seconds = overshoot;
+    }
+
+    f64 overshoot_us = overshoot * 1000000.0;
+    for(ui32 i=0; i < FRAME_PACER_BUCKETS; ++i){
+        if(overshoot_us < frame_pacer_bucket_limits[i]){
+            ++pacer->overshoot_histogram[i];
+            break;
+        }
+    }
+}
+
+static void
+frame_pacer_dump(FramePacer *pacer){
+    f64 frames = pacer->frames ? (f64)pacer->frames : 1.0;
+    print("frame pacer: %llu frames, %llu missed frames, %llu missed sleeps, margin %.3fms, worst overshoot %.3fms\n",
+          pacer->frames, pacer->missed_frames, pacer->missed_sleeps,
+          pacer->wake_margin_seconds * 1000.0, pacer->worst_overshoot_seconds * 1000.0);
+    print("frame pacer: per frame %.3fms asleep, %.3fms spinning\n",
+          1000.0 * pacer->slept_seconds / frames, 1000.0 * pacer->spun_seconds / frames);
+
+    f64 lower = 0.0;
+    for(ui32 i=0; i < FRAME_PACER_BUCKETS; ++i){
+        if(pacer->overshoot_histogram[i]){
+            if(i == FRAME_PACER_BUCKETS - 1){
+                print("  >= %6.0fus %8u\n", lower, pacer->overshoot_histogram[i]);
+            }
+            else{
+                print("  <  %6.0fus %8u\n", frame_pacer_bucket_limits[i], pacer->overshoot_histogram[i]);
+            }
+        }
+        lower = frame_pacer_bucket_limits[i];
+    }
+}
+
+#define FRAME_PACER_H
+#endif
@@ -0,0 +1,110 @@
+// NOTE: sample reader for the shared memory frame export. Start the game with win_platform.exe -export,
+// then run frame_reader.exe [frame_count]. It reads every frame it can straight out of the mapping,
+// prints once a second how many it got, missed and lost to the writer lapping it, and exits after
+// frame_count frames (default: runs until the game goes quiet for 5 seconds).
+
+#include "game.h"
+#include "frame_export.h"
+
+static ui32
+checksum_frame(FrameExportHeader *header, ui8 *pixels){
+    ui32 result = 0;
+    for(ui32 y=0; y < header->height; ++y){
+        ui32 *pixel = (ui32 *)(pixels + (y * header->pitch));
+        for(ui32 x=0; x < header->width; ++x){
+            result = (result * 31) + *pixel++;
+        }
+    }
+    return(result);
+}
+
+int
+main(int argc, char **argv){
+    ui32 frame_limit = 0;
+    if(argc > 1){
+        char *at = argv[1];
+        parse_ui32(&at, &frame_limit);
+    }
+
+    HANDLE mapping = 0;
+    while(!mapping){
+        mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, FRAME_EXPORT_NAME);
+        if(!mapping){
+            print("reader: waiting for %s\n", FRAME_EXPORT_NAME);
+            Sleep(1000);
+        }
+    }
+
+    FrameExportHeader *header = (FrameExportHeader *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    // NOTE: the mapping shows up before the game has filled in the header, it publishes magic last
+    while(header && header->magic != FRAME_EXPORT_MAGIC){
+        print("reader: waiting for %s header\n", FRAME_EXPORT_NAME);
+        Sleep(1000);
+    }
+    _ReadWriteBarrier();
+    if(!header || header->version != FRAME_EXPORT_VERSION){
+        print("reader: %s is not a version %d frame export\n", FRAME_EXPORT_NAME, FRAME_EXPORT_VERSION);
+        return(1);
+    }
+    print("reader: %ux%u, %u slots\n", header->width, header->height, header->slot_count);
+
+    ui64 last_frame = 0;
+    ui64 frames_read = 0;
+    ui64 frames_missed = 0;
+    ui64 frames_torn = 0;
+    ui32 checksum = 0;
+    f64 latency_ms = 0.0;
+    DWORD last_report = GetTickCount();
+    DWORD last_frame_time = GetTickCount();
+
+    while(!frame_limit || frames_read < frame_limit){
+        ui64 latest = header->latest_frame;
+        if(latest == 0 || latest == last_frame){
+            if(GetTickCount() - last_frame_time > 5000){
+                break;
+            }
+            Sleep(1);
+            continue;
+        }
+
+        ui64 frame = latest - 1;
+        FrameExportSlot *slot = &header->slots[frame % header->slot_count];
+        ui64 sequence = slot->sequence;
+        _ReadWriteBarrier();
+        if(sequence == (2 * frame) + 2){
+            ui32 frame_checksum = checksum_frame(header, frame_export_pixels(header, (ui32)(frame % header->slot_count)));
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+            f64 frame_latency_ms = 1000.0 * (f64)(now.QuadPart - slot->timestamp) / (f64)header->qpc_frequency;
+            _ReadWriteBarrier();
+            if(slot->sequence == sequence){
+                ++frames_read;
+                checksum = frame_checksum;
+                latency_ms = frame_latency_ms;
+            }
+            else{
+                ++frames_torn;
+            }
+        }
+        else{
+            ++frames_torn;
+        }
+
+        if(last_frame && frame > last_frame){
+            frames_missed += frame - last_frame;
+        }
+        last_frame = latest;
+        last_frame_time = GetTickCount();
+
+        if(GetTickCount() - last_report >= 1000){
+            print("reader: frame %llu, %llu read, %llu missed, %llu torn, checksum %08x, %.2fms after completion\n",
+                  frame, frames_read, frames_missed, frames_torn, checksum, latency_ms);
+            last_report = GetTickCount();
+        }
+    }
+
+    print("reader: done, %llu read, %llu missed, %llu torn\n", frames_read, frames_missed, frames_torn);
+    UnmapViewOfFile(header);
+    CloseHandle(mapping);
+    return(0);
+}
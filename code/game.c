@@ -2,6 +2,15 @@
 #include "math.h"
 #include "vectors.h"
 #include "matrices.h"
+#include "transform.h"
+#include "trig.h"
+#include "broadphase.h"
+#include "narrowphase.h"
+#include "sweep_prune.h"
+#include "entity.h"
+#include "particles.h"
+#include "srgb.h"
+#include <stddef.h>
 
 
 static Vec2
@@ -49,9 +58,13 @@ rotate_pt(Vec2 p, f32 angle, Vec2 origin){
 
 static void
 rotate_pts(Vec2 *p, ui32 count, f32 angle, Vec2 origin){
+    // NOTE: same math as rotate_pt with the trig done once, large SoA buffers go through transform_points
+    f32 c = Cos(angle * 3.14f/180.0f);
+    f32 s = Sin(angle * 3.14f/180.0f);
     for(ui32 i=0; i<count; ++i){
         Vec2 result = {0};
-        result = rotate_pt(*p, angle, origin);
+        result.x = (p->x - origin.x) * c - (p->y - origin.y) * s + origin.x;
+        result.y = (p->x - origin.x) * s + (p->y - origin.y) * c + origin.y;
         p->x = result.x;
         p->y = result.y;
         p++;
@@ -60,36 +73,83 @@ rotate_pts(Vec2 *p, ui32 count, f32 angle, Vec2 origin){
 }
 
 // TODO: REMOVE
-static Color
+static PackedColor
 get_color_test(GameMemory *memory, RenderBuffer *buffer, f32 x, f32 y){
-    Color result = {0};
+    PackedColor result = {0};
 
     ui8 *location = (ui8 *)memory->temporary_storage + ((buffer->height - 1 - (i32)y) * buffer->pitch) + ((i32)x * buffer->bytes_per_pixel);
     ui32 *pixel = (ui32 *)location;
-    result.r = (f32)((*pixel >> 16) & 0xFF) / 255.0f;
-    result.g = (f32)((*pixel >> 8) & 0xFF) / 255.0f;
-    result.b = (f32)((*pixel >> 0) & 0xFF) / 255.0f;
-    result.a = 1.0f;
+    result.argb = 0xFF000000 | (*pixel & 0x00FFFFFF);
 
     return(result);
 }
 
-static Color
+static PackedColor
 get_color(RenderBuffer *buffer, f32 x, f32 y){
-    Color result = {0};
+    PackedColor result = {0};
 
     ui8 *location = (ui8 *)buffer->memory + ((buffer->height - 1 - (i32)y) * buffer->pitch) + ((i32)x * buffer->bytes_per_pixel);
     ui32 *pixel = (ui32 *)location;
-    result.r = (f32)((*pixel >> 16) & 0xFF) / 255.0f;
-    result.g = (f32)((*pixel >> 8) & 0xFF) / 255.0f;
-    result.b = (f32)((*pixel >> 0) & 0xFF) / 255.0f;
-    result.a = 1.0f;
+    result.argb = 0xFF000000 | (*pixel & 0x00FFFFFF);
 
     return(result);
 }
 
+// NOTE: x / 255 rounded to nearest in 16 bit lanes, exact for x up to 255 * 255
+static inline __m128i
+div255_epi16(__m128i x){
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return(_mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8));
+}
+
+// NOTE: src over dst for 2 pixels widened to 16 bit lanes, src premultiplied with its alpha in lanes 3 and 7
+static inline __m128i
+blend_packed_2(__m128i dst, __m128i src){
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i inv_alpha = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+    return(_mm_add_epi16(div255_epi16(_mm_mullo_epi16(dst, inv_alpha)), src));
+}
+
+// NOTE: blends 4 pixels, src_lo for the first two and src_hi for the last two already widened to 16
+// bits. Every path that blends a PackedColor goes through here, so draw_pixel and the spans come out the
+// same bits. The alpha byte is cleared, the buffer stays 0x00RRGGBB.
+static inline __m128i
+blend_packed_4(__m128i current, __m128i src_lo, __m128i src_hi){
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = blend_packed_2(_mm_unpacklo_epi8(current, zero), src_lo);
+    __m128i hi = blend_packed_2(_mm_unpackhi_epi8(current, zero), src_hi);
+    return(_mm_and_si128(_mm_packus_epi16(lo, hi), _mm_set1_epi32(0x00FFFFFF)));
+}
+
+// NOTE: the last 1 to 3 pixels of a span, loaded and stored in pieces so nothing past the row is touched.
+// With linear the sources are srgb_linear_color's and the blend is srgb_blend_4.
+static void
+blend_packed_tail(ui32 *pixel, i32 count, __m128i src_lo, __m128i src_hi, SrgbTables *linear){
+    __m128i current;
+    if(count == 1){
+        current = _mm_cvtsi32_si128((int)pixel[0]);
+    }
+    else if(count == 2){
+        current = _mm_loadl_epi64((__m128i *)pixel);
+    }
+    else{
+        current = _mm_unpacklo_epi64(_mm_loadl_epi64((__m128i *)pixel), _mm_cvtsi32_si128((int)pixel[2]));
+    }
+
+    __m128i result = linear ? srgb_blend_4(linear, current, src_lo, src_hi) : blend_packed_4(current, src_lo, src_hi);
+    if(count == 1){
+        pixel[0] = (ui32)_mm_cvtsi128_si32(result);
+    }
+    else{
+        _mm_storel_epi64((__m128i *)pixel, result);
+        if(count == 3){
+            pixel[2] = (ui32)_mm_cvtsi128_si32(_mm_srli_si128(result, 8));
+        }
+    }
+}
+
 static void
-draw_pixel(RenderBuffer *buffer, f32 x, f32 y, Color c){
+draw_pixel(RenderBuffer *buffer, f32 x, f32 y, PackedColor c){
     x = round_ff(x);
     y = round_ff(y);
 
@@ -97,21 +157,23 @@ draw_pixel(RenderBuffer *buffer, f32 x, f32 y, Color c){
         ui8 *row = (ui8 *)buffer->memory + ((buffer->height - 1 - (i32)y) * buffer->pitch) + ((i32)x * buffer->bytes_per_pixel);
         ui32 *pixel = (ui32 *)row;
 
-        f32 current_r = (f32)((*pixel >> 16) & 0xFF);
-        f32 current_g = (f32)((*pixel >> 8) & 0xFF);
-        f32 current_b = (f32)((*pixel >> 0) & 0xFF);
-
-        f32 new_r = ((1.0f - c.a) * current_r + c.a * (c.r * 255.0f));
-        f32 new_g = ((1.0f - c.a) * current_g + c.a * (c.g * 255.0f));
-        f32 new_b = ((1.0f - c.a) * current_b + c.a * (c.b * 255.0f));
-
-        ui32 color = (round_fi32(new_r) << 16 | round_fi32(new_g) << 8 | round_fi32(new_b) << 0);
-        *pixel = color;
+        if((c.argb >> 24) == 0xFF){
+            *pixel = c.argb & 0x00FFFFFF;
+        }
+        else if(buffer->linear_blend){
+            SrgbTables *linear = srgb_tables();
+            __m128i src = srgb_linear_color(linear, c);
+            *pixel = (ui32)_mm_cvtsi128_si32(srgb_blend_4(linear, _mm_cvtsi32_si128((int)*pixel), src, src));
+        }
+        else{
+            __m128i src = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)c.argb), _mm_setzero_si128());
+            *pixel = (ui32)_mm_cvtsi128_si32(blend_packed_4(_mm_cvtsi32_si128((int)*pixel), src, src));
+        }
     }
 }
 
 static void
-draw_ray(RenderBuffer *buffer, Vec2 point, Vec2 direction, Color c){
+draw_ray(RenderBuffer *buffer, Vec2 point, Vec2 direction, PackedColor c){
     point = round_v2(point);
     direction = round_v2(direction);
 
@@ -139,7 +201,7 @@ draw_ray(RenderBuffer *buffer, Vec2 point, Vec2 direction, Color c){
 }
 
 static void
-draw_line(RenderBuffer *buffer, Vec2 point, Vec2 direction, Color c){
+draw_line(RenderBuffer *buffer, Vec2 point, Vec2 direction, PackedColor c){
     Vec2 point1 = round_v2(point);
     Vec2 point2 = point1;
     direction = round_v2(direction);
@@ -184,7 +246,7 @@ draw_line(RenderBuffer *buffer, Vec2 point, Vec2 direction, Color c){
 }
 
 static void
-draw_segment(RenderBuffer *buffer, Vec2 p0, Vec2 p1, Color c){
+draw_segment(RenderBuffer *buffer, Vec2 p0, Vec2 p1, PackedColor c){
     p0 = round_v2(p0);
     p1 = round_v2(p1);
 
@@ -212,7 +274,7 @@ draw_segment(RenderBuffer *buffer, Vec2 p0, Vec2 p1, Color c){
 }
 
 static void
-draw_flattop_triangle(RenderBuffer *buffer, Vec2 p0, Vec2 p1, Vec2 p2, Color c){
+draw_flattop_triangle(RenderBuffer *buffer, Vec2 p0, Vec2 p1, Vec2 p2, PackedColor c){
     f32 left_slope = (p0.x - p2.x) / (p0.y - p2.y);
     f32 right_slope = (p1.x - p2.x) / (p1.y - p2.y);
 
@@ -231,7 +293,7 @@ draw_flattop_triangle(RenderBuffer *buffer, Vec2 p0, Vec2 p1, Vec2 p2, Color c){
 }
 
 static void
-draw_flatbottom_triangle(RenderBuffer *buffer, Vec2 p0, Vec2 p1, Vec2 p2, Color c){
+draw_flatbottom_triangle(RenderBuffer *buffer, Vec2 p0, Vec2 p1, Vec2 p2, PackedColor c){
     f32 left_slope = (p1.x - p0.x) / (p1.y - p0.y);
     f32 right_slope = (p2.x - p0.x) / (p2.y - p0.y);
     
@@ -250,7 +312,7 @@ draw_flatbottom_triangle(RenderBuffer *buffer, Vec2 p0, Vec2 p1, Vec2 p2, Color
 }
 
 static void
-draw_triangle_outline(RenderBuffer *buffer, Vec2 *points, Color c, Color c_outline, bool fill){
+draw_triangle_outline(RenderBuffer *buffer, Vec2 *points, PackedColor c, PackedColor c_outline, bool fill){
     Vec2 p0 = (*points++);
     Vec2 p1 = (*points++);
     Vec2 p2 = (*points);
@@ -282,7 +344,7 @@ draw_triangle_outline(RenderBuffer *buffer, Vec2 *points, Color c, Color c_outli
 }
 
 static void
-draw_triangle(RenderBuffer *buffer, Vec2 *points, Color c, bool fill){
+draw_triangle(RenderBuffer *buffer, Vec2 *points, PackedColor c, bool fill){
     Vec2 p0 = (*points++);
     Vec2 p1 = (*points++);
     Vec2 p2 = (*points);
@@ -316,7 +378,7 @@ draw_triangle(RenderBuffer *buffer, Vec2 *points, Color c, bool fill){
 }
 
 static void
-draw_triangle_v2(RenderBuffer *buffer, Vec2 p0, Vec2 p1, Vec2 p2, Color c, bool fill){
+draw_triangle_v2(RenderBuffer *buffer, Vec2 p0, Vec2 p1, Vec2 p2, PackedColor c, bool fill){
     if(p0.y < p1.y){ swap_v2(&p0, &p1); }
     if(p0.y < p2.y){ swap_v2(&p0, &p2); }
     if(p1.y < p2.y){ swap_v2(&p1, &p2); }
@@ -345,17 +407,9 @@ draw_triangle_v2(RenderBuffer *buffer, Vec2 p0, Vec2 p1, Vec2 p2, Color c, bool
     }
 }
 
-static void
-clear(RenderBuffer *buffer, Color c){
-    for(f32 y=0; y < buffer->height; ++y){
-        for(f32 x=0; x < buffer->width; ++x){
-            draw_pixel(buffer, x, y, c);
-        }
-    }
-}
 
 static void
-draw_rect(RenderBuffer *buffer, Rect r, Color c){
+draw_rect(RenderBuffer *buffer, Rect r, PackedColor c){
     Vec2 p0 = {r.x, r.y};
     Vec2 p1 = {r.x + r.w, r.y};
     Vec2 p2 = {r.x, r.y + r.h};
@@ -369,7 +423,7 @@ draw_rect(RenderBuffer *buffer, Rect r, Color c){
 }
 
 static void
-draw_rect_pts(RenderBuffer *buffer, Vec2 *p, Color c){
+draw_rect_pts(RenderBuffer *buffer, Vec2 *p, PackedColor c){
     Vec2 p0 = round_v2(*p++);
     Vec2 p1 = round_v2(*p++);
     Vec2 p2 = round_v2(*p++);
@@ -383,7 +437,7 @@ draw_rect_pts(RenderBuffer *buffer, Vec2 *p, Color c){
 }
 
 static void
-draw_quad(RenderBuffer *buffer, Vec2 *p, Color c, bool fill){
+draw_quad(RenderBuffer *buffer, Vec2 *p, PackedColor c, bool fill){
     Vec2 p0 = (*p++);
     Vec2 p1 = (*p++);
     Vec2 p2 = (*p++);
@@ -394,7 +448,7 @@ draw_quad(RenderBuffer *buffer, Vec2 *p, Color c, bool fill){
 }
 
 static void
-draw_box(RenderBuffer *buffer, Rect rect, Color c){
+draw_box(RenderBuffer *buffer, Rect rect, PackedColor c){
     Vec2 p0 = {rect.x, rect.y};
     Vec2 p1 = {rect.x + rect.w, rect.y};
     Vec2 p2 = {rect.x + rect.w, rect.y + rect.h};
@@ -407,7 +461,7 @@ draw_box(RenderBuffer *buffer, Rect rect, Color c){
 }
 
 static void
-draw_polygon(RenderBuffer *buffer, Vec2 *points, ui32 count, Color c){
+draw_polygon(RenderBuffer *buffer, Vec2 *points, ui32 count, PackedColor c){
     Vec2 first = *points++;
     Vec2 prev = first;
     for(ui32 i=1; i<count; ++i){
@@ -417,8 +471,265 @@ draw_polygon(RenderBuffer *buffer, Vec2 *points, ui32 count, Color c){
     draw_segment(buffer, first, prev, c);
 }
 
+// NOTE: blends c over [x0, x1) of row y with the same math as draw_pixel, 4 pixels at a time. Clipped
+// to the buffer, y is bottom up like draw_pixel. Opaque spans are a plain fill in either blend mode.
+static void
+draw_span(RenderBuffer *buffer, i32 x0, i32 x1, i32 y, PackedColor c){
+    if(y < 0 || y >= buffer->height){
+        return;
+    }
+    x0 = (x0 < 0) ? 0 : x0;
+    x1 = (x1 > buffer->width) ? buffer->width : x1;
+    if(x0 >= x1){
+        return;
+    }
+
+    ui32 *pixel = (ui32 *)((ui8 *)buffer->memory + ((buffer->height - 1 - y) * buffer->pitch)) + x0;
+    ui32 *end = pixel + (x1 - x0);
+
+    if((c.argb >> 24) == 0xFF){
+        ui32 color = c.argb & 0x00FFFFFF;
+        __m128i color4 = _mm_set1_epi32((int)color);
+        for(; pixel + 4 <= end; pixel += 4){
+            _mm_storeu_si128((__m128i *)pixel, color4);
+        }
+        while(pixel < end){
+            *pixel++ = color;
+        }
+        return;
+    }
+
+    SrgbTables *linear = 0;
+    __m128i src;
+    if(buffer->linear_blend){
+        linear = srgb_tables();
+        src = srgb_linear_color(linear, c);
+        for(; pixel + 4 <= end; pixel += 4){
+            _mm_storeu_si128((__m128i *)pixel, srgb_blend_4(linear, _mm_loadu_si128((__m128i *)pixel), src, src));
+        }
+    }
+    else{
+        src = _mm_unpacklo_epi8(_mm_set1_epi32((int)c.argb), _mm_setzero_si128());
+        for(; pixel + 4 <= end; pixel += 4){
+            _mm_storeu_si128((__m128i *)pixel, blend_packed_4(_mm_loadu_si128((__m128i *)pixel), src, src));
+        }
+    }
+    if(pixel < end){
+        blend_packed_tail(pixel, (i32)(end - pixel), src, src, linear);
+    }
+}
+
+static void
+clear(RenderBuffer *buffer, PackedColor c){
+    for(i32 y=0; y < buffer->height; ++y){
+        draw_span(buffer, 0, buffer->width, y, c);
+    }
+}
+
+// NOTE: filled shapes are rasterized one row at a time. Each row gets its exact span of pixel centers
+// inside the shape, so every pixel is written once and alpha blends once. With antialias the row is
+// split in the fully covered middle, which goes through draw_span, and the edge pixels on both sides,
+// which blend with their coverage from the distance of the pixel center to the edge.
+typedef enum{SHAPE_ELLIPSE, SHAPE_ROUNDED_RECT} ShapeKind;
+
+typedef struct Shape{
+    ShapeKind kind;
+    f32 cx, cy;   // NOTE: center, pixel (x, y) covers [x, x+1) so its center is at x + 0.5
+    f32 hx, hy;   // NOTE: half extents, the radii for an ellipse
+    f32 radius;   // NOTE: corner radius of a rounded rect
+} Shape;
+
+// NOTE: where row py crosses the shape grown by grow (negative shrinks), false when it does not
+static bool
+shape_span(Shape *shape, f32 py, f32 grow, f32 *left, f32 *right){
+    f32 hx = shape->hx + grow;
+    f32 hy = shape->hy + grow;
+    f32 dy = ABS(py - shape->cy);
+    if(hx <= 0.0f || hy <= 0.0f || dy >= hy){
+        return(false);
+    }
+
+    f32 half = hx;
+    if(shape->kind == SHAPE_ELLIPSE){
+        f32 t = dy / hy;
+        half = hx * sqrtf(1.0f - (t * t));
+    }
+    else{
+        f32 radius = shape->radius + grow;
+        radius = (radius < 0.0f) ? 0.0f : radius;
+        radius = (radius > hx) ? hx : radius;
+        radius = (radius > hy) ? hy : radius;
+        f32 corner = dy - (hy - radius);
+        if(corner > 0.0f){
+            half = (hx - radius) + sqrtf((radius * radius) - (corner * corner));
+        }
+    }
+
+    *left = shape->cx - half;
+    *right = shape->cx + half;
+    return(true);
+}
+
+// NOTE: signed distance from the pixel centers px to the edge on row py, negative inside. Exact for
+// rounded rects and circles, first order for ellipses, which is plenty for a one pixel wide edge. Shapes
+// thinner than a pixel come out a little heavy.
+static __m128
+shape_distance_4(Shape *shape, __m128 px, f32 py){
+    __m128 sign_bit = _mm_set1_ps(-0.0f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 dx = _mm_andnot_ps(sign_bit, _mm_sub_ps(px, _mm_set1_ps(shape->cx)));
+    f32 dy = ABS(py - shape->cy);
+
+    __m128 result;
+    if(shape->kind == SHAPE_ELLIPSE && shape->hx == shape->hy){
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_set1_ps(dy * dy)));
+        result = _mm_sub_ps(length, _mm_set1_ps(shape->hx));
+    }
+    else if(shape->kind == SHAPE_ELLIPSE){
+        // NOTE: f = (dx/hx)^2 + (dy/hy)^2 - 1 over the length of its gradient
+        f32 ay = dy / (shape->hy * shape->hy);
+        __m128 ax = _mm_mul_ps(dx, _mm_set1_ps(1.0f / (shape->hx * shape->hx)));
+        __m128 f = _mm_add_ps(_mm_mul_ps(dx, ax), _mm_set1_ps((dy * ay) - 1.0f));
+        __m128 gradient = _mm_mul_ps(_mm_set1_ps(2.0f), _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ax, ax), _mm_set1_ps(ay * ay))));
+        result = _mm_div_ps(f, _mm_max_ps(gradient, _mm_set1_ps(1e-6f)));
+    }
+    else{
+        f32 radius = (shape->radius > shape->hx) ? shape->hx : shape->radius;
+        radius = (radius > shape->hy) ? shape->hy : radius;
+        f32 qy = dy - (shape->hy - radius);
+        __m128 qx = _mm_sub_ps(dx, _mm_set1_ps(shape->hx - radius));
+        f32 outside_y = (qy > 0.0f) ? qy : 0.0f;
+        __m128 outside_x = _mm_max_ps(qx, zero);
+        __m128 outside = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(outside_x, outside_x), _mm_set1_ps(outside_y * outside_y)));
+        __m128 inside = _mm_min_ps(_mm_max_ps(qx, _mm_set1_ps(qy)), zero);
+        result = _mm_sub_ps(_mm_add_ps(outside, inside), _mm_set1_ps(radius));
+    }
+    return(result);
+}
+
+// NOTE: first pixel whose center is at or right of x, ceilf(x - 0.5f) without the libm call
+static i32
+span_pixel(f32 x){
+    f32 center = x - 0.5f;
+    i32 result = (i32)center;
+    if((f32)result < center){
+        ++result;
+    }
+    return(result);
+}
+
+// NOTE: blends [x0, x1) of row y with c scaled by how much of each pixel the shape covers
+static void
+draw_shape_edge(RenderBuffer *buffer, Shape *shape, i32 x0, i32 x1, i32 y, PackedColor c){
+    x0 = (x0 < 0) ? 0 : x0;
+    x1 = (x1 > buffer->width) ? buffer->width : x1;
+    if(x0 >= x1){
+        return;
+    }
+
+    ui32 *pixel = (ui32 *)((ui8 *)buffer->memory + ((buffer->height - 1 - y) * buffer->pitch)) + x0;
+    f32 py = (f32)y + 0.5f;
+    __m128 px = _mm_add_ps(_mm_set1_ps((f32)x0 + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+    __m128 four = _mm_set1_ps(4.0f);
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 full = _mm_set1_ps(255.0f);
+    SrgbTables *linear = buffer->linear_blend ? srgb_tables() : 0;
+    __m128i src = linear ? srgb_linear_color(linear, c) : _mm_unpacklo_epi8(_mm_set1_epi32((int)c.argb), _mm_setzero_si128());
+
+    i32 x = x0;
+    for(; x < x1; x += 4, pixel += 4){
+        __m128 coverage = _mm_sub_ps(half, shape_distance_4(shape, px, py));
+        coverage = _mm_min_ps(_mm_max_ps(coverage, zero), one);
+
+        // NOTE: coverage to 0 - 255 once per 4 pixels, then each pixel's copy of c is scaled by its own
+        // coverage in 16 bit lanes, c0 c0 c0 c0 c1 c1 c1 c1 for the low pair
+        __m128i coverage8 = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(coverage, full), half));
+        coverage8 = _mm_packs_epi32(coverage8, coverage8);
+        coverage8 = _mm_unpacklo_epi16(coverage8, coverage8);
+        __m128i coverage_lo = _mm_unpacklo_epi32(coverage8, coverage8);
+        __m128i coverage_hi = _mm_unpackhi_epi32(coverage8, coverage8);
+        __m128i src_lo = linear ? srgb_scale_2(src, coverage_lo) : div255_epi16(_mm_mullo_epi16(src, coverage_lo));
+        __m128i src_hi = linear ? srgb_scale_2(src, coverage_hi) : div255_epi16(_mm_mullo_epi16(src, coverage_hi));
+        if(x + 4 > x1){
+            blend_packed_tail(pixel, x1 - x, src_lo, src_hi, linear);
+        }
+        else if(linear){
+            _mm_storeu_si128((__m128i *)pixel, srgb_blend_4(linear, _mm_loadu_si128((__m128i *)pixel), src_lo, src_hi));
+        }
+        else{
+            _mm_storeu_si128((__m128i *)pixel, blend_packed_4(_mm_loadu_si128((__m128i *)pixel), src_lo, src_hi));
+        }
+        px = _mm_add_ps(px, four);
+    }
+}
+
+static void
+draw_shape(RenderBuffer *buffer, Shape *shape, PackedColor c, bool antialias){
+    f32 grow = antialias ? 0.5f : 0.0f;
+    i32 y0 = (i32)floorf(shape->cy - shape->hy - grow);
+    i32 y1 = (i32)ceilf(shape->cy + shape->hy + grow);
+    y0 = (y0 < 0) ? 0 : y0;
+    y1 = (y1 > buffer->height) ? buffer->height : y1;
+
+    for(i32 y=y0; y < y1; ++y){
+        f32 py = (f32)y + 0.5f;
+        f32 left, right;
+        if(!shape_span(shape, py, grow, &left, &right)){
+            continue;
+        }
+        i32 x0 = span_pixel(left);
+        i32 x1 = span_pixel(right);
+        if(!antialias){
+            draw_span(buffer, x0, x1, y, c);
+            continue;
+        }
+
+        // NOTE: pixel centers more than half a pixel inside are fully covered, a short middle is not
+        // worth splitting the row for
+        i32 inner_x0 = x1;
+        i32 inner_x1 = x1;
+        if((x1 - x0) > 10 && shape_span(shape, py, -0.5f, &left, &right)){
+            inner_x0 = span_pixel(left);
+            inner_x1 = span_pixel(right);
+            inner_x0 = (inner_x0 < x0) ? x0 : inner_x0;
+            inner_x1 = (inner_x1 > x1) ? x1 : inner_x1;
+            if(inner_x1 - inner_x0 < 8){
+                inner_x0 = inner_x1 = x1;
+            }
+        }
+        draw_shape_edge(buffer, shape, x0, inner_x0, y, c);
+        draw_span(buffer, inner_x0, inner_x1, y, c);
+        draw_shape_edge(buffer, shape, inner_x1, x1, y, c);
+    }
+}
+
+static void
+draw_ellipse(RenderBuffer *buffer, f32 cx, f32 cy, f32 rx, f32 ry, PackedColor c, bool antialias){
+    Shape shape = {SHAPE_ELLIPSE, cx, cy, rx, ry, 0.0f};
+    draw_shape(buffer, &shape, c, antialias);
+}
+
+static void
+draw_disk(RenderBuffer *buffer, f32 cx, f32 cy, f32 r, PackedColor c, bool antialias){
+    Shape shape = {SHAPE_ELLIPSE, cx, cy, r, r, 0.0f};
+    draw_shape(buffer, &shape, c, antialias);
+}
+
+static void
+draw_rounded_rect(RenderBuffer *buffer, Rect r, f32 radius, PackedColor c, bool antialias){
+    Shape shape = {SHAPE_ROUNDED_RECT, r.x + (r.w * 0.5f), r.y + (r.h * 0.5f), r.w * 0.5f, r.h * 0.5f, radius};
+    draw_shape(buffer, &shape, c, antialias);
+}
+
 static void 
-draw_circle(RenderBuffer *buffer, f32 xm, f32 ym, f32 r, Color c, bool fill) {
+draw_circle(RenderBuffer *buffer, f32 xm, f32 ym, f32 r, PackedColor c, bool fill) {
+   if(fill){
+       // NOTE: the outline below lands on pixel centers r away from (xm, ym), the disk reaches their far edge
+       draw_disk(buffer, xm + 0.5f, ym + 0.5f, r + 0.5f, c, false);
+       return;
+   }
    f32 x = -r; 
    f32 y = 0; 
    f32 err = 2-2*r; 
@@ -429,15 +740,6 @@ draw_circle(RenderBuffer *buffer, f32 xm, f32 ym, f32 r, Color c, bool fill) {
       draw_pixel(buffer, (xm + y), (ym + x), c);
       r = err;
       if (r <= y){
-          if(fill){
-              if(ym + y == ym - y){
-                  draw_segment(buffer, vec2((xm - x - 1), (ym + y)), vec2((xm + x), (ym + y)), c);
-              }
-              else{
-                  draw_segment(buffer, vec2((xm - x - 1), (ym + y)), vec2((xm + x), (ym + y)), c);
-                  draw_segment(buffer, vec2((xm - x - 1), (ym - y)), vec2((xm + x), (ym - y)), c);
-              }
-          }
           y++;
           err += y * 2 + 1;
       }
@@ -455,23 +757,910 @@ copy_array(Vec2 *a, Vec2 *b, i32 count){
     }
 }
 
-MAIN_GAME_LOOP(main_game_loop){
+typedef struct TestTriangle{
+    Vec2 p[3];
+    Color c;
+} TestTriangle;
+
+// NOTE: shared edge mesh over test_background, every interior edge belongs to exactly two triangles
+global TestTriangle test_mesh[] = {
+    {{{0.5f, 10.5f},   {0.5f, 5.5f},    {2.5f, 8.5f}},    {1.0f, 0.0f, 0.0f,  0.5f}},  // red
+    {{{0.5f, 5.5f},    {3.5f, 4.5f},    {0.5f, 0.5f}},    {0.9f, 0.9f, 0.0f,  0.5f}},  // yellow
+    {{{0.5f, 10.5f},   {2.5f, 8.5f},    {4.5f, 10.5f}},   {0.0f, 0.0f, 1.0f,  0.5f}},  // blue
+    {{{2.5f, 8.5f},    {0.5f, 5.5f},    {3.5f, 4.5f}},    {0.0f, 1.0f, 0.0f,  0.5f}},  // green
+    {{{0.5f, 0.5f},    {3.5f, 4.5f},    {6.5f, 1.5f}},    {1.0f, 0.0f, 0.0f,  0.5f}},  // red
+    {{{2.5f, 8.5f},    {4.5f, 10.5f},   {6.5f, 7.5f}},    {0.9f, 0.9f, 0.0f,  0.5f}},  // yellow
+    {{{2.5f, 8.5f},    {6.5f, 7.5f},    {3.5f, 4.5f}},    {0.92f, 0.62f, 0.96f, 0.5f}},// pink
+    {{{3.5f, 4.5f},    {6.5f, 4.5f},    {6.5f, 7.5f}},    {0.0f, 1.0f, 1.0f,  0.5f}},  // teal
+    {{{3.5f, 4.5f},    {6.5f, 4.5f},    {6.5f, 1.5f}},    {0.0f, 0.0f, 1.0f,  0.5f}},  // blue
+    {{{0.5f, 0.5f},    {6.5f, 1.5f},    {15.5f, 0.5f}},   {0.0f, 1.0f, 0.0f,  0.5f}},  // green
+    {{{4.5f, 10.5f},   {6.5f, 7.5f},    {10.5f, 10.5f}},  {0.0f, 1.0f, 0.0f,  0.5f}},  // green
+    {{{6.5f, 7.5f},    {9.5f, 4.5f},    {10.5f, 10.5f}},  {0.0f, 0.0f, 1.0f,  0.5f}},  // blue
+    {{{6.5f, 7.5f},    {6.5f, 4.5f},    {9.5f, 4.5f}},    {1.0f, 0.0f, 0.0f,  0.5f}},  // red
+    {{{6.5f, 4.5f},    {6.5f, 1.5f},    {9.5f, 4.5f}},    {0.92f, 0.62f, 0.96f, 0.5f}},// pink
+    {{{6.5f, 1.5f},    {9.5f, 4.5f},    {10.15f, 4.20f}}, {0.0f, 1.0f, 1.0f,  0.5f}},  // teal
+    {{{10.5f, 10.5f},  {9.5f, 4.5f},    {10.75f, 6.25f}}, {0.9f, 0.9f, 0.0f,  0.5f}},  // yellow
+    {{{9.5f, 4.5f},    {10.75f, 6.25f}, {10.4f, 4.75f}},  {0.0f, 1.0f, 0.0f,  0.5f}},  // green
+    {{{9.5f, 4.5f},    {10.4f, 4.75f},  {10.15f, 4.20f}}, {1.0f, 0.5f, 0.15f, 0.5f}},  // orange
+    {{{6.5f, 1.5f},    {15.5f, 0.5f},   {10.15f, 4.20f}}, {0.9f, 0.9f, 0.0f,  0.5f}},  // yellow
+    {{{10.5f, 10.5f},  {16.5f, 10.5f},  {10.75f, 6.25f}}, {1.0f, 0.0f, 0.0f,  0.5f}},  // red
+    {{{10.75f, 6.25f}, {16.5f, 10.5f},  {11.8f, 5.1f}},   {0.0f, 1.0f, 1.0f,  0.5f}},  // teal
+    {{{10.75f, 6.25f}, {10.4f, 4.75f},  {11.8f, 5.1f}},   {0.0f, 0.0f, 1.0f,  0.5f}},  // blue
+    {{{10.4f, 4.75f},  {11.8f, 5.1f},   {16.5f, 1.5f}},   {0.9f, 0.9f, 0.0f,  0.5f}},  // yellow
+    {{{10.4f, 4.75f},  {10.15f, 4.20f}, {16.5f, 1.5f}},   {0.92f, 0.62f, 0.96f, 0.5f}},// pink
+    {{{10.15f, 4.20f}, {15.5f, 0.5f},   {16.5f, 1.5f}},   {1.0f, 0.0f, 0.0f,  0.5f}},  // red
+    {{{16.5f, 1.5f},   {16.5f, 10.5f},  {11.8f, 5.1f}},   {0.0f, 1.0f, 0.0f,  0.5f}},  // green
+    {{{15.5f, 0.5f},   {16.5f, 0.5f},   {16.5f, 1.5f}},   {0.0f, 0.0f, 1.0f,  0.5f}},  // blue
+};
+
+static void
+draw_test_mesh(RenderBuffer *buffer, f32 scalar, PackedColor c_outline, bool outline, bool fill){
+    for(ui32 i=0; i < array_count(test_mesh); ++i){
+        Vec2 p[3];
+        copy_array(p, test_mesh[i].p, array_count(p));
+        if(outline){
+            scale_pts(p, array_count(p), scalar);
+            draw_triangle_outline(buffer, p, pack_color(test_mesh[i].c), c_outline, fill);
+        }
+        else{
+            draw_triangle(buffer, p, pack_color(test_mesh[i].c), fill);
+        }
+    }
+}
+
+// NOTE: blows every pixel of the background up 48x so the rasterization rules can be checked by eye
+static void
+draw_magnified(GameMemory *memory, RenderBuffer *buffer, Vec2 *background){
+    memcpy(memory->temporary_storage, buffer->memory, buffer->memory_size);
+
+    for(f32 y=round_ff(background[0].y); y <= round_ff(background[2].y); ++y){
+        for(f32 x=round_ff(background[0].x); x <= (round_ff(background[1].x) + 1.0f); ++x){
+            PackedColor c = get_color_test(memory, buffer, x, y);
+            f32 new_x = x * 48.0f;
+            f32 new_y = y * 48.0f;
+            for(f32 y2=new_y; y2 < (new_y + 47.0f); ++y2){
+                for(f32 x2=new_x; x2 < (new_x + 47.0f); ++x2){
+                    draw_pixel(buffer, x2, y2, c);
+                }
+            }
+        }
+    }
+}
+
+static void
+draw_test_scene(GameMemory *memory, RenderBuffer *buffer, Vec2 *background, bool one, bool two, bool three){
+    Color white = {1.0f, 1.0f, 1.0f,  1.0f};
+    Color black = {0.0f, 0.0f, 0.0f,  1.0f};
+
+    TIMED_BLOCK("clear"){
+        clear(buffer, pack_color(black));
+    }
+    draw_rect_pts(buffer, background, pack_color(white));
+
+    TIMED_BLOCK("draw_test_mesh"){
+        if(one){
+            draw_test_mesh(buffer, 1.0f, pack_color(black), false, true);
+        }
+    }
+
+    TIMED_BLOCK("draw_magnified"){
+        draw_magnified(memory, buffer, background);
+    }
+
+    TIMED_BLOCK("draw_test_mesh_magnified"){
+        if(two){
+            draw_test_mesh(buffer, 48.0f, pack_color(black), true, two);
+        }
+        if(three){
+            draw_test_mesh(buffer, 48.0f, pack_color(black), true, false);
+        }
+    }
+}
+
+// NOTE: one bar per hotspot, full width is a whole frame, same order as the F2 dump
+static void
+draw_profile_overlay(RenderBuffer *buffer, GameFrame *frame){
+    Color colors[PROFILE_OVERLAY_BARS] = {
+        {1.0f, 0.0f, 0.0f,  0.8f},
+        {1.0f, 0.5f, 0.15f, 0.8f},
+        {0.9f, 0.9f, 0.0f,  0.8f},
+        {0.0f, 1.0f, 0.0f,  0.8f},
+        {0.0f, 1.0f, 1.0f,  0.8f},
+        {0.0f, 0.0f, 1.0f,  0.8f},
+        {1.0f, 0.0f, 1.0f,  0.8f},
+        {0.92f, 0.62f, 0.96f, 0.8f},
+    };
+    Color background = {0.2f, 0.2f, 0.2f, 0.8f};
+
+    f32 full_width = 400.0f;
+    f32 x = 10.0f;
+    f32 y = (f32)buffer->height - 20.0f;
+    for(ui32 i=0; i < frame->profile_bar_count; ++i){
+        f32 width = full_width * (frame->profile_frame_percent[i] / 100.0f);
+        draw_rect(buffer, rect(vec2(x, y), vec2(full_width, 6.0f)), pack_color(background));
+        draw_rect(buffer, rect(vec2(x, y), vec2(width, 6.0f)), pack_color(colors[i]));
+        y -= 10.0f;
+    }
+}
+
+// NOTE: rasterizes each triangle on its own into temporary_storage and counts how many triangles
+// touch every pixel. Output is black for uncovered, white for covered once, red for covered more than once.
+static ui32
+draw_test_mesh_overdraw(GameMemory *memory, RenderBuffer *buffer){
+    ui32 result = 0;
+
+    PackedColor white = {0xFFFFFFFF};
+    PackedColor red =   {0xFFFF0000};
+    PackedColor black = {0xFF000000};
+
+    RenderBuffer scratch = *buffer;
+    scratch.memory = memory->temporary_storage;
+    ui8 *coverage = (ui8 *)memory->temporary_storage + buffer->memory_size;
+    memset(coverage, 0, buffer->width * buffer->height);
+
+    for(ui32 i=0; i < array_count(test_mesh); ++i){
+        memset(scratch.memory, 0, scratch.memory_size);
+        draw_triangle(&scratch, test_mesh[i].p, white, true);
+
+        for(i32 y=0; y < buffer->height; ++y){
+            ui32 *pixel = (ui32 *)((ui8 *)scratch.memory + (y * scratch.pitch));
+            for(i32 x=0; x < buffer->width; ++x){
+                if(*pixel++){
+                    ++coverage[y * buffer->width + x];
+                }
+            }
+        }
+    }
+
+    clear(buffer, black);
+    for(i32 y=0; y < buffer->height; ++y){
+        for(i32 x=0; x < buffer->width; ++x){
+            ui8 count = coverage[y * buffer->width + x];
+            if(count){
+                // NOTE: coverage rows are stored top down like the buffer memory, draw_pixel is bottom up
+                draw_pixel(buffer, (f32)x, (f32)(buffer->height - 1 - y), (count > 1) ? red : white);
+                if(count > 1){
+                    ++result;
+                }
+            }
+        }
+    }
+
+    return(result);
+}
+
+// NOTE: the filled shapes hard edged on the left half and antialiased on the right, half transparent so a
+// pixel written twice would come out brighter than its neighbours
+static void
+draw_test_shapes(RenderBuffer *buffer){
+    Color background = {0.1f, 0.1f, 0.1f, 1.0f};
+    clear(buffer, pack_color(background));
+
+    f32 w = (f32)buffer->width * 0.5f;
+    f32 h = (f32)buffer->height;
+    Color orange_color = {1.0f, 0.5f, 0.15f, 0.5f};
+    Color teal_color =   {0.0f, 1.0f, 1.0f,  0.5f};
+    Color pink_color =   {0.92f, 0.62f, 0.96f, 0.5f};
+    PackedColor orange = pack_color(orange_color);
+    PackedColor teal = pack_color(teal_color);
+    PackedColor pink = pack_color(pink_color);
+    for(ui32 i=0; i < 2; ++i){
+        bool antialias = (i == 1);
+        f32 x = w * i;
+        draw_disk(buffer, x + (w * 0.25f), h * 0.7f, h * 0.2f, orange, antialias);
+        draw_disk(buffer, x + (w * 0.25f) + 0.37f, h * 0.25f, 3.3f, orange, antialias);
+        draw_ellipse(buffer, x + (w * 0.7f), h * 0.7f, w * 0.22f, h * 0.1f, teal, antialias);
+        draw_ellipse(buffer, x + (w * 0.7f), h * 0.7f, w * 0.03f, h * 0.25f, pink, antialias);
+        draw_rounded_rect(buffer, rect(vec2(x + (w * 0.1f), h * 0.1f), vec2(w * 0.8f, h * 0.3f)), h * 0.08f, teal, antialias);
+        draw_rounded_rect(buffer, rect(vec2(x + (w * 0.4f) + 0.25f, h * 0.2f), vec2(w * 0.3f, 7.5f)), 20.0f, pink, antialias);
+    }
+}
+
+#define SCATTER_DISK_COUNT 250000
+
+// NOTE: a dense scatter plot, SCATTER_DISK_COUNT small antialiased disks at fixed pseudo random spots.
+// A stress scene for the golden runner, single threaded it takes several 30hz frames to draw.
+static void
+draw_test_scatter(RenderBuffer *buffer){
+    Color white = {1.0f, 1.0f, 1.0f, 1.0f};
+    clear(buffer, pack_color(white));
+
+    ui32 state = 0x12345678;
+    Color colors[3] = {{0.1f, 0.3f, 0.8f, 0.3f}, {0.9f, 0.3f, 0.1f, 0.3f}, {0.1f, 0.6f, 0.2f, 0.3f}};
+    PackedColor packed[3] = {pack_color(colors[0]), pack_color(colors[1]), pack_color(colors[2])};
+    for(ui32 i=0; i < SCATTER_DISK_COUNT; ++i){
+        // NOTE: xorshift32, two samples per axis pull the points towards the middle
+        state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+        f32 u0 = (f32)(state & 0xFFFF) / 65535.0f;
+        f32 v0 = (f32)(state >> 16) / 65535.0f;
+        state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+        f32 u1 = (f32)(state & 0xFFFF) / 65535.0f;
+        f32 v1 = (f32)(state >> 16) / 65535.0f;
+        state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+        f32 size = (f32)(state & 0xFFFF) / 65535.0f;
+        f32 x = ((u0 + u1) * 0.5f) * (f32)buffer->width;
+        f32 y = ((v0 + v1) * 0.5f) * (f32)buffer->height;
+        draw_disk(buffer, x, y, 1.5f + (2.0f * size), packed[i % 3], true);
+    }
+}
+
+// NOTE: additive sparks thrown up from the bottom of the screen and slow alpha smoke rising from the same
+// spot. Emitters 0 and 1, both stopped until fountain_run.
+static ParticleSystem *
+fountain(Arena *arena, Vec2 position, ui32 spark_capacity, ui32 smoke_capacity){
+    ParticleSystem *result = particle_system(arena);
+    if(result){
+        Color spark = {1.0f, 0.6f, 0.2f, 0.5f};
+        Color smoke = {0.6f, 0.6f, 0.65f, 0.15f};
+        i32 sparks = particle_pool_add(result, arena, spark_capacity, PARTICLE_BLEND_ADD, pack_color(spark), 1, 0.5f, vec2(0.0f, -250.0f));
+        i32 smokes = particle_pool_add(result, arena, smoke_capacity, PARTICLE_BLEND_ALPHA, pack_color(smoke), 4, 1.5f, vec2(0.0f, 30.0f));
+        if(sparks < 0 || smokes < 0){
+            return(0);
+        }
+        particle_emitter_add(result, (ui32)sparks, position, PI * 0.5f, 0.5f, 300.0f, 500.0f, 1.5f, 2.5f, 0x9E3779B9);
+        particle_emitter_add(result, (ui32)smokes, position, PI * 0.5f, 1.0f, 20.0f, 60.0f, 2.0f, 3.0f, 0x85EBCA6B);
+    }
+    return(result);
+}
+
+// NOTE: running, each emitter keeps its pool about full
+static void
+fountain_run(ParticleSystem *system, bool running){
+    for(ui32 i=0; i < system->emitter_count; ++i){
+        ParticleEmitter *emitter = &system->emitters[i];
+        f32 average_life = (emitter->life_min + emitter->life_max) * 0.5f;
+        emitter->rate = running ? (f32)system->pools[emitter->pool].capacity / average_life : 0.0f;
+    }
+}
+
+// NOTE: a fountain built in temporary_storage, run for 1.5 seconds at a fixed 60hz
+static void
+draw_test_particles(GameMemory *memory, RenderBuffer *buffer){
+    Color background = {0.05f, 0.05f, 0.1f, 1.0f};
+    clear(buffer, pack_color(background));
+
+    Arena arena;
+    arena_init(&arena, memory->temporary_storage, memory->temporary_storage_size);
+    ParticleSystem *particles = fountain(&arena, vec2((f32)buffer->width * 0.5f, (f32)buffer->height * 0.1f), 65536, 16384);
+    if(!particles){
+        return;
+    }
+    fountain_run(particles, true);
+    ParticleFrame *frame = 0;
+    for(ui32 i=0; i < 90; ++i){
+        frame = particle_update(particles, 1.0f / 60.0f);
+    }
+
+    Arena scratch;
+    arena_init(&scratch, arena.base + arena.used, arena.size - arena.used);
+    particle_render(frame, buffer, &scratch, memory->parallel_for);
+}
+
+typedef enum{SCENE_MESH, SCENE_MESH_MAGNIFIED_FILL, SCENE_MESH_MAGNIFIED_WIRE, SCENE_MESH_OVERDRAW, SCENE_SHAPES, SCENE_SCATTER, SCENE_PARTICLES, SCENE_SHAPES_LINEAR, SCENE_COUNT} SceneId;
+global char *scene_names[SCENE_COUNT] = {
+    [SCENE_MESH]="mesh",
+    [SCENE_MESH_MAGNIFIED_FILL]="mesh_magnified_fill",
+    [SCENE_MESH_MAGNIFIED_WIRE]="mesh_magnified_wire",
+    [SCENE_MESH_OVERDRAW]="mesh_overdraw",
+    [SCENE_SHAPES]="shapes",
+    [SCENE_SCATTER]="scatter",
+    [SCENE_PARTICLES]="particles",
+    [SCENE_SHAPES_LINEAR]="shapes_linear",
+};
+
+RENDER_SCENE(render_scene){
+    if(scene_index >= SCENE_COUNT){
+        return(false);
+    }
+
+    Vec2 background[4] = {{0.0f, 0.0f}, {16.0f, 0.0f}, {0.0f, 10.0f}, {16.0f, 10.0f}};
+    snprintf(info->name, sizeof(info->name), "%s", scene_names[scene_index]);
+    info->overdraw_count = 0;
+    render_buffer->linear_blend = (scene_index == SCENE_SHAPES_LINEAR);
+
+    switch(scene_index){
+        case SCENE_MESH:{
+            draw_test_scene(memory, render_buffer, background, true, false, false);
+        } break;
+        case SCENE_MESH_MAGNIFIED_FILL:{
+            draw_test_scene(memory, render_buffer, background, false, true, false);
+        } break;
+        case SCENE_MESH_MAGNIFIED_WIRE:{
+            draw_test_scene(memory, render_buffer, background, true, false, true);
+        } break;
+        case SCENE_MESH_OVERDRAW:{
+            info->overdraw_count = draw_test_mesh_overdraw(memory, render_buffer);
+        } break;
+        case SCENE_SHAPES:{
+            draw_test_shapes(render_buffer);
+        } break;
+        case SCENE_SCATTER:{
+            draw_test_scatter(render_buffer);
+        } break;
+        case SCENE_PARTICLES:{
+            draw_test_particles(memory, render_buffer);
+        } break;
+        case SCENE_SHAPES_LINEAR:{
+            draw_test_shapes(render_buffer);
+        } break;
+    }
+
+    return(true);
+}
+
+// NOTE: xorshift32 for the checks
+static ui32
+check_random(ui32 *state){
+    ui32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return(x);
+}
+
+static RenderBuffer
+check_buffer(void *memory, i32 width, i32 height){
+    RenderBuffer result = {0};
+    result.width = width;
+    result.height = height;
+    result.bytes_per_pixel = 4;
+    result.pitch = width * result.bytes_per_pixel;
+    result.memory_size = result.pitch * height;
+    result.memory = memory;
+    return(result);
+}
+
+// NOTE: draw_span against draw_pixel on the same random background, in both blend modes and with every
+// alpha. Spans start and end on every offset into a group of 4, and off both sides of the row.
+static bool
+check_span_pixel(GameMemory *memory){
+    RenderBuffer spans = check_buffer(memory->temporary_storage, 61, 5);
+    RenderBuffer pixels = check_buffer((ui8 *)spans.memory + spans.memory_size, spans.width, spans.height);
+    ui32 *span_pixels = (ui32 *)spans.memory;
+    ui32 *pixel_pixels = (ui32 *)pixels.memory;
+    ui32 count = (ui32)(spans.width * spans.height);
+
+    ui32 random = 0x2545F491;
+    for(ui32 i=0; i < 256 * 16; ++i){
+        for(ui32 p=0; p < count; ++p){
+            span_pixels[p] = pixel_pixels[p] = check_random(&random) & 0x00FFFFFF;
+        }
+
+        // NOTE: premultiplied, no channel above alpha
+        ui32 alpha = (i >> 1) & 0xFF;
+        PackedColor c = {alpha << 24};
+        for(ui32 shift=0; shift <= 16; shift += 8){
+            c.argb |= (check_random(&random) % (alpha + 1)) << shift;
+        }
+
+        spans.linear_blend = pixels.linear_blend = (i & 1);
+        i32 x0 = (i32)(check_random(&random) % (ui32)(spans.width + 8)) - 4;
+        i32 x1 = x0 + (i32)(check_random(&random) % (ui32)(spans.width + 4));
+        i32 y = (i32)(check_random(&random) % (ui32)spans.height);
+        draw_span(&spans, x0, x1, y, c);
+        // NOTE: clipped here, round_ff truncates so draw_pixel would put x = -1 on column 0
+        i32 pixel_x0 = (x0 < 0) ? 0 : x0;
+        i32 pixel_x1 = (x1 > pixels.width) ? pixels.width : x1;
+        for(i32 x=pixel_x0; x < pixel_x1; ++x){
+            draw_pixel(&pixels, (f32)x, (f32)y, c);
+        }
+
+        for(ui32 p=0; p < count; ++p){
+            if(span_pixels[p] != pixel_pixels[p]){
+                return(false);
+            }
+        }
+    }
+    return(true);
+}
+
+// NOTE: random half transparent shapes over black, one at a time. Hard edged every pixel has to be
+// black or c blended once, antialiased no pixel may come out brighter than c blended once.
+static bool
+check_shape_blend(GameMemory *memory){
+    RenderBuffer buffer = check_buffer(memory->temporary_storage, 160, 96);
+    ui32 *pixels = (ui32 *)buffer.memory;
+    ui32 count = (ui32)(buffer.width * buffer.height);
+
+    PackedColor c = {0x80806040};
+    ui32 random = 0x9E3779B9;
+    for(ui32 i=0; i < 3000; ++i){
+        for(ui32 p=0; p < count; ++p){
+            pixels[p] = 0;
+        }
+
+        Shape shape = {0};
+        shape.kind = (i & 2) ? SHAPE_ROUNDED_RECT : SHAPE_ELLIPSE;
+        shape.cx = (f32)(check_random(&random) % 20000) * 0.01f - 20.0f;
+        shape.cy = (f32)(check_random(&random) % 14000) * 0.01f - 20.0f;
+        shape.hx = (f32)(check_random(&random) % 4000) * 0.01f + 0.2f;
+        shape.hy = (i & 4) ? shape.hx : (f32)(check_random(&random) % 4000) * 0.01f + 0.2f;
+        shape.radius = (f32)(check_random(&random) % 3000) * 0.01f;
+        bool antialias = (i & 1);
+        draw_shape(&buffer, &shape, c, antialias);
+
+        for(ui32 p=0; p < count; ++p){
+            ui32 pixel = pixels[p];
+            if(antialias){
+                for(ui32 shift=0; shift <= 16; shift += 8){
+                    if(((pixel >> shift) & 0xFF) > ((c.argb >> shift) & 0xFF)){
+                        return(false);
+                    }
+                }
+            }
+            else if(pixel && pixel != (c.argb & 0x00FFFFFF)){
+                return(false);
+            }
+        }
+    }
+    return(true);
+}
+
+// NOTE: boxes on half units so plenty of them share an edge without overlapping, zero width ones
+// included, and now and then one big enough to cover many cells
+static void
+check_random_boxes(AabbArray *boxes, ui32 *random){
+    for(ui32 i=0; i < boxes->count; ++i){
+        ui32 big = ((check_random(random) % 50) == 0);
+        f32 x = (f32)(check_random(random) % 400) * 0.5f;
+        f32 y = (f32)(check_random(random) % 300) * 0.5f;
+        f32 w = (f32)(check_random(random) % (big ? 200 : 12)) * 0.5f;
+        f32 h = (f32)(check_random(random) % (big ? 200 : 12)) * 0.5f;
+        aabb_array_set_rect(boxes, i, rect(vec2(x, y), vec2(w, h)));
+    }
+}
+
+// NOTE: marks pair (a, b) in a count_a * count_b bit matrix, false if it was already there
+static bool
+check_mark_pair(ui32 *seen, ui32 count_b, ui32 a, ui32 b){
+    ui32 bit = (a * count_b) + b;
+    bool result = !(seen[bit >> 5] & (1u << (bit & 31)));
+    seen[bit >> 5] |= (1u << (bit & 31));
+    return(result);
+}
+
+// NOTE: spatial_grid_pairs and spatial_grid_query against testing every pair, with the picked cell size
+// and a few fixed ones. Every pair has to overlap, come up once and the counts have to match.
+static bool
+check_grid_pairs(GameMemory *memory){
+    Arena arena;
+    arena_init(&arena, memory->temporary_storage, memory->temporary_storage_size);
+
+    ui32 count = 1500;
+    ui32 seen_count = ((count * count) + 31) / 32;
+    ui32 random = 0x6C8E9CF5;
+    for(ui32 round=0; round < 4; ++round){
+        arena_reset(&arena);
+        AabbArray boxes;
+        AabbArray queries;
+        ui32 *seen = push_array(&arena, ui32, seen_count);
+        if(!aabb_array_init(&boxes, &arena, count) || !aabb_array_init(&queries, &arena, count) || !seen){
+            return(false);
+        }
+        check_random_boxes(&boxes, &random);
+        check_random_boxes(&queries, &random);
+
+        SpatialGrid grid;
+        bool overflowed;
+        OverlapPair *pairs;
+        if(!spatial_grid_build(&grid, &arena, &boxes, 4.0f * (f32)round)){
+            return(false);
+        }
+
+        memset(seen, 0, sizeof(ui32) * seen_count);
+        ui32 pair_count = spatial_grid_pairs(&grid, &arena, &pairs, &overflowed);
+        ui32 expected = 0;
+        for(ui32 a=0; a < count; ++a){
+            for(ui32 b=a + 1; b < count; ++b){
+                expected += aabb_overlap(&boxes, a, b);
+            }
+        }
+        if(overflowed || pair_count != expected){
+            return(false);
+        }
+        for(ui32 i=0; i < pair_count; ++i){
+            OverlapPair pair = pairs[i];
+            if(pair.a >= pair.b || pair.b >= count || !aabb_overlap(&boxes, pair.a, pair.b) ||
+               !check_mark_pair(seen, count, pair.a, pair.b)){
+                return(false);
+            }
+        }
+
+        memset(seen, 0, sizeof(ui32) * seen_count);
+        pair_count = spatial_grid_query(&grid, &queries, &arena, &pairs, &overflowed);
+        expected = 0;
+        for(ui32 q=0; q < count; ++q){
+            for(ui32 b=0; b < count; ++b){
+                expected += (queries.min_x[q] < boxes.max_x[b]) && (queries.max_x[q] > boxes.min_x[b]) &&
+                            (queries.min_y[q] < boxes.max_y[b]) && (queries.max_y[q] > boxes.min_y[b]);
+            }
+        }
+        if(overflowed || pair_count != expected){
+            return(false);
+        }
+        for(ui32 i=0; i < pair_count; ++i){
+            ui32 q = pairs[i].a;
+            ui32 b = pairs[i].b;
+            if(q >= count || b >= count || !check_mark_pair(seen, count, q, b) ||
+               !((queries.min_x[q] < boxes.max_x[b]) && (queries.max_x[q] > boxes.min_x[b]) &&
+                 (queries.min_y[q] < boxes.max_y[b]) && (queries.max_y[q] > boxes.min_y[b]))){
+                return(false);
+            }
+        }
+    }
+    return(true);
+}
+
+// NOTE: [0, 1)
+static f32
+check_random_unit(ui32 *random){
+    return((f32)(check_random(random) >> 8) * (1.0f / 16777216.0f));
+}
+
+// NOTE: count points on an ellipse at sorted angles, which is always convex, wound either way
+static ConvexPolygon
+check_random_polygon(ui32 *random, ui32 count){
+    f32 angles[POLYGON_MAX_POINTS];
+    for(ui32 i=0; i < count; ++i){
+        f32 angle = 2.0f * PI * check_random_unit(random);
+        ui32 at = i;
+        while(at > 0 && angles[at - 1] > angle){
+            angles[at] = angles[at - 1];
+            --at;
+        }
+        angles[at] = angle;
+    }
+
+    f32 cx = 40.0f * check_random_unit(random);
+    f32 cy = 40.0f * check_random_unit(random);
+    f32 rx = 1.0f + (10.0f * check_random_unit(random));
+    f32 ry = 1.0f + (10.0f * check_random_unit(random));
+    bool reverse = (check_random(random) & 1);
+    ConvexPolygon result = {0};
+    result.count = count;
+    for(ui32 i=0; i < count; ++i){
+        f32 angle = angles[reverse ? count - 1 - i : i];
+        result.points[i] = vec2(cx + (rx * Cos(angle)), cy + (ry * Sin(angle)));
+    }
+    return(result);
+}
+
+// NOTE: true when q is more than margin inside every edge of a convex polygon of either winding
+static bool
+check_inside_polygon(ConvexPolygon *polygon, Vec2 q, f32 margin){
+    i32 winding = 0;
+    for(ui32 i=0; i < polygon->count; ++i){
+        Vec2 p = polygon->points[i];
+        Vec2 next = polygon->points[(i + 1 < polygon->count) ? i + 1 : 0];
+        Vec2 edge = vec2(next.x - p.x, next.y - p.y);
+        f32 length = sqrtf((edge.x * edge.x) + (edge.y * edge.y));
+        if(length <= 0.0f){
+            continue;
+        }
+        f32 distance = ((edge.x * (q.y - p.y)) - (edge.y * (q.x - p.x))) / length;
+        i32 side = (distance > margin) ? 1 : (distance < -margin) ? -1 : 0;
+        if(!side || (winding && side != winding)){
+            return(false);
+        }
+        winding = side;
+    }
+    return(winding != 0);
+}
+
+static Rect
+check_polygon_bounds(ConvexPolygon *polygon){
+    Vec2 min = polygon->points[0];
+    Vec2 max = polygon->points[0];
+    for(ui32 i=1; i < polygon->count; ++i){
+        Vec2 p = polygon->points[i];
+        min = vec2((p.x < min.x) ? p.x : min.x, (p.y < min.y) ? p.y : min.y);
+        max = vec2((p.x > max.x) ? p.x : max.x, (p.y > max.y) ? p.y : max.y);
+    }
+    return(rect(min, vec2(max.x - min.x, max.y - min.y)));
+}
+
+static ConvexPolygon
+check_moved_polygon(ConvexPolygon *polygon, Vec2 offset){
+    ConvexPolygon result = *polygon;
+    for(ui32 i=0; i < result.count; ++i){
+        result.points[i] = vec2(result.points[i].x + offset.x, result.points[i].y + offset.y);
+    }
+    return(result);
+}
+
+// NOTE: sat_polygon_polygon against random points. A pair it calls apart must not have a point well
+// inside both, and a contact must be one: b moved by a bit more than normal * depth comes apart, moved
+// by half of it still touches. sat_polygon_rect has to agree with the rect as a polygon and
+// sat_triangle_pairs with sat_triangle_triangle bit for bit.
+static bool
+check_sat(GameMemory *memory){
+    Arena arena;
+    arena_init(&arena, memory->temporary_storage, memory->temporary_storage_size);
+    ui32 pair_count = 4096;
+    TriangleArray tris;
+    OverlapPair *pairs = push_array(&arena, OverlapPair, pair_count);
+    Contact *contacts = push_array(&arena, Contact, pair_count);
+    if(!triangle_array_init(&tris, &arena, pair_count * 2) || !pairs || !contacts){
+        return(false);
+    }
+
+    ui32 random = 0x1B873593;
+    for(ui32 i=0; i < pair_count; ++i){
+        ui32 a_count = (i & 1) ? 3 : 3 + (check_random(&random) % (POLYGON_MAX_POINTS - 2));
+        ui32 b_count = (i & 1) ? 3 : 3 + (check_random(&random) % (POLYGON_MAX_POINTS - 2));
+        ConvexPolygon a = check_random_polygon(&random, a_count);
+        ConvexPolygon b = check_random_polygon(&random, b_count);
+
+        Contact contact = {0};
+        bool hit = sat_polygon_polygon(&a, &b, &contact);
+        if(!hit){
+            // NOTE: samples only where the bounds of a and b overlap, the only place a point can be in both
+            Rect bounds_a = check_polygon_bounds(&a);
+            Rect bounds_b = check_polygon_bounds(&b);
+            f32 x0 = (bounds_a.x > bounds_b.x) ? bounds_a.x : bounds_b.x;
+            f32 y0 = (bounds_a.y > bounds_b.y) ? bounds_a.y : bounds_b.y;
+            f32 x1 = ((bounds_a.x + bounds_a.w) < (bounds_b.x + bounds_b.w)) ? (bounds_a.x + bounds_a.w) : (bounds_b.x + bounds_b.w);
+            f32 y1 = ((bounds_a.y + bounds_a.h) < (bounds_b.y + bounds_b.h)) ? (bounds_a.y + bounds_a.h) : (bounds_b.y + bounds_b.h);
+            for(ui32 sample=0; sample < 256 && x0 < x1 && y0 < y1; ++sample){
+                Vec2 q = vec2(x0 + ((x1 - x0) * check_random_unit(&random)), y0 + ((y1 - y0) * check_random_unit(&random)));
+                if(check_inside_polygon(&a, q, 1e-3f) && check_inside_polygon(&b, q, 1e-3f)){
+                    return(false);
+                }
+            }
+        }
+
+        if(hit){
+            f32 length = sqrtf((contact.normal.x * contact.normal.x) + (contact.normal.y * contact.normal.y));
+            if(contact.depth <= 0.0f || ABS(length - 1.0f) > 1e-3f){
+                return(false);
+            }
+            f32 apart = contact.depth + 1e-3f;
+            ConvexPolygon moved = check_moved_polygon(&b, vec2(contact.normal.x * apart, contact.normal.y * apart));
+            if(sat_polygon_polygon(&a, &moved, 0)){
+                return(false);
+            }
+            if(contact.depth > 1e-2f){
+                f32 half = contact.depth * 0.5f;
+                moved = check_moved_polygon(&b, vec2(contact.normal.x * half, contact.normal.y * half));
+                if(!sat_polygon_polygon(&a, &moved, 0)){
+                    return(false);
+                }
+            }
+        }
+
+        f32 x = b.points[0].x;
+        f32 y = b.points[0].y;
+        Rect r = rect(vec2(x, y), vec2(12.0f * check_random_unit(&random), 12.0f * check_random_unit(&random)));
+        ConvexPolygon rect_polygon = polygon_from_rect(r);
+        Contact rect_contact = {0};
+        Contact polygon_contact = {0};
+        bool rect_hit = sat_polygon_rect(&a, r, &rect_contact);
+        if(rect_hit != sat_polygon_polygon(&a, &rect_polygon, &polygon_contact) ||
+           ABS(rect_contact.depth - polygon_contact.depth) > 1e-4f){
+            return(false);
+        }
+
+        if(i & 1){
+            triangle_array_set(&tris, 2 * i, a.points[0], a.points[1], a.points[2]);
+            triangle_array_set(&tris, (2 * i) + 1, b.points[0], b.points[1], b.points[2]);
+        }
+        else{
+            triangle_array_set(&tris, 2 * i, a.points[0], b.points[1], a.points[2]);
+            triangle_array_set(&tris, (2 * i) + 1, b.points[0], a.points[1], b.points[2]);
+        }
+        pairs[i].a = 2 * i;
+        pairs[i].b = (2 * i) + 1;
+    }
+
+    ui32 hits = sat_triangle_pairs(&tris, pairs, pair_count, contacts);
+    ui32 expected = 0;
+    for(ui32 i=0; i < pair_count; ++i){
+        ConvexPolygon a = triangle_array_polygon(&tris, pairs[i].a);
+        ConvexPolygon b = triangle_array_polygon(&tris, pairs[i].b);
+        Contact contact = {0};
+        expected += sat_polygon_polygon(&a, &b, &contact);
+        if(contact.normal.x != contacts[i].normal.x || contact.normal.y != contacts[i].normal.y ||
+           contact.depth != contacts[i].depth){
+            return(false);
+        }
+    }
+    return(hits == expected);
+}
+
+static void
+check_place_box(AabbArray *boxes, ui32 index, ui32 *random){
+    f32 x = (f32)(check_random(random) % 600) * 0.5f;
+    f32 y = (f32)(check_random(random) % 400) * 0.5f;
+    f32 w = (f32)(check_random(random) % 24) * 0.5f;
+    f32 h = (f32)(check_random(random) % 24) * 0.5f;
+    aabb_array_set_rect(boxes, index, rect(vec2(x, y), vec2(w, h)));
+}
+
+// NOTE: 200 frames of sweep_prune_update against testing every pair. Boxes drift, every few frames
+// they snap to half units so edges touch, and boxes get added a few at a time, many at a time and
+// dropped off the end. Replaying the events has to give the overlapping pairs of that frame exactly,
+// without a BEGIN for a pair that is already overlapping or an END for one that is not.
+static bool
+check_sweep_prune(GameMemory *memory){
+    Arena arena;
+    Arena frame_arena;
+    ui64 half = memory->temporary_storage_size / 2;
+    arena_init(&arena, memory->temporary_storage, half);
+    arena_init(&frame_arena, (ui8 *)memory->temporary_storage + half, half);
+
+    ui32 capacity = 640;
+    ui32 seen_count = ((capacity * capacity) + 31) / 32;
+    AabbArray boxes;
+    SweepPrune *sap = sweep_prune_init(&arena, capacity, 32768);
+    f32 *vx = push_array(&arena, f32, capacity);
+    f32 *vy = push_array(&arena, f32, capacity);
+    ui32 *seen = push_array(&arena, ui32, seen_count);
+    if(!sap || !vx || !vy || !seen || !aabb_array_init(&boxes, &arena, capacity)){
+        return(false);
+    }
+    memset(seen, 0, sizeof(ui32) * seen_count);
+
+    ui32 random = 0x85EBCA6B;
+    boxes.count = 0;
+    for(ui32 frame=0; frame < 200; ++frame){
+        ui32 count = boxes.count;
+        if(frame == 0){
+            count = 500;
+        }
+        else if((frame % 50) == 25){
+            count -= 40;
+        }
+        else if((frame % 50) == 30){
+            count += 60;
+        }
+        else if((frame % 10) == 3){
+            count += 5;
+        }
+        count = (count > capacity) ? capacity : count;
+        for(ui32 i=boxes.count; i < count; ++i){
+            check_place_box(&boxes, i, &random);
+            vx[i] = (4.0f * check_random_unit(&random)) - 2.0f;
+            vy[i] = (4.0f * check_random_unit(&random)) - 2.0f;
+        }
+        boxes.count = count;
+
+        for(ui32 i=0; i < count; ++i){
+            f32 dx = ((boxes.min_x[i] + vx[i]) < 0.0f || (boxes.max_x[i] + vx[i]) > 320.0f) ? -vx[i] : vx[i];
+            f32 dy = ((boxes.min_y[i] + vy[i]) < 0.0f || (boxes.max_y[i] + vy[i]) > 220.0f) ? -vy[i] : vy[i];
+            vx[i] = dx;
+            vy[i] = dy;
+            if((frame % 7) == 6){
+                dx = (f32)round_fi32((boxes.min_x[i] + dx) * 2.0f) * 0.5f - boxes.min_x[i];
+                dy = (f32)round_fi32((boxes.min_y[i] + dy) * 2.0f) * 0.5f - boxes.min_y[i];
+            }
+            boxes.min_x[i] += dx;
+            boxes.max_x[i] += dx;
+            boxes.min_y[i] += dy;
+            boxes.max_y[i] += dy;
+        }
+
+        arena_reset(&frame_arena);
+        OverlapEvent *events;
+        bool overflowed;
+        ui32 event_count = sweep_prune_update(sap, &boxes, &frame_arena, &events, &overflowed);
+        if(overflowed){
+            return(false);
+        }
+        for(ui32 i=0; i < event_count; ++i){
+            OverlapEvent *event = &events[i];
+            if(event->a >= event->b || event->b >= capacity){
+                return(false);
+            }
+            ui32 bit = (event->a * capacity) + event->b;
+            bool was_overlapping = (seen[bit >> 5] & (1u << (bit & 31))) != 0;
+            if(was_overlapping != (event->kind == OVERLAP_END)){
+                return(false);
+            }
+            seen[bit >> 5] ^= (1u << (bit & 31));
+        }
+
+        ui32 expected = 0;
+        for(ui32 a=0; a < capacity; ++a){
+            for(ui32 b=a + 1; b < capacity; ++b){
+                bool overlapping = (b < count) && aabb_overlap(&boxes, a, b);
+                ui32 bit = (a * capacity) + b;
+                if(overlapping != ((seen[bit >> 5] & (1u << (bit & 31))) != 0) ||
+                   (b < count && overlapping != sweep_prune_overlapping(sap, a, b))){
+                    return(false);
+                }
+                expected += overlapping;
+            }
+        }
+        if(expected != sap->pair_count){
+            return(false);
+        }
+    }
+    return(true);
+}
+
+typedef enum{CHECK_TRIG, CHECK_SPAN_PIXEL, CHECK_SHAPE_BLEND, CHECK_GRID_PAIRS, CHECK_SAT, CHECK_SWEEP_PRUNE, CHECK_COUNT} CheckId;
+global char *check_names[CHECK_COUNT] = {
+    [CHECK_TRIG]="trig",
+    [CHECK_SPAN_PIXEL]="span_pixel",
+    [CHECK_SHAPE_BLEND]="shape_blend",
+    [CHECK_GRID_PAIRS]="grid_pairs",
+    [CHECK_SAT]="sat",
+    [CHECK_SWEEP_PRUNE]="sweep_prune",
+};
+
+RUN_CHECK(run_check){
+    if(check_index >= CHECK_COUNT){
+        return(false);
+    }
+
+    snprintf(info->name, sizeof(info->name), "%s", check_names[check_index]);
+    info->passed = false;
+
+    switch(check_index){
+        case CHECK_TRIG:{
+            info->passed = trig_self_check((f32 *)memory->temporary_storage);
+        } break;
+        case CHECK_SPAN_PIXEL:{
+            info->passed = check_span_pixel(memory);
+        } break;
+        case CHECK_SHAPE_BLEND:{
+            info->passed = check_shape_blend(memory);
+        } break;
+        case CHECK_GRID_PAIRS:{
+            info->passed = check_grid_pairs(memory);
+        } break;
+        case CHECK_SAT:{
+            info->passed = check_sat(memory);
+        } break;
+        case CHECK_SWEEP_PRUNE:{
+            info->passed = check_sweep_prune(memory);
+        } break;
+    }
+
+    return(true);
+}
+
+#define TRANSFORM_CAPACITY 65536
+#define ENTITY_CAPACITY 131072
+#define FOUNTAIN_SPARK_CAPACITY 786432
+#define FOUNTAIN_SMOKE_CAPACITY 262144
+
+static void
+init_arena(GameMemory *memory, GameState *game_state){
+    Assert(sizeof(GameState) <= GAME_STATE_RESERVE);
+    arena_init(&game_state->arena, (ui8 *)memory->permanent_storage + GAME_STATE_RESERVE, memory->permanent_storage_size - GAME_STATE_RESERVE);
+    game_state->transforms = transform_hierarchy(&game_state->arena, TRANSFORM_CAPACITY);
+    game_state->entities = entity_store(&game_state->arena, ENTITY_CAPACITY);
+    game_state->particles = fountain(&game_state->arena, vec2(480.0f, 40.0f), FOUNTAIN_SPARK_CAPACITY, FOUNTAIN_SMOKE_CAPACITY);
+}
+
+// NOTE: the rect Move drives and the one it bumps into
+static void
+add_default_entities(GameState *game_state, Rect player, Rect other){
+    if(game_state->entities){
+        Color white = {1.0f, 1.0f, 1.0f, 1.0f};
+        game_state->player = entity_add_rect(game_state->entities, player, vec2(0, 0), pack_color(white));
+        entity_add_rect(game_state->entities, other, vec2(0, 0), pack_color(white));
+    }
+}
+
+static void
+simulate(GameMemory *memory, Events *events, Controller *controller, GameFrame *frame){
     GameState *game_state = (GameState *)memory->permanent_storage;
     
     if(!memory->initialized){
         memory->initialized = true;
-
-        Vec2 box1[4] = {{100, 100}, {200, 100}, {200, 200}, {100, 200}};
-        copy_array(game_state->box1, box1, array_count(box1));
-
-        Vec2 box2[4] = {{100, 300}, {200, 300}, {200, 400}, {100, 400}};
-        copy_array(game_state->box2, box2, array_count(box2));
+        init_arena(memory, game_state);
+#if DEBUG
+        // NOTE: nothing renders before the first simulate, temporary_storage is free scratch here
+        Assert(trig_self_check((f32 *)memory->temporary_storage));
+#endif
 
         Vec2 background[4] = {{0.0f, 0.0f}, {16.0f, 0.0f}, {0.0f, 10.0f}, {16.0f, 10.0f}};
         copy_array(game_state->test_background, background, array_count(background));
 
-        game_state->r1 = rect(vec2(100, 100), vec2(50, 50));
-        game_state->r2 = rect(vec2(100, 300), vec2(100, 100));
+        add_default_entities(game_state, rect(vec2(100, 100), vec2(50, 50)), rect(vec2(100, 300), vec2(100, 100)));
         game_state->one = true;
         game_state->two = false;
         game_state->three = false;
@@ -504,6 +1693,12 @@ MAIN_GAME_LOOP(main_game_loop){
             if(event->key == KEY_3){
                 game_state->three = !game_state->three;
             }
+            if(event->key == KEY_4){
+                game_state->fountain = !game_state->fountain;
+            }
+            if(event->key == KEY_5){
+                game_state->linear_blend = !game_state->linear_blend;
+            }
         }
         if(event->type == EVENT_KEYUP){
             if(event->key == KEY_ESCAPE){
@@ -524,196 +1719,162 @@ MAIN_GAME_LOOP(main_game_loop){
         }
     }
 
-    f32 speed = 4.0f;
-
-    if(game_state->move.up){
-        game_state->r1.y += speed;
-    }
-    if(game_state->move.down){
-        game_state->r1.y -= speed;
-    }
-    if(game_state->move.left){
-        game_state->r1.x -= speed;
-    }
-    if(game_state->move.right){
-        game_state->r1.x += speed;
-    }
-
-    Color red =     {1.0f, 0.0f, 0.0f,  0.5f};
-    Color green =   {0.0f, 1.0f, 0.0f,  0.5f};
-    Color blue =    {0.0f, 0.0f, 1.0f,  0.5f};
-    Color magenta = {1.0f, 0.0f, 1.0f,  0.5f};
-    Color pink =    {0.92f, 0.62f, 0.96f, 0.5f};
-    Color yellow =  {0.9f, 0.9f, 0.0f,  0.5f};
-    Color teal =    {0.0f, 1.0f, 1.0f,  0.5f};
-    Color orange =  {1.0f, 0.5f, 0.15f,  0.5f};
-    Color dgray =   {0.5f, 0.5f, 0.5f,  0.5f};
-    Color lgray =   {0.8f, 0.8f, 0.8f,  0.5f};
-    Color white =   {1.0f, 1.0f, 1.0f,  1.0f};
-    Color black =   {0.0f, 0.0f, 0.0f,  1.0f};
-
-    clear(render_buffer, black);
-
-    Vec2 test_t1[3] =  {{0.5f, 10.5f},   {0.5f, 5.5f},    {2.5f, 8.5f}};
-    Vec2 test_t2[3] =  {{0.5f, 5.5f},    {3.5f, 4.5f},    {0.5f, 0.5f}};
-    Vec2 test_t3[3] =  {{0.5f, 10.5f},   {2.5f, 8.5f},    {4.5f, 10.5f}};
-    Vec2 test_t4[3] =  {{2.5f, 8.5f},    {0.5f, 5.5f},    {3.5f, 4.5f}};
-    Vec2 test_t5[3] =  {{0.5f, 0.5f},    {3.5f, 4.5f},    {6.5f, 1.5f}};
-    Vec2 test_t6[3] =  {{2.5f, 8.5f},    {4.5f, 10.5f},   {6.5f, 7.5f}};
-    Vec2 test_t7[3] =  {{2.5f, 8.5f},    {6.5f, 7.5f},    {3.5f, 4.5f}};
-    Vec2 test_t8[3] =  {{3.5f, 4.5f},    {6.5f, 4.5f},    {6.5f, 7.5f}};
-    Vec2 test_t9[3] =  {{3.5f, 4.5f},    {6.5f, 4.5f},    {6.5f, 1.5f}};
-    Vec2 test_t10[3] = {{0.5f, 0.5f},    {6.5f, 1.5f},    {15.5f, 0.5f}};
-    Vec2 test_t11[3] = {{4.5f, 10.5f},   {6.5f, 7.5f},    {10.5f, 10.5f}};
-    Vec2 test_t12[3] = {{6.5f, 7.5f},    {9.5f, 4.5f},    {10.5f, 10.5f}};
-    Vec2 test_t13[3] = {{6.5f, 7.5f},    {6.5f, 4.5f},    {9.5f, 4.5f}};
-    Vec2 test_t14[3] = {{6.5f, 4.5f},    {6.5f, 1.5f},    {9.5f, 4.5f}};
-    Vec2 test_t15[3] = {{6.5f, 1.5f},    {9.5f, 4.5f},    {10.15f, 4.20f}};
-    Vec2 test_t16[3] = {{10.5f, 10.5f},  {9.5f, 4.5f},    {10.75f, 6.25f}};
-    Vec2 test_t17[3] = {{9.5f, 4.5f},    {10.75f, 6.25f}, {10.4f, 4.75f}};
-    Vec2 test_t18[3] = {{9.5f, 4.5f},    {10.4f, 4.75f},  {10.15f, 4.20f}};
-    Vec2 test_t19[3] = {{6.5f, 1.5f},    {15.5f, 0.5f},   {10.15f, 4.20f}};
-    Vec2 test_t20[3] = {{10.5f, 10.5f},  {16.5f, 10.5f},  {10.75f, 6.25f}};
-    Vec2 test_t21[3] = {{10.75f, 6.25f}, {16.5f, 10.5f},  {11.8f, 5.1f}};
-    Vec2 test_t22[3] = {{10.75f, 6.25f}, {10.4f, 4.75f},  {11.8f, 5.1f}};
-    Vec2 test_t23[3] = {{10.4f, 4.75f},  {11.8f, 5.1f},   {16.5f, 1.5f}};
-    Vec2 test_t24[3] = {{10.4f, 4.75f},  {10.15f, 4.20f}, {16.5f, 1.5f}};
-    Vec2 test_t25[3] = {{10.15f, 4.20f}, {15.5f, 0.5f},   {16.5f, 1.5f}};
-    Vec2 test_t26[3] = {{16.5f, 1.5f},   {16.5f, 10.5f},  {11.8f, 5.1f}};
-    Vec2 test_t27[3] = {{15.5f, 0.5f},   {16.5f, 0.5f},   {16.5f, 1.5f}};
-    
-    draw_rect_pts(render_buffer, game_state->test_background, white);
-
-    bool fill = game_state->two;
-    if(game_state->one){
-        draw_triangle(render_buffer, test_t1,  red, true);
-        draw_triangle(render_buffer, test_t2,  yellow, true);
-        draw_triangle(render_buffer, test_t3,  blue, true);
-        draw_triangle(render_buffer, test_t4,  green, true);
-        draw_triangle(render_buffer, test_t5,  red, true);
-        draw_triangle(render_buffer, test_t6,  yellow, true);
-        draw_triangle(render_buffer, test_t7,  pink, true);
-        draw_triangle(render_buffer, test_t8,  teal, true);
-        draw_triangle(render_buffer, test_t9,  blue, true);
-        draw_triangle(render_buffer, test_t10, green, true);
-        draw_triangle(render_buffer, test_t11, green, true);
-        draw_triangle(render_buffer, test_t12, blue, true);
-        draw_triangle(render_buffer, test_t13, red, true);
-        draw_triangle(render_buffer, test_t14, pink, true);
-        draw_triangle(render_buffer, test_t15, teal, true);
-        draw_triangle(render_buffer, test_t16, yellow, true);
-        draw_triangle(render_buffer, test_t17, green, true);
-        draw_triangle(render_buffer, test_t18, orange, true);
-        draw_triangle(render_buffer, test_t19, yellow, true);
-        draw_triangle(render_buffer, test_t20, red, true);
-        draw_triangle(render_buffer, test_t21, teal, true);
-        draw_triangle(render_buffer, test_t22, blue, true);
-        draw_triangle(render_buffer, test_t23, yellow, true);
-        draw_triangle(render_buffer, test_t24, pink, true);
-        draw_triangle(render_buffer, test_t25, red, true);
-        draw_triangle(render_buffer, test_t26, green, true);
-        draw_triangle(render_buffer, test_t27, blue, true);
+    // NOTE: pixels per second, 4 pixels a frame at the platform's 30hz
+    f32 speed = 120.0f;
+
+    if(game_state->entities){
+        i32 player = entity_index(game_state->entities, game_state->player);
+        if(player >= 0){
+            game_state->entities->vx[player] = speed * ((f32)game_state->move.right - (f32)game_state->move.left);
+            game_state->entities->vy[player] = speed * ((f32)game_state->move.up - (f32)game_state->move.down);
+        }
+
+        TIMED_BLOCK("entity_integrate"){
+            entity_integrate(game_state->entities, controller->dt);
+        }
     }
-    
-    memcpy(memory->temporary_storage, render_buffer->memory, render_buffer->memory_size);
 
-    for(f32 y=round_ff(game_state->test_background[0].y); y <= round_ff(game_state->test_background[2].y); ++y){
-        for(f32 x=round_ff(game_state->test_background[0].x); x <= (round_ff(game_state->test_background[1].x) + 1.0f); ++x){
-            Color c = get_color_test(memory, render_buffer, x, y);
-            f32 new_x = x * 48.0f;
-            f32 new_y = y * 48.0f;
-            for(f32 y2=new_y; y2 < (new_y + 47.0f); ++y2){
-                for(f32 x2=new_x; x2 < (new_x + 47.0f); ++x2){
-                    draw_pixel(render_buffer, x2, y2, c);
-                }
-            }
+    if(game_state->transforms){
+        TIMED_BLOCK("transform_update"){
+            transform_update(game_state->transforms);
+        }
+    }
+
+    if(game_state->particles){
+        fountain_run(game_state->particles, game_state->fountain);
+        TIMED_BLOCK("particle_update"){
+            frame->particles = particle_update(game_state->particles, controller->dt);
+        }
+    }
+
+    copy_array(frame->test_background, game_state->test_background, array_count(frame->test_background));
+    frame->one = game_state->one;
+    frame->two = game_state->two;
+    frame->three = game_state->three;
+    frame->profile_overlay = (memory->profile_state && memory->profile_state->overlay);
+    frame->profile_bar_count = 0;
+    if(frame->profile_overlay){
+        // NOTE: profile_end_frame runs on this thread between simulates, so the ring is stable here
+        ProfileHotspot hotspots[PROFILE_OVERLAY_BARS];
+        frame->profile_bar_count = profile_top_hotspots(memory->profile_state, 32, hotspots, array_count(hotspots));
+        for(ui32 i=0; i < frame->profile_bar_count; ++i){
+            frame->profile_frame_percent[i] = hotspots[i].frame_percent;
+        }
+    }
+    frame->linear_blend = game_state->linear_blend;
+}
+
+// NOTE: only reads frame, temporary_storage is the only part of memory it may touch
+static void
+render(GameMemory *memory, RenderBuffer *render_buffer, GameFrame *frame){
+    render_buffer->linear_blend = frame->linear_blend;
+    TIMED_BLOCK("draw_test_scene"){
+        draw_test_scene(memory, render_buffer, frame->test_background, frame->one, frame->two, frame->three);
+    }
+
+    if(frame->particles){
+        Arena scratch;
+        arena_init(&scratch, memory->temporary_storage, memory->temporary_storage_size);
+        TIMED_BLOCK("particle_render"){
+            particle_render(frame->particles, render_buffer, &scratch, memory->parallel_for);
+        }
+    }
+
+    if(frame->profile_overlay){
+        draw_profile_overlay(render_buffer, frame);
+    }
+}
+
+#define LAYOUT_FIELD(type, name) {#name, #type, (ui32)offsetof(GameState, name), (ui32)sizeof(((GameState *)0)->name), 0},
+#define LAYOUT_ARRAY(type, name, count) {#name, #type "[" #count "]", (ui32)offsetof(GameState, name), (ui32)sizeof(((GameState *)0)->name), 0},
+#define LAYOUT_ARENA(type, name) {#name, #type " *", (ui32)offsetof(GameState, name), (ui32)sizeof(((GameState *)0)->name), (ui32)sizeof(type)},
+global GameStateField game_state_fields[] = {
+    GAME_STATE_FIELDS(LAYOUT_FIELD, LAYOUT_ARRAY, LAYOUT_ARENA)
+};
+
+static ui64
+hash_bytes(ui64 hash, void *bytes, ui64 count){
+    // NOTE: FNV-1a
+    for(ui64 i=0; i < count; ++i){
+        hash = (hash ^ ((ui8 *)bytes)[i]) * 0x100000001B3;
+    }
+    return(hash);
+}
+
+GAME_STATE_LAYOUT(game_state_layout){
+    GameStateLayout result = {0};
+    result.version = GAME_STATE_VERSION;
+    result.size = sizeof(GameState);
+    result.field_count = array_count(game_state_fields);
+    result.fields = game_state_fields;
+
+    result.hash = hash_bytes(0xCBF29CE484222325, &result.version, sizeof(result.version));
+    result.hash = hash_bytes(result.hash, &result.size, sizeof(result.size));
+    for(ui32 i=0; i < result.field_count; ++i){
+        GameStateField *field = &game_state_fields[i];
+        result.hash = hash_bytes(result.hash, field->name, string_length(field->name));
+        result.hash = hash_bytes(result.hash, field->type, string_length(field->type));
+        result.hash = hash_bytes(result.hash, &field->offset, sizeof(field->offset));
+        result.hash = hash_bytes(result.hash, &field->size, sizeof(field->size));
+        result.hash = hash_bytes(result.hash, &field->target_size, sizeof(field->target_size));
+    }
+    return(result);
+}
+
+MIGRATE_GAME_STATE(migrate_game_state){
+    // NOTE: fields that were renamed or changed type get converted here, find them in old_state by
+    // name with game_state_field.
+    GameState *game_state = (GameState *)memory->permanent_storage;
+    if(!game_state->arena.base){
+        init_arena(memory, game_state);
+    }
+    else{
+        // NOTE: ARENA fields that were not carried over are new or point at an old layout, the old
+        // allocation stays behind in the arena
+        if(!game_state->transforms){
+            game_state->transforms = transform_hierarchy(&game_state->arena, TRANSFORM_CAPACITY);
+        }
+        if(!game_state->entities){
+            game_state->entities = entity_store(&game_state->arena, ENTITY_CAPACITY);
         }
+        if(!game_state->particles){
+            game_state->particles = fountain(&game_state->arena, vec2(480.0f, 40.0f), FOUNTAIN_SPARK_CAPACITY, FOUNTAIN_SMOKE_CAPACITY);
+        }
+    }
+
+    // NOTE: r1 / r2 were plain rects before the entity store, r1 was the one Move drove. A store that
+    // comes up empty gets them back when they are still Rects, and the rects simulate starts with when not.
+    if(game_state->entities && !game_state->entities->count){
+        Rect player = rect(vec2(100, 100), vec2(50, 50));
+        Rect other = rect(vec2(100, 300), vec2(100, 100));
+        GameStateField *r1 = game_state_field(old_layout, "r1");
+        GameStateField *r2 = game_state_field(old_layout, "r2");
+        if(r1 && r2 && r1->size == sizeof(Rect) && r2->size == sizeof(Rect) &&
+           string_equal(r1->type, "Rect") && string_equal(r2->type, "Rect") &&
+           r1->offset + r1->size <= old_layout->size && r2->offset + r2->size <= old_layout->size){
+            memcpy(&player, (ui8 *)old_state + r1->offset, sizeof(Rect));
+            memcpy(&other, (ui8 *)old_state + r2->offset, sizeof(Rect));
+        }
+        add_default_entities(game_state, player, other);
     }
+}
+
+SIMULATE_GAME(simulate_game){
+    global_profile_state = memory->profile_state;
+    simulate(memory, events, controller, frame);
+}
+
+RENDER_GAME(render_game){
+    global_profile_state = memory->profile_state;
+    render(memory, render_buffer, frame);
+}
+
+MAIN_GAME_LOOP(main_game_loop){
+    global_profile_state = memory->profile_state;
 
-    scale_pts(test_t1, array_count(test_t1), 48.0f);
-    scale_pts(test_t2, array_count(test_t2), 48.0f);
-    scale_pts(test_t3, array_count(test_t3), 48.0f);
-    scale_pts(test_t4, array_count(test_t4), 48.0f);
-    scale_pts(test_t5, array_count(test_t5), 48.0f);
-    scale_pts(test_t6, array_count(test_t6), 48.0f);
-    scale_pts(test_t7, array_count(test_t7), 48.0f);
-    scale_pts(test_t8, array_count(test_t8), 48.0f);
-    scale_pts(test_t9, array_count(test_t9), 48.0f);
-    scale_pts(test_t10, array_count(test_t10), 48.0f);
-    scale_pts(test_t11, array_count(test_t11), 48.0f);
-    scale_pts(test_t12, array_count(test_t12), 48.0f);
-    scale_pts(test_t13, array_count(test_t13), 48.0f);
-    scale_pts(test_t14, array_count(test_t14), 48.0f);
-    scale_pts(test_t15, array_count(test_t15), 48.0f);
-    scale_pts(test_t16, array_count(test_t16), 48.0f);
-    scale_pts(test_t17, array_count(test_t17), 48.0f);
-    scale_pts(test_t18, array_count(test_t18), 48.0f);
-    scale_pts(test_t19, array_count(test_t19), 48.0f);
-    scale_pts(test_t20, array_count(test_t20), 48.0f);
-    scale_pts(test_t21, array_count(test_t21), 48.0f);
-    scale_pts(test_t22, array_count(test_t22), 48.0f);
-    scale_pts(test_t23, array_count(test_t23), 48.0f);
-    scale_pts(test_t24, array_count(test_t24), 48.0f);
-    scale_pts(test_t25, array_count(test_t25), 48.0f);
-    scale_pts(test_t26, array_count(test_t26), 48.0f);
-    scale_pts(test_t27, array_count(test_t27), 48.0f);
-
-    if(game_state->two){
-        draw_triangle_outline(render_buffer, test_t1, red, black, fill);
-        draw_triangle_outline(render_buffer, test_t2, yellow, black, fill);
-        draw_triangle_outline(render_buffer, test_t3, blue, black, fill);
-        draw_triangle_outline(render_buffer, test_t4, green, black, fill);
-        draw_triangle_outline(render_buffer, test_t5, red, black, fill);
-        draw_triangle_outline(render_buffer, test_t6, yellow, black, fill);
-        draw_triangle_outline(render_buffer, test_t7, pink, black, fill);
-        draw_triangle_outline(render_buffer, test_t8, teal, black, fill);
-        draw_triangle_outline(render_buffer, test_t9, blue, black, fill);
-        draw_triangle_outline(render_buffer, test_t10, green, black, fill);
-        draw_triangle_outline(render_buffer, test_t11, green, black, fill);
-        draw_triangle_outline(render_buffer, test_t12, blue, black, fill);
-        draw_triangle_outline(render_buffer, test_t13, red, black, fill);
-        draw_triangle_outline(render_buffer, test_t14, pink, black, fill);
-        draw_triangle_outline(render_buffer, test_t15, teal, black, fill);
-        draw_triangle_outline(render_buffer, test_t16, yellow, black, fill);
-        draw_triangle_outline(render_buffer, test_t17, green, black, fill);
-        draw_triangle_outline(render_buffer, test_t18, orange, black, fill);
-        draw_triangle_outline(render_buffer, test_t19, yellow, black, fill);
-        draw_triangle_outline(render_buffer, test_t20, red, black, fill);
-        draw_triangle_outline(render_buffer, test_t21, teal, black, fill);
-        draw_triangle_outline(render_buffer, test_t22, blue, black, fill);
-        draw_triangle_outline(render_buffer, test_t23, yellow, black, fill);
-        draw_triangle_outline(render_buffer, test_t24, pink, black, fill);
-        draw_triangle_outline(render_buffer, test_t25, red, black, fill);
-        draw_triangle_outline(render_buffer, test_t26, green, black, fill);
-        draw_triangle_outline(render_buffer, test_t27, blue, black, fill);
-    }
-    if(game_state->three){
-        draw_triangle_outline(render_buffer, test_t1, red, black, false);
-        draw_triangle_outline(render_buffer, test_t2, yellow, black, false);
-        draw_triangle_outline(render_buffer, test_t3, blue, black, false);
-        draw_triangle_outline(render_buffer, test_t4, green, black, false);
-        draw_triangle_outline(render_buffer, test_t5, red, black, false);
-        draw_triangle_outline(render_buffer, test_t6, yellow, black, false);
-        draw_triangle_outline(render_buffer, test_t7, pink, black, false);
-        draw_triangle_outline(render_buffer, test_t8, teal, black, false);
-        draw_triangle_outline(render_buffer, test_t9, blue, black, false);
-        draw_triangle_outline(render_buffer, test_t10, green, black, false);
-        draw_triangle_outline(render_buffer, test_t11, green, black, false);
-        draw_triangle_outline(render_buffer, test_t12, blue, black, false);
-        draw_triangle_outline(render_buffer, test_t13, red, black, false);
-        draw_triangle_outline(render_buffer, test_t14, pink, black, false);
-        draw_triangle_outline(render_buffer, test_t15, teal, black, false);
-        draw_triangle_outline(render_buffer, test_t16, yellow, black, false);
-        draw_triangle_outline(render_buffer, test_t17, green, black, false);
-        draw_triangle_outline(render_buffer, test_t18, orange, black, false);
-        draw_triangle_outline(render_buffer, test_t19, yellow, black, false);
-        draw_triangle_outline(render_buffer, test_t20, red, black, false);
-        draw_triangle_outline(render_buffer, test_t21, teal, black, false);
-        draw_triangle_outline(render_buffer, test_t22, blue, black, false);
-        draw_triangle_outline(render_buffer, test_t23, yellow, black, false);
-        draw_triangle_outline(render_buffer, test_t24, pink, black, false);
-        draw_triangle_outline(render_buffer, test_t25, red, black, false);
-        draw_triangle_outline(render_buffer, test_t26, green, black, false);
-        draw_triangle_outline(render_buffer, test_t27, blue, black, false);
+    GameFrame frame = {0};
+    simulate(memory, events, controller, &frame);
+    if(!memory->fast_forward){
+        render(memory, render_buffer, &frame);
     }
 }
@@ -50,9 +50,11 @@ typedef double f64;
 typedef int32_t bool;
 enum{false, true};
 
+#include "profile.h"
+
 typedef enum{MOUSE_NONE, MOUSE_LBUTTON, MOUSE_RBUTTON, MOUSE_MBUTTON, MOUSE_XBUTTON1, MOUSE_XBUTTON2,MOUSE_WHEEL} EventMouse;
 typedef enum{PAD_NONE, PAD_UP, PAD_DOWN, PAD_LEFT, PAD_RIGHT, PAD_BACK} EventPad;
-typedef enum{KEY_NONE, KEY_W, KEY_A, KEY_S, KEY_D, KEY_L, KEY_P, KEY_ESCAPE, KEY_1, KEY_2, KEY_3} EventKey;
+typedef enum{KEY_NONE, KEY_W, KEY_A, KEY_S, KEY_D, KEY_L, KEY_P, KEY_ESCAPE, KEY_1, KEY_2, KEY_3, KEY_F1, KEY_F2, KEY_F3, KEY_4, KEY_5} EventKey;
 typedef enum{EVENT_NONE, EVENT_KEYDOWN, EVENT_KEYUP, EVENT_MOUSEWHEEL, EVENT_MOUSEDOWN, EVENT_MOUSEUP, EVENT_MOUSEMOTION, EVENT_TEXT, EVENT_PADDOWN, EVENT_PADUP} EventType;
 
 typedef struct Event{
@@ -82,6 +84,7 @@ typedef struct RenderBuffer{
     int width;
     int height;
     int pitch;
+    bool linear_blend; // NOTE: blend in linear light (srgb.h) instead of on the sRGB bytes, set by the game
 } RenderBuffer;
 
 typedef struct FileData{
@@ -107,6 +110,18 @@ typedef WRITE_ENTIRE_FILE(WriteEntireFile);
 #define FREE_FILE_MEMORY(name) void name(void *memory)
 typedef FREE_FILE_MEMORY(FreeFileMemory);
 
+// NOTE: format comes from the extension: .png, .ppm, anything else is qoi
+#define CAPTURE_FRAME(name) bool name(RenderBuffer *buffer, char *filename)
+typedef CAPTURE_FRAME(CaptureFrame);
+
+#define WORK_FUNCTION(name) void name(void *data, ui32 index)
+typedef WORK_FUNCTION(WorkFunction);
+
+// NOTE: calls work for every index in [0, count) spread over the platform's worker threads and returns
+// once all of them are done, in no particular order
+#define PARALLEL_FOR(name) void name(WorkFunction *work, void *data, ui32 count)
+typedef PARALLEL_FOR(ParallelFor);
+
 typedef struct GameMemory{
 	bool running;
     bool initialized;
@@ -122,11 +137,51 @@ typedef struct GameMemory{
     ReadEntireFile *read_entire_file;
     WriteEntireFile *write_entire_file;
     FreeFileMemory *free_file_memory;
+
+    CaptureFrame *capture_frame; // NOTE: async, false when the platform had to drop it
+
+    ProfileState *profile_state;
+
+    ParallelFor *parallel_for; // NOTE: 0 when the platform has no worker threads, see run_parallel
+
+    bool fast_forward; // NOTE: set while the platform seeks a replay, simulate only and skip drawing
 } GameMemory;
 
 #define MAIN_GAME_LOOP(name) void name(GameMemory *memory, RenderBuffer *render_buffer, Events *events, Controller *controller)
 typedef MAIN_GAME_LOOP(MainGameLoop);
 
+// NOTE: golden image scenes, rendered headless by the platform and compared against data\golden
+typedef struct SceneInfo{
+    char name[64];
+    ui32 overdraw_count; // NOTE: pixels covered by more than one triangle, should always be 0 for a shared edge mesh
+} SceneInfo;
+
+// NOTE: returns false once scene_index is past the last scene
+#define RENDER_SCENE(name) bool name(GameMemory *memory, RenderBuffer *render_buffer, ui32 scene_index, SceneInfo *info)
+typedef RENDER_SCENE(RenderScene);
+
+// NOTE: self checks the golden runner runs after the scenes, a check that does not pass is a failure
+typedef struct CheckInfo{
+    char name[64];
+    bool passed;
+} CheckInfo;
+
+// NOTE: returns false once check_index is past the last check, temporary_storage is scratch
+#define RUN_CHECK(name) bool name(GameMemory *memory, ui32 check_index, CheckInfo *info)
+typedef RUN_CHECK(RunCheck);
+
+static void
+run_parallel(ParallelFor *parallel_for, WorkFunction *work, void *data, ui32 count){
+    if(parallel_for){
+        parallel_for(work, data, count);
+    }
+    else{
+        for(ui32 i=0; i < count; ++i){
+            work(data, i);
+        }
+    }
+}
+
 static int
 string_length(char* s){
     int count = 0;
@@ -169,6 +224,76 @@ cat_strings(char *left, char *right, char *dest){
     *dest++ = 0;
 }
 
+static bool
+string_equal(char *a, char *b){
+    while(*a && *a == *b){
+        ++a;
+        ++b;
+    }
+    return(*a == *b);
+}
+
+static bool
+string_ends_with(char *s, char *suffix){
+    int s_length = string_length(s);
+    int suffix_length = string_length(suffix);
+    if(suffix_length > s_length){
+        return(false);
+    }
+
+    s += s_length - suffix_length;
+    for(int i=0; i < suffix_length; ++i){
+        if(s[i] != suffix[i]){
+            return(false);
+        }
+    }
+    return(true);
+}
+
+static char *
+skip_spaces(char *s){
+    while(*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r'){
+        ++s;
+    }
+    return(s);
+}
+
+// NOTE: parses an unsigned number after any leading whitespace and moves *s past it
+static bool
+parse_ui32(char **s, ui32 *value){
+    char *at = skip_spaces(*s);
+    if(*at < '0' || *at > '9'){
+        return(false);
+    }
+
+    ui32 result = 0;
+    while(*at >= '0' && *at <= '9'){
+        result = (result * 10) + (*at - '0');
+        ++at;
+    }
+
+    *value = result;
+    *s = at;
+    return(true);
+}
+
+// NOTE: copies the next whitespace separated word into dest and moves *s past it
+static bool
+parse_word(char **s, char *dest, ui32 dest_size){
+    char *at = skip_spaces(*s);
+    ui32 length = 0;
+    while(*at && *at != ' ' && *at != '\t' && *at != '\n' && *at != '\r'){
+        if(length + 1 < dest_size){
+            dest[length++] = *at;
+        }
+        ++at;
+    }
+    dest[length] = 0;
+
+    *s = at;
+    return(length > 0);
+}
+
 static void
 get_root_dir(char *left, i64 length, char *full_path){
     int i=0;
@@ -178,6 +303,39 @@ get_root_dir(char *left, i64 length, char *full_path){
     *left++ = 0;
 }
 
+// NOTE: linear allocator over a block of GameMemory. Nothing is freed one at a time, arena_reset drops
+// everything. The memory comes zeroed from the platform, arena_push does not clear what it hands out.
+typedef struct Arena{
+    ui8 *base;
+    ui64 size;
+    ui64 used;
+} Arena;
+
+static void
+arena_init(Arena *arena, void *base, ui64 size){
+    arena->base = (ui8 *)base;
+    arena->size = size;
+    arena->used = 0;
+}
+
+// NOTE: alignment has to be a power of two, returns 0 when the arena is full
+static void *
+arena_push(Arena *arena, ui64 size, ui64 alignment){
+    ui64 begin = (arena->used + (alignment - 1)) & ~(alignment - 1);
+    if(begin + size > arena->size){
+        return(0);
+    }
+    arena->used = begin + size;
+    return(arena->base + begin);
+}
+
+static void
+arena_reset(Arena *arena){
+    arena->used = 0;
+}
+
+#define push_array(arena, type, count) (type *)arena_push((arena), sizeof(type) * (count), 64)
+
 typedef struct Color{
     f32 r;
     f32 g;
@@ -185,6 +343,35 @@ typedef struct Color{
     f32 a;
 } Color;
 
+// NOTE: 0xAARRGGBB, the RenderBuffer's byte order, with r g b already multiplied by a. Blending over a
+// pixel is then src + dst * (255 - a) / 255 per channel in 8 bit integers. Color is what scenes are
+// written in, the draw_* functions and anything stored per entity take these.
+typedef struct PackedColor{
+    ui32 argb;
+} PackedColor;
+
+static PackedColor
+pack_color(Color c){
+    PackedColor result;
+    f32 a = c.a * 255.0f;
+    result.argb = ((ui32)(a + 0.5f) << 24) | ((ui32)((c.r * a) + 0.5f) << 16) | ((ui32)((c.g * a) + 0.5f) << 8) | (ui32)((c.b * a) + 0.5f);
+    return(result);
+}
+
+static Color
+unpack_color(PackedColor c){
+    Color result = {0};
+    ui32 a = c.argb >> 24;
+    if(a){
+        f32 inv_a = 1.0f / (f32)a;
+        result.r = (f32)((c.argb >> 16) & 0xFF) * inv_a;
+        result.g = (f32)((c.argb >> 8) & 0xFF) * inv_a;
+        result.b = (f32)(c.argb & 0xFF) * inv_a;
+        result.a = (f32)a / 255.0f;
+    }
+    return(result);
+}
+
 #include "vectors.h"
 
 typedef struct Move{
@@ -228,8 +415,8 @@ triangle(Vec2 p0, Vec2 p1, Vec2 p2){
     if(result.p0.x > result.p2.x) { swap_v2(&result.p0, &result.p2); };
     if(result.p1.x > result.p2.x) { swap_v2(&result.p1, &result.p2); };
 
-    f32 left_x = p0.x;
-    f32 right_x = p2.x;
+    f32 left_x = result.p0.x;
+    f32 right_x = result.p2.x;
 
     if(result.p0.y > result.p1.y) { swap_v2(&result.p0, &result.p1); };
     if(result.p0.y > result.p2.y) { swap_v2(&result.p0, &result.p2); };
@@ -243,6 +430,7 @@ triangle(Vec2 p0, Vec2 p1, Vec2 p2){
     Rect r = rect(pos, dim);
 
     result.rect = r;
+    return(result);
 }
 
 static bool
@@ -278,17 +466,109 @@ rect_contains_rect(Rect r1, Rect r2){
     return false;
 }
 
+typedef struct TransformHierarchy TransformHierarchy;
+typedef struct EntityStore EntityStore;
+typedef struct ParticleSystem ParticleSystem;
+
+// NOTE: here rather than in entity.h so GameState can hold one by value
+typedef struct EntityHandle{
+    ui32 id;
+    ui32 generation; // NOTE: 0 is the null handle
+} EntityHandle;
+
+// NOTE: GameState sits at the start of permanent_storage, the arena starts GAME_STATE_RESERVE in so
+// GameState can grow across a reload without running into what was allocated after it
+#define GAME_STATE_RESERVE Kilobytes(64)
+
+// NOTE: every GameState field goes through this list, game_state_layout describes GameState from it so
+// the platform can carry fields over by name when a reload changes the layout. ARENA fields point at a
+// struct allocated in the arena, they are only carried over when its size and GAME_STATE_VERSION both
+// match. Bump GAME_STATE_VERSION when a type used here or in the arena changes without changing its size.
+#define GAME_STATE_VERSION 2 // NOTE: 2, EntityStore and ParticlePool colors became PackedColor
+#define GAME_STATE_FIELDS(FIELD, ARRAY, ARENA) \
+    FIELD(Arena, arena) \
+    ARENA(TransformHierarchy, transforms) \
+    FIELD(Move, move) \
+    ARENA(EntityStore, entities) \
+    FIELD(EntityHandle, player) \
+    ARENA(ParticleSystem, particles) \
+    FIELD(bool, fountain) \
+    FIELD(bool, linear_blend) \
+    ARRAY(Vec2, test_background, 4) \
+    FIELD(bool, one) \
+    FIELD(bool, two) \
+    FIELD(bool, three)
+
+#define GAME_STATE_FIELD(type, name) type name;
+#define GAME_STATE_ARRAY(type, name, count) type name[count];
+#define GAME_STATE_ARENA(type, name) type *name;
 typedef struct GameState{
-    Move move;
+    GAME_STATE_FIELDS(GAME_STATE_FIELD, GAME_STATE_ARRAY, GAME_STATE_ARENA)
+} GameState;
+
+typedef struct GameStateField{
+    char name[32];
+    char type[32]; // NOTE: "Vec2[4]" for arrays
+    ui32 offset;
+    ui32 size;
+    ui32 target_size; // NOTE: sizeof the struct an ARENA field points at, 0 for the rest
+} GameStateField;
+
+typedef struct GameStateLayout{
+    ui64 hash;
+    ui32 version;
+    ui32 size;
+    ui32 field_count;
+    GameStateField *fields; // NOTE: owned by the game dll, copy it before unloading
+} GameStateLayout;
+
+static GameStateField *
+game_state_field(GameStateLayout *layout, char *name){
+    for(ui32 i=0; i < layout->field_count; ++i){
+        if(string_equal(layout->fields[i].name, name)){
+            return(&layout->fields[i]);
+        }
+    }
+    return(0);
+}
+
+#define GAME_STATE_LAYOUT(name) GameStateLayout name(void)
+typedef GAME_STATE_LAYOUT(GameStateLayoutFunction);
+
+// NOTE: called after the platform copied every field whose name, type and size still match, everything
+// else is zero, ARENA fields included. old_state is a copy of the previous GameState described by old_layout.
+#define MIGRATE_GAME_STATE(name) void name(GameMemory *memory, GameStateLayout *old_layout, void *old_state)
+typedef MIGRATE_GAME_STATE(MigrateGameState);
+
+// NOTE: most frames simulated but not yet done rendering, the pipelined platform has one slot per frame.
+// Data a GameFrame points at has to stay untouched for this many simulates after the one that wrote it.
+#define GAME_FRAMES_IN_FLIGHT 3
+
+typedef struct ParticleFrame ParticleFrame;
+
+// NOTE: everything render_game needs to draw one frame, filled in by simulate_game. The pipelined
+// platform renders frame N from this while frame N+1 is already simulating, so rendering only reads
+// GameState through the particle snapshot it points at.
+#define PROFILE_OVERLAY_BARS 8
+
+typedef struct GameFrame{
     Vec2 test_background[4];
-    Vec2 box1[4];
-    Vec2 box2[4];
-    Rect r1;
-    Rect r2;
     bool one;
     bool two;
     bool three;
-} GameState;
+    bool profile_overlay;
+    bool linear_blend;
+    ui32 profile_bar_count;
+    f32 profile_frame_percent[PROFILE_OVERLAY_BARS]; // NOTE: top hotspots, taken in simulate so render never reads ProfileState
+    ParticleFrame *particles; // NOTE: one of GAME_FRAMES_IN_FLIGHT snapshots, 0 draws none
+} GameFrame;
+
+#define SIMULATE_GAME(name) void name(GameMemory *memory, Events *events, Controller *controller, GameFrame *frame)
+typedef SIMULATE_GAME(SimulateGame);
+
+// NOTE: memory is the platform's render memory, temporary_storage is scratch owned by the render thread
+#define RENDER_GAME(name) void name(GameMemory *memory, RenderBuffer *render_buffer, GameFrame *frame)
+typedef RENDER_GAME(RenderGame);
 
 #define GAME_H
 #endif
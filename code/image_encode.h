@@ -0,0 +1,246 @@
+#if !defined(IMAGE_ENCODE_H)
+
+// NOTE: encodes 0x00RRGGBB top down pixels into a complete file in memory. No platform calls and no
+// allocation, dest has to hold image_encode_bound bytes.
+//
+//   IMAGE_PPM  binary P6, no compression
+//   IMAGE_QOI  the "quite ok image" format, lossless and about as fast as a memcpy
+//   IMAGE_PNG  8 bit rgb with stored (uncompressed) deflate blocks, readable by everything but not small
+
+typedef enum{IMAGE_PPM, IMAGE_QOI, IMAGE_PNG} ImageFormat;
+
+typedef struct ImageWriter{
+    ui8 *at;
+} ImageWriter;
+
+static void
+image_put_u8(ImageWriter *writer, ui32 value){
+    *writer->at++ = (ui8)value;
+}
+
+static void
+image_put_u32_be(ImageWriter *writer, ui32 value){
+    writer->at[0] = (ui8)(value >> 24);
+    writer->at[1] = (ui8)(value >> 16);
+    writer->at[2] = (ui8)(value >> 8);
+    writer->at[3] = (ui8)value;
+    writer->at += 4;
+}
+
+static void
+image_put_bytes(ImageWriter *writer, char *bytes, ui32 count){
+    for(ui32 i=0; i < count; ++i){
+        *writer->at++ = (ui8)bytes[i];
+    }
+}
+
+// NOTE: png stores at most 65535 bytes per stored deflate block
+#define IMAGE_PNG_BLOCK_SIZE 65535
+
+static ui64
+image_encode_bound(ImageFormat format, ui32 width, ui32 height){
+    ui64 pixels = (ui64)width * height;
+    switch(format){
+        case IMAGE_PPM:{
+            return(32 + (pixels * 3));
+        } break;
+        case IMAGE_QOI:{
+            return(14 + (pixels * 4) + 8);
+        } break;
+        case IMAGE_PNG:{
+            ui64 raw = (ui64)height * (1 + ((ui64)width * 3));
+            ui64 blocks = (raw + IMAGE_PNG_BLOCK_SIZE - 1) / IMAGE_PNG_BLOCK_SIZE;
+            return(8 + 25 + 12 + 2 + raw + (blocks * 5) + 4 + 12);
+        } break;
+    }
+    return(0);
+}
+
+static ui32
+encode_ppm(ui8 *dest, ui32 *pixels, ui32 width, ui32 height){
+    ImageWriter writer = {dest};
+    char header[32];
+    int header_size = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+    image_put_bytes(&writer, header, header_size);
+    for(ui64 i=0; i < (ui64)width * height; ++i){
+        image_put_u8(&writer, pixels[i] >> 16);
+        image_put_u8(&writer, pixels[i] >> 8);
+        image_put_u8(&writer, pixels[i]);
+    }
+    return((ui32)(writer.at - dest));
+}
+
+// NOTE: see qoiformat.org, alpha is always 255 so QOI_OP_RGBA never comes up
+static ui32
+encode_qoi(ui8 *dest, ui32 *pixels, ui32 width, ui32 height){
+    ImageWriter writer = {dest};
+    image_put_bytes(&writer, "qoif", 4);
+    image_put_u32_be(&writer, width);
+    image_put_u32_be(&writer, height);
+    image_put_u8(&writer, 3); // NOTE: rgb
+    image_put_u8(&writer, 0); // NOTE: srgb
+
+    ui32 index[64] = {0};
+    ui32 previous = 0xFF000000;
+    ui32 run = 0;
+    ui64 count = (ui64)width * height;
+    for(ui64 i=0; i < count; ++i){
+        ui32 pixel = pixels[i] | 0xFF000000;
+        if(pixel == previous){
+            ++run;
+            if(run == 62 || i + 1 == count){
+                image_put_u8(&writer, 0xC0 | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        if(run){
+            image_put_u8(&writer, 0xC0 | (run - 1));
+            run = 0;
+        }
+
+        i32 r = (pixel >> 16) & 0xFF;
+        i32 g = (pixel >> 8) & 0xFF;
+        i32 b = pixel & 0xFF;
+        ui32 hash = ((r * 3) + (g * 5) + (b * 7) + (255 * 11)) % 64;
+        if(index[hash] == pixel){
+            image_put_u8(&writer, hash);
+        }
+        else{
+            index[hash] = pixel;
+            i8 dr = (i8)(r - (i32)((previous >> 16) & 0xFF));
+            i8 dg = (i8)(g - (i32)((previous >> 8) & 0xFF));
+            i8 db = (i8)(b - (i32)(previous & 0xFF));
+            i8 dr_dg = (i8)(dr - dg);
+            i8 db_dg = (i8)(db - dg);
+            if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1){
+                image_put_u8(&writer, 0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+            }
+            else if(dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7){
+                image_put_u8(&writer, 0x80 | (dg + 32));
+                image_put_u8(&writer, ((dr_dg + 8) << 4) | (db_dg + 8));
+            }
+            else{
+                image_put_u8(&writer, 0xFE);
+                image_put_u8(&writer, r);
+                image_put_u8(&writer, g);
+                image_put_u8(&writer, b);
+            }
+        }
+        previous = pixel;
+    }
+
+    image_put_bytes(&writer, "\0\0\0\0\0\0\0\1", 8);
+    return((ui32)(writer.at - dest));
+}
+
+static ui32
+image_crc32(ui8 *bytes, ui64 count){
+    local_static ui32 table[256];
+    local_static bool table_ready;
+    if(!table_ready){
+        for(ui32 i=0; i < 256; ++i){
+            ui32 value = i;
+            for(ui32 bit=0; bit < 8; ++bit){
+                value = (value & 1) ? (0xEDB88320 ^ (value >> 1)) : (value >> 1);
+            }
+            table[i] = value;
+        }
+        table_ready = true;
+    }
+
+    ui32 crc = 0xFFFFFFFF;
+    for(ui64 i=0; i < count; ++i){
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return(crc ^ 0xFFFFFFFF);
+}
+
+// NOTE: chunk data is already at writer->at + 8, fills in length, type and crc around it
+static void
+image_png_chunk(ImageWriter *writer, char *type, ui32 size){
+    ui8 *start = writer->at;
+    image_put_u32_be(writer, size);
+    image_put_bytes(writer, type, 4);
+    writer->at += size;
+    image_put_u32_be(writer, image_crc32(start + 4, size + 4));
+}
+
+typedef struct ImageDeflateStored{
+    ImageWriter *writer;
+    ui8 *block_header;
+    ui32 block_used;
+    ui64 remaining;
+    ui32 adler_a;
+    ui32 adler_b;
+} ImageDeflateStored;
+
+static void
+image_deflate_byte(ImageDeflateStored *deflate, ui8 value){
+    if(deflate->block_used == 0){
+        ui32 block_size = (deflate->remaining > IMAGE_PNG_BLOCK_SIZE) ? IMAGE_PNG_BLOCK_SIZE : (ui32)deflate->remaining;
+        image_put_u8(deflate->writer, (deflate->remaining == block_size) ? 1 : 0); // NOTE: BFINAL, BTYPE 00
+        image_put_u8(deflate->writer, block_size);
+        image_put_u8(deflate->writer, block_size >> 8);
+        image_put_u8(deflate->writer, ~block_size);
+        image_put_u8(deflate->writer, ~block_size >> 8);
+        deflate->block_used = block_size;
+    }
+
+    image_put_u8(deflate->writer, value);
+    --deflate->block_used;
+    --deflate->remaining;
+
+    // NOTE: adler32 of the uncompressed data, 5552 is the usual deferred modulo bound but this is not hot
+    deflate->adler_a = (deflate->adler_a + value) % 65521;
+    deflate->adler_b = (deflate->adler_b + deflate->adler_a) % 65521;
+}
+
+static ui32
+encode_png(ui8 *dest, ui32 *pixels, ui32 width, ui32 height){
+    ImageWriter writer = {dest};
+    image_put_bytes(&writer, "\x89PNG\r\n\x1A\n", 8);
+
+    ImageWriter chunk = {writer.at + 8};
+    image_put_u32_be(&chunk, width);
+    image_put_u32_be(&chunk, height);
+    image_put_u8(&chunk, 8); // NOTE: bit depth
+    image_put_u8(&chunk, 2); // NOTE: rgb
+    image_put_u8(&chunk, 0);
+    image_put_u8(&chunk, 0);
+    image_put_u8(&chunk, 0);
+    image_png_chunk(&writer, "IHDR", 13);
+
+    ui8 *data = writer.at + 8;
+    chunk.at = data;
+    image_put_u8(&chunk, 0x78); // NOTE: zlib, 32k window, no dictionary
+    image_put_u8(&chunk, 0x01);
+    ImageDeflateStored deflate = {&chunk, 0, 0, (ui64)height * (1 + ((ui64)width * 3)), 1, 0};
+    for(ui32 y=0; y < height; ++y){
+        image_deflate_byte(&deflate, 0); // NOTE: filter none
+        ui32 *row = pixels + ((ui64)y * width);
+        for(ui32 x=0; x < width; ++x){
+            image_deflate_byte(&deflate, (ui8)(row[x] >> 16));
+            image_deflate_byte(&deflate, (ui8)(row[x] >> 8));
+            image_deflate_byte(&deflate, (ui8)row[x]);
+        }
+    }
+    image_put_u32_be(&chunk, (deflate.adler_b << 16) | deflate.adler_a);
+    image_png_chunk(&writer, "IDAT", (ui32)(chunk.at - data));
+
+    image_png_chunk(&writer, "IEND", 0);
+    return((ui32)(writer.at - dest));
+}
+
+static ui32
+image_encode(ImageFormat format, ui8 *dest, ui32 *pixels, ui32 width, ui32 height){
+    switch(format){
+        case IMAGE_PPM: return(encode_ppm(dest, pixels, width, height));
+        case IMAGE_QOI: return(encode_qoi(dest, pixels, width, height));
+        case IMAGE_PNG: return(encode_png(dest, pixels, width, height));
+    }
+    return(0);
+}
+
+#define IMAGE_ENCODE_H
+#endif
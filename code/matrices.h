@@ -1,5 +1,7 @@
 #if !defined(MATRICES_H)
 
+#include <math.h>
+
 typedef union mat2{
     f32 e[4];
     struct{
@@ -216,5 +218,53 @@ m4(f32 a, f32 b, f32 c, f32 d,
     return(result);
 }
 
+// NOTE: 2d affine transforms act on column vectors (x, y, 1), x' = _11*x + _12*y + _13 and
+// y' = _21*x + _22*y + _23, so mul3x3(a, b) applies b first and then a
+static mat3
+translation3x3(f32 x, f32 y){
+    mat3 result = identity3x3();
+    result._13 = x;
+    result._23 = y;
+    return(result);
+}
+
+static mat3
+scaling3x3(f32 scalar, f32 origin_x, f32 origin_y){
+    mat3 result = identity3x3();
+    result._11 = result._22 = scalar;
+    result._13 = origin_x - (scalar * origin_x);
+    result._23 = origin_y - (scalar * origin_y);
+    return(result);
+}
+
+static mat3
+rotation3x3(f32 radians, f32 origin_x, f32 origin_y){
+    f32 c = cosf(radians);
+    f32 s = sinf(radians);
+    mat3 result = identity3x3();
+    result._11 = c;
+    result._12 = -s;
+    result._21 = s;
+    result._22 = c;
+    result._13 = origin_x - (c * origin_x) + (s * origin_y);
+    result._23 = origin_y - (s * origin_x) - (c * origin_y);
+    return(result);
+}
+
+// NOTE: mul3x3 for two affine transforms, the last rows are assumed to be 0 0 1
+static mat3
+affine_mul3x3(mat3 *a, mat3 *b){
+    mat3 result;
+    result._11 = (a->_11 * b->_11) + (a->_12 * b->_21);
+    result._12 = (a->_11 * b->_12) + (a->_12 * b->_22);
+    result._13 = (a->_11 * b->_13) + (a->_12 * b->_23) + a->_13;
+    result._21 = (a->_21 * b->_11) + (a->_22 * b->_21);
+    result._22 = (a->_21 * b->_12) + (a->_22 * b->_22);
+    result._23 = (a->_21 * b->_13) + (a->_22 * b->_23) + a->_23;
+    result._31 = result._32 = 0.0f;
+    result._33 = 1.0f;
+    return(result);
+}
+
 #define MATRICES_H
 #endif
@@ -0,0 +1,347 @@
+#if !defined(NARROWPHASE_H)
+
+// NOTE: separating axis tests for convex shapes, the narrow phase behind broadphase.h. Two convex shapes
+// are apart exactly when their projections onto one of the edge normals of either shape do not
+// overlap. When every axis overlaps, the shortest push that gets b off a along any of them is the
+// contact: normal is the direction of that push at unit length, depth its length. Overlap is strict
+// like rect_collide_rect, touching shapes do not count.
+//
+// Point order and winding do not matter, the polygons only have to be convex. Zero length edges are
+// skipped.
+//
+// sat_triangle_pairs runs the triangle test over a list of candidate pairs 4 at a time with SSE2 and
+// gives the same contacts as sat_triangle_triangle bit for bit.
+
+#include <float.h>
+#include "simd.h"
+#include "broadphase.h"
+
+#define POLYGON_MAX_POINTS 8
+
+typedef struct ConvexPolygon{
+    ui32 count;
+    Vec2 points[POLYGON_MAX_POINTS];
+} ConvexPolygon;
+
+typedef struct Contact{
+    Vec2 normal; // NOTE: unit length, moving b by normal * depth separates it from a, 0 0 when apart
+    f32 depth;   // NOTE: 0 when apart
+} Contact;
+
+// NOTE: triangles as structure of arrays for sat_triangle_pairs
+typedef struct TriangleArray{
+    ui32 count;
+    f32 *x0;
+    f32 *y0;
+    f32 *x1;
+    f32 *y1;
+    f32 *x2;
+    f32 *y2;
+} TriangleArray;
+
+static ConvexPolygon
+polygon_from_points(Vec2 *points, ui32 count){
+    Assert(count <= POLYGON_MAX_POINTS);
+    ConvexPolygon result = {0};
+    result.count = count;
+    for(ui32 i=0; i < count; ++i){
+        result.points[i] = points[i];
+    }
+    return(result);
+}
+
+static ConvexPolygon
+polygon_from_tri(Tri t){
+    ConvexPolygon result = {0};
+    result.count = 3;
+    result.points[0] = t.p0;
+    result.points[1] = t.p1;
+    result.points[2] = t.p2;
+    return(result);
+}
+
+static ConvexPolygon
+polygon_from_rect(Rect r){
+    ConvexPolygon result = {0};
+    result.count = 4;
+    result.points[0] = vec2(r.x, r.y);
+    result.points[1] = vec2(r.x + r.w, r.y);
+    result.points[2] = vec2(r.x + r.w, r.y + r.h);
+    result.points[3] = vec2(r.x, r.y + r.h);
+    return(result);
+}
+
+static bool
+triangle_array_init(TriangleArray *tris, Arena *arena, ui32 count){
+    tris->count = count;
+    tris->x0 = push_array(arena, f32, count);
+    tris->y0 = push_array(arena, f32, count);
+    tris->x1 = push_array(arena, f32, count);
+    tris->y1 = push_array(arena, f32, count);
+    tris->x2 = push_array(arena, f32, count);
+    tris->y2 = push_array(arena, f32, count);
+    return(tris->x0 && tris->y0 && tris->x1 && tris->y1 && tris->x2 && tris->y2);
+}
+
+static void
+triangle_array_set(TriangleArray *tris, ui32 index, Vec2 p0, Vec2 p1, Vec2 p2){
+    tris->x0[index] = p0.x;
+    tris->y0[index] = p0.y;
+    tris->x1[index] = p1.x;
+    tris->y1[index] = p1.y;
+    tris->x2[index] = p2.x;
+    tris->y2[index] = p2.y;
+}
+
+static ConvexPolygon
+triangle_array_polygon(TriangleArray *tris, ui32 index){
+    ConvexPolygon result = {0};
+    result.count = 3;
+    result.points[0] = vec2(tris->x0[index], tris->y0[index]);
+    result.points[1] = vec2(tris->x1[index], tris->y1[index]);
+    result.points[2] = vec2(tris->x2[index], tris->y2[index]);
+    return(result);
+}
+
+// NOTE: bounds of every triangle, to feed spatial_grid_build
+static void
+triangle_array_bounds(TriangleArray *tris, AabbArray *boxes){
+    Assert(boxes->count >= tris->count);
+    for(ui32 i=0; i < tris->count; ++i){
+        f32 min_x = (tris->x0[i] < tris->x1[i]) ? tris->x0[i] : tris->x1[i];
+        f32 max_x = (tris->x0[i] > tris->x1[i]) ? tris->x0[i] : tris->x1[i];
+        f32 min_y = (tris->y0[i] < tris->y1[i]) ? tris->y0[i] : tris->y1[i];
+        f32 max_y = (tris->y0[i] > tris->y1[i]) ? tris->y0[i] : tris->y1[i];
+        boxes->min_x[i] = (tris->x2[i] < min_x) ? tris->x2[i] : min_x;
+        boxes->max_x[i] = (tris->x2[i] > max_x) ? tris->x2[i] : max_x;
+        boxes->min_y[i] = (tris->y2[i] < min_y) ? tris->y2[i] : min_y;
+        boxes->max_y[i] = (tris->y2[i] > max_y) ? tris->y2[i] : max_y;
+    }
+}
+
+typedef struct SatState{
+    f32 depth;
+    Vec2 axis;
+    f32 length;
+} SatState;
+
+// NOTE: false when the axis separates the two point sets, otherwise keeps the axis in state if it has
+// the smallest overlap so far
+static bool
+sat_axis(SatState *state, Vec2 axis, Vec2 *a, ui32 a_count, Vec2 *b, ui32 b_count){
+    f32 length_sq = (axis.x * axis.x) + (axis.y * axis.y);
+    if(length_sq <= 0.0f){
+        return(true);
+    }
+
+    f32 min_a = dot2(a[0], axis);
+    f32 max_a = min_a;
+    for(ui32 i=1; i < a_count; ++i){
+        f32 p = dot2(a[i], axis);
+        min_a = (min_a < p) ? min_a : p;
+        max_a = (max_a > p) ? max_a : p;
+    }
+    f32 min_b = dot2(b[0], axis);
+    f32 max_b = min_b;
+    for(ui32 i=1; i < b_count; ++i){
+        f32 p = dot2(b[i], axis);
+        min_b = (min_b < p) ? min_b : p;
+        max_b = (max_b > p) ? max_b : p;
+    }
+
+    // NOTE: b comes free either forward along the axis or backward, whichever is shorter
+    f32 forward = max_a - min_b;
+    f32 backward = max_b - min_a;
+    f32 overlap = (forward < backward) ? forward : backward;
+    if(backward < forward){
+        axis = vec2(-axis.x, -axis.y);
+    }
+    f32 length = _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(length_sq)));
+    f32 depth = overlap / length;
+    if(depth <= 0.0f){
+        return(false);
+    }
+    if(depth < state->depth){
+        state->depth = depth;
+        state->axis = axis;
+        state->length = length;
+    }
+    return(true);
+}
+
+// NOTE: the normals of every edge of a, false as soon as one separates
+static bool
+sat_edges(SatState *state, Vec2 *a, ui32 a_count, Vec2 *b, ui32 b_count, Vec2 *edges, ui32 edge_count){
+    for(ui32 i=0; i < edge_count; ++i){
+        Vec2 p = edges[i];
+        Vec2 q = edges[(i + 1 < edge_count) ? i + 1 : 0];
+        Vec2 axis = vec2(q.y - p.y, p.x - q.x);
+        if(!sat_axis(state, axis, a, a_count, b, b_count)){
+            return(false);
+        }
+    }
+    return(true);
+}
+
+static bool
+sat_finish(SatState *state, Contact *contact){
+    // NOTE: no usable axis at all, both shapes are single points
+    if(state->depth == FLT_MAX){
+        return(false);
+    }
+
+    if(contact){
+        contact->normal = vec2(state->axis.x / state->length, state->axis.y / state->length);
+        contact->depth = state->depth;
+    }
+    return(true);
+}
+
+// NOTE: contact may be 0, it is left alone when the shapes are apart
+static bool
+sat_polygon_polygon(ConvexPolygon *a, ConvexPolygon *b, Contact *contact){
+    SatState state = {FLT_MAX, {{0.0f, 0.0f}}, 0.0f};
+    if(!sat_edges(&state, a->points, a->count, b->points, b->count, a->points, a->count) ||
+       !sat_edges(&state, a->points, a->count, b->points, b->count, b->points, b->count)){
+        return(false);
+    }
+    return(sat_finish(&state, contact));
+}
+
+static bool
+sat_triangle_triangle(Tri a, Tri b, Contact *contact){
+    ConvexPolygon pa = polygon_from_tri(a);
+    ConvexPolygon pb = polygon_from_tri(b);
+    return(sat_polygon_polygon(&pa, &pb, contact));
+}
+
+// NOTE: a rect only has two distinct axes, the contact pushes the rect off the polygon
+static bool
+sat_polygon_rect(ConvexPolygon *a, Rect r, Contact *contact){
+    ConvexPolygon b = polygon_from_rect(r);
+    SatState state = {FLT_MAX, {{0.0f, 0.0f}}, 0.0f};
+    if(!sat_edges(&state, a->points, a->count, b.points, b.count, a->points, a->count) ||
+       !sat_axis(&state, vec2(0.0f, -r.w), a->points, a->count, b.points, b.count) ||
+       !sat_axis(&state, vec2(r.h, 0.0f), a->points, a->count, b.points, b.count)){
+        return(false);
+    }
+    return(sat_finish(&state, contact));
+}
+
+// NOTE: one axis for 4 pairs at once, same operations in the same order as sat_axis. Lanes with a zero
+// length axis keep their state, separated collects the lanes the axis pulls apart.
+static inline void
+sat_axis_4(__m128 axis_x, __m128 axis_y, __m128 *ax, __m128 *ay, __m128 *bx, __m128 *by,
+           __m128 *depth, __m128 *best_x, __m128 *best_y, __m128 *best_length, __m128 *separated){
+    __m128 zero = _mm_setzero_ps();
+    __m128 length_sq = _mm_add_ps(_mm_mul_ps(axis_x, axis_x), _mm_mul_ps(axis_y, axis_y));
+    __m128 valid = _mm_cmpgt_ps(length_sq, zero);
+
+    __m128 pa0 = _mm_add_ps(_mm_mul_ps(ax[0], axis_x), _mm_mul_ps(ay[0], axis_y));
+    __m128 pa1 = _mm_add_ps(_mm_mul_ps(ax[1], axis_x), _mm_mul_ps(ay[1], axis_y));
+    __m128 pa2 = _mm_add_ps(_mm_mul_ps(ax[2], axis_x), _mm_mul_ps(ay[2], axis_y));
+    __m128 pb0 = _mm_add_ps(_mm_mul_ps(bx[0], axis_x), _mm_mul_ps(by[0], axis_y));
+    __m128 pb1 = _mm_add_ps(_mm_mul_ps(bx[1], axis_x), _mm_mul_ps(by[1], axis_y));
+    __m128 pb2 = _mm_add_ps(_mm_mul_ps(bx[2], axis_x), _mm_mul_ps(by[2], axis_y));
+    __m128 min_a = _mm_min_ps(_mm_min_ps(pa0, pa1), pa2);
+    __m128 max_a = _mm_max_ps(_mm_max_ps(pa0, pa1), pa2);
+    __m128 min_b = _mm_min_ps(_mm_min_ps(pb0, pb1), pb2);
+    __m128 max_b = _mm_max_ps(_mm_max_ps(pb0, pb1), pb2);
+
+    __m128 forward = _mm_sub_ps(max_a, min_b);
+    __m128 backward = _mm_sub_ps(max_b, min_a);
+    __m128 overlap = _mm_min_ps(forward, backward);
+    __m128 flip = _mm_and_ps(_mm_cmplt_ps(backward, forward), _mm_set1_ps(-0.0f));
+    axis_x = _mm_xor_ps(axis_x, flip);
+    axis_y = _mm_xor_ps(axis_y, flip);
+    __m128 length = _mm_sqrt_ps(length_sq);
+    __m128 axis_depth = _mm_div_ps(overlap, length);
+    axis_depth = _mm_or_ps(_mm_and_ps(valid, axis_depth), _mm_andnot_ps(valid, _mm_set1_ps(FLT_MAX)));
+
+    *separated = _mm_or_ps(*separated, _mm_cmple_ps(axis_depth, zero));
+    __m128 better = _mm_cmplt_ps(axis_depth, *depth);
+    *depth = _mm_or_ps(_mm_and_ps(better, axis_depth), _mm_andnot_ps(better, *depth));
+    *best_x = _mm_or_ps(_mm_and_ps(better, axis_x), _mm_andnot_ps(better, *best_x));
+    *best_y = _mm_or_ps(_mm_and_ps(better, axis_y), _mm_andnot_ps(better, *best_y));
+    *best_length = _mm_or_ps(_mm_and_ps(better, length), _mm_andnot_ps(better, *best_length));
+}
+
+static inline void
+sat_gather_4(TriangleArray *tris, ui32 *index, __m128 *x, __m128 *y){
+    x[0] = _mm_setr_ps(tris->x0[index[0]], tris->x0[index[1]], tris->x0[index[2]], tris->x0[index[3]]);
+    y[0] = _mm_setr_ps(tris->y0[index[0]], tris->y0[index[1]], tris->y0[index[2]], tris->y0[index[3]]);
+    x[1] = _mm_setr_ps(tris->x1[index[0]], tris->x1[index[1]], tris->x1[index[2]], tris->x1[index[3]]);
+    y[1] = _mm_setr_ps(tris->y1[index[0]], tris->y1[index[1]], tris->y1[index[2]], tris->y1[index[3]]);
+    x[2] = _mm_setr_ps(tris->x2[index[0]], tris->x2[index[1]], tris->x2[index[2]], tris->x2[index[3]]);
+    y[2] = _mm_setr_ps(tris->y2[index[0]], tris->y2[index[1]], tris->y2[index[2]], tris->y2[index[3]]);
+}
+
+// NOTE: writes one contact per pair, depth 0 for pairs that are apart, and returns how many touch.
+// pairs usually come straight from spatial_grid_pairs over triangle_array_bounds.
+static ui32
+sat_triangle_pairs(TriangleArray *tris, OverlapPair *pairs, ui32 count, Contact *contacts){
+    ui32 hits = 0;
+    Contact apart = {0};
+
+    ui32 i = 0;
+    for(; i + 4 <= count; i += 4){
+        ui32 index_a[4], index_b[4];
+        for(ui32 lane=0; lane < 4; ++lane){
+            index_a[lane] = pairs[i + lane].a;
+            index_b[lane] = pairs[i + lane].b;
+        }
+        __m128 ax[3], ay[3], bx[3], by[3];
+        sat_gather_4(tris, index_a, ax, ay);
+        sat_gather_4(tris, index_b, bx, by);
+
+        __m128 depth = _mm_set1_ps(FLT_MAX);
+        __m128 best_x = _mm_setzero_ps();
+        __m128 best_y = _mm_setzero_ps();
+        __m128 best_length = _mm_set1_ps(1.0f);
+        __m128 separated = _mm_setzero_ps();
+        for(ui32 edge=0; edge < 3; ++edge){
+            ui32 next = (edge + 1 < 3) ? edge + 1 : 0;
+            sat_axis_4(_mm_sub_ps(ay[next], ay[edge]), _mm_sub_ps(ax[edge], ax[next]), ax, ay, bx, by,
+                       &depth, &best_x, &best_y, &best_length, &separated);
+        }
+        for(ui32 edge=0; edge < 3; ++edge){
+            ui32 next = (edge + 1 < 3) ? edge + 1 : 0;
+            sat_axis_4(_mm_sub_ps(by[next], by[edge]), _mm_sub_ps(bx[edge], bx[next]), ax, ay, bx, by,
+                       &depth, &best_x, &best_y, &best_length, &separated);
+        }
+
+        __m128 normal_x = _mm_div_ps(best_x, best_length);
+        __m128 normal_y = _mm_div_ps(best_y, best_length);
+
+        __m128 touching = _mm_andnot_ps(separated, _mm_cmplt_ps(depth, _mm_set1_ps(FLT_MAX)));
+        i32 mask = _mm_movemask_ps(touching);
+        f32 lane_x[4], lane_y[4], lane_depth[4];
+        _mm_storeu_ps(lane_x, normal_x);
+        _mm_storeu_ps(lane_y, normal_y);
+        _mm_storeu_ps(lane_depth, depth);
+        for(ui32 lane=0; lane < 4; ++lane){
+            Contact *contact = &contacts[i + lane];
+            if(mask & (1 << lane)){
+                contact->normal = vec2(lane_x[lane], lane_y[lane]);
+                contact->depth = lane_depth[lane];
+                ++hits;
+            }
+            else{
+                *contact = apart;
+            }
+        }
+    }
+
+    for(; i < count; ++i){
+        ConvexPolygon a = triangle_array_polygon(tris, pairs[i].a);
+        ConvexPolygon b = triangle_array_polygon(tris, pairs[i].b);
+        contacts[i] = apart;
+        if(sat_polygon_polygon(&a, &b, &contacts[i])){
+            ++hits;
+        }
+    }
+    return(hits);
+}
+
+#define NARROWPHASE_H
+#endif
@@ -0,0 +1,706 @@
+#if !defined(PARTICLES_H)
+
+// NOTE: particles in pools of structure of arrays, one pool per look (blend, color, size). Emitters
+// append to the end of a pool, particle_update then makes one pass over each pool that integrates,
+// drops the dead and writes the splat snapshot the renderer draws from:
+//
+//   life -= dt, v += gravity * dt, p += v * dt
+//   the live ones are packed down in place, 8 at a time with the AVX2 permute (a table from the alive
+//   mask gives the lane order), so there is no branch per particle and order is kept
+//   splat = x | y << 12 | weight << 24, 4 bytes per particle, into one of GAME_FRAMES_IN_FLIGHT rings
+//
+// The renderer never reads the pools. particle_render bins the splats into PARTICLE_TILE_SIZE square
+// tiles with a counting sort (count per chunk, prefix sum, scatter per chunk, both passes parallel) and
+// then each tile blends its splats on its own, so workers never share a pixel and the tile stays in
+// cache. Every tile keeps the splats in pool then particle order, so the image doesn't depend on how
+// many threads drew it.
+//
+// Splat blending is 8 bit integer SIMD on the pool's premultiplied PackedColor, additive is a saturating
+// add of the color scaled by weight, alpha is color * weight + dst * (1 - alpha * weight).
+
+#include "simd.h"
+#include "trig.h"
+
+#define PARTICLE_MAX_POOLS 4
+#define PARTICLE_MAX_EMITTERS 16
+#define PARTICLE_MAX_SIZE 16
+#define PARTICLE_TILE_SHIFT 6
+#define PARTICLE_TILE_SIZE (1 << PARTICLE_TILE_SHIFT)
+#define PARTICLE_CHUNK 16384
+
+// NOTE: splat positions are whole pixels offset by PARTICLE_SPLAT_BIAS, 12 bits each, so splats cover
+// [-PARTICLE_SPLAT_BIAS, PARTICLE_SPLAT_LIMIT - PARTICLE_SPLAT_BIAS) on both axes. A particle outside that
+// writes a 0 splat, which lands off screen.
+#define PARTICLE_SPLAT_BIAS 16
+#define PARTICLE_SPLAT_LIMIT 4096
+
+typedef enum{PARTICLE_BLEND_ADD, PARTICLE_BLEND_ALPHA} ParticleBlend;
+
+typedef struct ParticlePool{
+    ui32 count;
+    ui32 capacity;
+    f32 *x;
+    f32 *y;
+    f32 *vx;
+    f32 *vy;
+    f32 *life; // NOTE: seconds left
+    ui32 *splats[GAME_FRAMES_IN_FLIGHT];
+
+    ParticleBlend blend;
+    PackedColor color;
+    ui32 size;    // NOTE: side of the square in pixels, 1 draws points
+    f32 fade;     // NOTE: 1 / the seconds a particle fades out over at the end of its life
+    Vec2 gravity; // NOTE: pixels per second squared
+} ParticlePool;
+
+typedef struct ParticleEmitter{
+    ui32 pool;
+    Vec2 position;
+    f32 rate;   // NOTE: particles per second, 0 stops it
+    f32 angle;  // NOTE: radians, particles leave within spread / 2 either side
+    f32 spread;
+    f32 speed_min;
+    f32 speed_max;
+    f32 life_min;
+    f32 life_max;
+    f32 owed;   // NOTE: the fraction of a particle carried to the next update
+    ui32 random;
+} ParticleEmitter;
+
+typedef struct ParticleLayer{
+    ParticleBlend blend;
+    ui32 color; // NOTE: premultiplied 0x00RRGGBB like the RenderBuffer
+    ui32 alpha; // NOTE: 0 - 256
+    ui32 size;
+    ui32 count;
+    ui32 *splats;
+} ParticleLayer;
+
+struct ParticleFrame{
+    ui32 layer_count;
+    ParticleLayer layers[PARTICLE_MAX_POOLS];
+};
+
+struct ParticleSystem{
+    ui32 pool_count;
+    ParticlePool pools[PARTICLE_MAX_POOLS];
+    ui32 emitter_count;
+    ParticleEmitter emitters[PARTICLE_MAX_EMITTERS];
+    ui32 frame_index;
+    ParticleFrame frames[GAME_FRAMES_IN_FLIGHT];
+};
+
+static ParticleSystem *
+particle_system(Arena *arena){
+    ParticleSystem *result = push_array(arena, ParticleSystem, 1);
+    if(result){
+        result->pool_count = 0;
+        result->emitter_count = 0;
+        result->frame_index = 0;
+    }
+    return(result);
+}
+
+// NOTE: returns -1 when out of pools or the arena is full
+static i32
+particle_pool_add(ParticleSystem *system, Arena *arena, ui32 capacity, ParticleBlend blend, PackedColor color, ui32 size, f32 fade_seconds, Vec2 gravity){
+    Assert(size >= 1 && size <= PARTICLE_MAX_SIZE);
+    if(system->pool_count >= PARTICLE_MAX_POOLS){
+        return(-1);
+    }
+
+    ParticlePool *pool = &system->pools[system->pool_count];
+    pool->x = push_array(arena, f32, capacity);
+    pool->y = push_array(arena, f32, capacity);
+    pool->vx = push_array(arena, f32, capacity);
+    pool->vy = push_array(arena, f32, capacity);
+    pool->life = push_array(arena, f32, capacity);
+    if(!pool->x || !pool->y || !pool->vx || !pool->vy || !pool->life){
+        return(-1);
+    }
+    for(ui32 i=0; i < GAME_FRAMES_IN_FLIGHT; ++i){
+        pool->splats[i] = push_array(arena, ui32, capacity);
+        if(!pool->splats[i]){
+            return(-1);
+        }
+    }
+    pool->count = 0;
+    pool->capacity = capacity;
+    pool->blend = blend;
+    pool->color = color;
+    pool->size = size;
+    pool->fade = 1.0f / fade_seconds;
+    pool->gravity = gravity;
+    return((i32)system->pool_count++);
+}
+
+// NOTE: returns -1 when out of emitters, the emitter starts with rate 0
+static i32
+particle_emitter_add(ParticleSystem *system, ui32 pool, Vec2 position, f32 angle, f32 spread, f32 speed_min, f32 speed_max, f32 life_min, f32 life_max, ui32 seed){
+    Assert(pool < system->pool_count);
+    if(system->emitter_count >= PARTICLE_MAX_EMITTERS){
+        return(-1);
+    }
+
+    ParticleEmitter *emitter = &system->emitters[system->emitter_count];
+    emitter->pool = pool;
+    emitter->position = position;
+    emitter->rate = 0.0f;
+    emitter->angle = angle;
+    emitter->spread = spread;
+    emitter->speed_min = speed_min;
+    emitter->speed_max = speed_max;
+    emitter->life_min = life_min;
+    emitter->life_max = life_max;
+    emitter->owed = 0.0f;
+    emitter->random = seed ? seed : 1;
+    return((i32)system->emitter_count++);
+}
+
+// NOTE: xorshift32, [0, 1)
+static f32
+particle_random(ui32 *state){
+    ui32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return((f32)(x >> 8) * (1.0f / 16777216.0f));
+}
+
+static void
+particle_emit(ParticlePool *pool, ParticleEmitter *emitter, f32 dt){
+    emitter->owed += emitter->rate * dt;
+    ui32 count = (ui32)emitter->owed;
+    emitter->owed -= (f32)count;
+    ui32 room = pool->capacity - pool->count;
+    count = (count > room) ? room : count;
+    if(!count){
+        return;
+    }
+
+    // NOTE: angles go through vx and speeds through life until the sincos pass turns them into velocities
+    ui32 begin = pool->count;
+    f32 *angle = pool->vx + begin;
+    f32 *speed = pool->life + begin;
+    for(ui32 i=0; i < count; ++i){
+        angle[i] = emitter->angle + (emitter->spread * (particle_random(&emitter->random) - 0.5f));
+        speed[i] = emitter->speed_min + ((emitter->speed_max - emitter->speed_min) * particle_random(&emitter->random));
+    }
+    trig_sincos_array(TRIG_FAST, angle, pool->vy + begin, pool->vx + begin, count);
+
+    // NOTE: spread over the update as if they left the emitter one at a time, not in a clump
+    for(ui32 i=begin; i < begin + count; ++i){
+        f32 age = dt * particle_random(&emitter->random);
+        pool->vx[i] *= pool->life[i];
+        pool->vy[i] *= pool->life[i];
+        pool->x[i] = emitter->position.x + (pool->vx[i] * age);
+        pool->y[i] = emitter->position.y + (pool->vy[i] * age);
+        pool->life[i] = emitter->life_min + ((emitter->life_max - emitter->life_min) * particle_random(&emitter->random));
+    }
+    pool->count += count;
+}
+
+// NOTE: for each alive mask, the lanes to keep in bits 3*k (k-th kept lane) and how many in bits 24+
+static ui32 *
+particle_compact_table(void){
+    local_static ui32 table[256];
+    local_static bool built;
+    if(!built){
+        for(ui32 mask=0; mask < 256; ++mask){
+            ui32 entry = 0;
+            ui32 kept = 0;
+            for(ui32 lane=0; lane < 8; ++lane){
+                if(mask & (1 << lane)){
+                    entry |= lane << (3 * kept++);
+                }
+            }
+            table[mask] = entry | (kept << 24);
+        }
+        built = true;
+    }
+    return(table);
+}
+
+// NOTE: the update kernels start at *read / *write and leave them where they stopped, write never passes
+// read so packing down in place only overwrites particles that were already loaded
+static void
+particle_update_scalar(ParticlePool *pool, f32 dt, ui32 *splats, ui32 *read, ui32 *write){
+    f32 dvx = pool->gravity.x * dt;
+    f32 dvy = pool->gravity.y * dt;
+    f32 bias = (f32)PARTICLE_SPLAT_BIAS;
+    f32 limit = (f32)PARTICLE_SPLAT_LIMIT;
+
+    ui32 j = *write;
+    for(ui32 i=*read; i < pool->count; ++i){
+        f32 life = pool->life[i] - dt;
+        f32 vx = pool->vx[i] + dvx;
+        f32 vy = pool->vy[i] + dvy;
+        f32 x = pool->x[i] + (vx * dt);
+        f32 y = pool->y[i] + (vy * dt);
+
+        f32 sx = x + bias;
+        f32 sy = y + bias;
+        ui32 splat = 0;
+        if(sx >= 0.0f && sx < limit && sy >= 0.0f && sy < limit){
+            f32 weight = life * pool->fade;
+            weight = (weight < 1.0f) ? weight : 1.0f;
+            splat = (ui32)sx | ((ui32)sy << 12) | ((ui32)(i32)(weight * 255.0f) << 24);
+        }
+
+        pool->x[j] = x;
+        pool->y[j] = y;
+        pool->vx[j] = vx;
+        pool->vy[j] = vy;
+        pool->life[j] = life;
+        splats[j] = splat;
+        j += (life > 0.0f);
+    }
+    *read = pool->count;
+    *write = j;
+}
+
+// NOTE: SSE2 has no variable lane shuffle, the 4 results go through the stack and are packed down one at
+// a time, still without a branch
+static void
+particle_update_sse2(ParticlePool *pool, f32 dt, ui32 *splats, ui32 *read, ui32 *write){
+    __m128 step = _mm_set1_ps(dt);
+    __m128 dvx = _mm_set1_ps(pool->gravity.x * dt);
+    __m128 dvy = _mm_set1_ps(pool->gravity.y * dt);
+    __m128 fade = _mm_set1_ps(pool->fade);
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 bias = _mm_set1_ps((f32)PARTICLE_SPLAT_BIAS);
+    __m128 limit = _mm_set1_ps((f32)PARTICLE_SPLAT_LIMIT);
+    __m128 weight_scale = _mm_set1_ps(255.0f);
+
+    f32 lanes[5][4];
+    ui32 splat_lanes[4];
+    ui32 i = *read;
+    ui32 j = *write;
+    for(; i + 4 <= pool->count; i += 4){
+        __m128 life = _mm_sub_ps(_mm_loadu_ps(pool->life + i), step);
+        __m128 vx = _mm_add_ps(_mm_loadu_ps(pool->vx + i), dvx);
+        __m128 vy = _mm_add_ps(_mm_loadu_ps(pool->vy + i), dvy);
+        __m128 x = _mm_add_ps(_mm_loadu_ps(pool->x + i), _mm_mul_ps(vx, step));
+        __m128 y = _mm_add_ps(_mm_loadu_ps(pool->y + i), _mm_mul_ps(vy, step));
+
+        __m128 sx = _mm_add_ps(x, bias);
+        __m128 sy = _mm_add_ps(y, bias);
+        __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(sx, zero), _mm_cmplt_ps(sx, limit)),
+                                   _mm_and_ps(_mm_cmpge_ps(sy, zero), _mm_cmplt_ps(sy, limit)));
+        __m128 weight = _mm_mul_ps(_mm_min_ps(_mm_mul_ps(life, fade), one), weight_scale);
+        __m128i splat = _mm_or_si128(_mm_or_si128(_mm_cvttps_epi32(sx), _mm_slli_epi32(_mm_cvttps_epi32(sy), 12)),
+                                     _mm_slli_epi32(_mm_cvttps_epi32(weight), 24));
+        splat = _mm_and_si128(splat, _mm_castps_si128(inside));
+        ui32 alive = (ui32)_mm_movemask_ps(_mm_cmpgt_ps(life, zero));
+
+        _mm_storeu_ps(lanes[0], x);
+        _mm_storeu_ps(lanes[1], y);
+        _mm_storeu_ps(lanes[2], vx);
+        _mm_storeu_ps(lanes[3], vy);
+        _mm_storeu_ps(lanes[4], life);
+        _mm_storeu_si128((__m128i *)splat_lanes, splat);
+        for(ui32 k=0; k < 4; ++k){
+            pool->x[j] = lanes[0][k];
+            pool->y[j] = lanes[1][k];
+            pool->vx[j] = lanes[2][k];
+            pool->vy[j] = lanes[3][k];
+            pool->life[j] = lanes[4][k];
+            splats[j] = splat_lanes[k];
+            j += (alive >> k) & 1;
+        }
+    }
+    *read = i;
+    *write = j;
+}
+
+SIMD_TARGET_AVX2 static void
+particle_update_avx2(ParticlePool *pool, f32 dt, ui32 *splats, ui32 *read, ui32 *write){
+    ui32 *compact = particle_compact_table();
+    __m256 step = _mm256_set1_ps(dt);
+    __m256 dvx = _mm256_set1_ps(pool->gravity.x * dt);
+    __m256 dvy = _mm256_set1_ps(pool->gravity.y * dt);
+    __m256 fade = _mm256_set1_ps(pool->fade);
+    __m256 zero = _mm256_setzero_ps();
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 bias = _mm256_set1_ps((f32)PARTICLE_SPLAT_BIAS);
+    __m256 limit = _mm256_set1_ps((f32)PARTICLE_SPLAT_LIMIT);
+    __m256 weight_scale = _mm256_set1_ps(255.0f);
+    __m256i shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    __m256i lane_mask = _mm256_set1_epi32(7);
+
+    ui32 i = *read;
+    ui32 j = *write;
+    for(; i + 8 <= pool->count; i += 8){
+        __m256 life = _mm256_sub_ps(_mm256_loadu_ps(pool->life + i), step);
+        __m256 vx = _mm256_add_ps(_mm256_loadu_ps(pool->vx + i), dvx);
+        __m256 vy = _mm256_add_ps(_mm256_loadu_ps(pool->vy + i), dvy);
+        __m256 x = _mm256_add_ps(_mm256_loadu_ps(pool->x + i), _mm256_mul_ps(vx, step));
+        __m256 y = _mm256_add_ps(_mm256_loadu_ps(pool->y + i), _mm256_mul_ps(vy, step));
+
+        __m256 sx = _mm256_add_ps(x, bias);
+        __m256 sy = _mm256_add_ps(y, bias);
+        __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(sx, zero, _CMP_GE_OQ), _mm256_cmp_ps(sx, limit, _CMP_LT_OQ)),
+                                      _mm256_and_ps(_mm256_cmp_ps(sy, zero, _CMP_GE_OQ), _mm256_cmp_ps(sy, limit, _CMP_LT_OQ)));
+        __m256 weight = _mm256_mul_ps(_mm256_min_ps(_mm256_mul_ps(life, fade), one), weight_scale);
+        __m256i splat = _mm256_or_si256(_mm256_or_si256(_mm256_cvttps_epi32(sx), _mm256_slli_epi32(_mm256_cvttps_epi32(sy), 12)),
+                                        _mm256_slli_epi32(_mm256_cvttps_epi32(weight), 24));
+        splat = _mm256_and_si256(splat, _mm256_castps_si256(inside));
+
+        ui32 entry = compact[_mm256_movemask_ps(_mm256_cmp_ps(life, zero, _CMP_GT_OQ))];
+        __m256i order = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((i32)entry), shifts), lane_mask);
+        _mm256_storeu_ps(pool->x + j, _mm256_permutevar8x32_ps(x, order));
+        _mm256_storeu_ps(pool->y + j, _mm256_permutevar8x32_ps(y, order));
+        _mm256_storeu_ps(pool->vx + j, _mm256_permutevar8x32_ps(vx, order));
+        _mm256_storeu_ps(pool->vy + j, _mm256_permutevar8x32_ps(vy, order));
+        _mm256_storeu_ps(pool->life + j, _mm256_permutevar8x32_ps(life, order));
+        _mm256_storeu_si256((__m256i *)(splats + j), _mm256_permutevar8x32_epi32(splat, order));
+        j += entry >> 24;
+    }
+    _mm256_zeroupper();
+    *read = i;
+    *write = j;
+}
+
+// NOTE: emits, moves and packs every pool, returns the splat snapshot for this frame. The snapshot stays
+// as it is for the next GAME_FRAMES_IN_FLIGHT - 1 updates, which is what lets render read it while the
+// following frames simulate.
+static ParticleFrame *
+particle_update(ParticleSystem *system, f32 dt){
+    ui32 slot = system->frame_index++ % GAME_FRAMES_IN_FLIGHT;
+    ParticleFrame *frame = &system->frames[slot];
+
+    for(ui32 i=0; i < system->emitter_count; ++i){
+        ParticleEmitter *emitter = &system->emitters[i];
+        particle_emit(&system->pools[emitter->pool], emitter, dt);
+    }
+
+    frame->layer_count = system->pool_count;
+    for(ui32 i=0; i < system->pool_count; ++i){
+        ParticlePool *pool = &system->pools[i];
+        ui32 *splats = pool->splats[slot];
+        ui32 read = 0;
+        ui32 write = 0;
+        if(simd_level() >= SIMD_AVX2){
+            particle_update_avx2(pool, dt, splats, &read, &write);
+        }
+        else{
+            particle_update_sse2(pool, dt, splats, &read, &write);
+        }
+        particle_update_scalar(pool, dt, splats, &read, &write);
+        pool->count = write;
+
+        ParticleLayer *layer = &frame->layers[i];
+        layer->blend = pool->blend;
+        ui32 alpha = pool->color.argb >> 24;
+        layer->color = pool->color.argb & 0x00FFFFFF;
+        layer->alpha = alpha + (alpha >> 7);
+        layer->size = pool->size;
+        layer->count = pool->count;
+        layer->splats = splats;
+    }
+    return(frame);
+}
+
+typedef struct ParticleChunk{
+    ui32 layer;
+    ui32 begin;
+    ui32 end;
+} ParticleChunk;
+
+// NOTE: shared by the particle_render passes
+typedef struct ParticleRender{
+    ParticleFrame frame; // NOTE: a copy, the snapshot's counts can't change between the passes
+    RenderBuffer *buffer;
+    ui32 tiles_x;
+    ui32 tiles_y;
+    ui32 tile_count; // NOTE: also the bin for splats that are off screen
+    ui32 bin_count;
+    ParticleChunk *chunks;
+    ui32 *counts;     // NOTE: bin_count per chunk, turned into where the chunk writes each bin
+    ui32 *tile_start; // NOTE: by tile * layer_count + layer, one past the end for the last
+    ui32 *records;
+} ParticleRender;
+
+// NOTE: the bins a square splat lands in, at most 4 as a square is no bigger than a tile
+static ui32
+particle_splat_bins(ParticleRender *render, ui32 splat, ui32 size, ui32 *bins){
+    i32 x0 = (i32)(splat & 0xFFF) - PARTICLE_SPLAT_BIAS - (i32)(size / 2);
+    i32 y0 = (i32)((splat >> 12) & 0xFFF) - PARTICLE_SPLAT_BIAS - (i32)(size / 2);
+    i32 x1 = x0 + (i32)size - 1;
+    i32 y1 = y0 + (i32)size - 1;
+    x0 = (x0 < 0) ? 0 : x0;
+    y0 = (y0 < 0) ? 0 : y0;
+    x1 = (x1 >= render->buffer->width) ? render->buffer->width - 1 : x1;
+    y1 = (y1 >= render->buffer->height) ? render->buffer->height - 1 : y1;
+    if(x0 > x1 || y0 > y1){
+        bins[0] = render->tile_count;
+        return(1);
+    }
+
+    ui32 result = 0;
+    for(i32 ty=(y0 >> PARTICLE_TILE_SHIFT); ty <= (y1 >> PARTICLE_TILE_SHIFT); ++ty){
+        for(i32 tx=(x0 >> PARTICLE_TILE_SHIFT); tx <= (x1 >> PARTICLE_TILE_SHIFT); ++tx){
+            bins[result++] = ((ui32)ty * render->tiles_x) + (ui32)tx;
+        }
+    }
+    return(result);
+}
+
+static inline ui32
+particle_point_bin(ParticleRender *render, ui32 splat){
+    ui32 x = (splat & 0xFFF) - PARTICLE_SPLAT_BIAS;
+    ui32 y = ((splat >> 12) & 0xFFF) - PARTICLE_SPLAT_BIAS;
+    bool inside = (x < (ui32)render->buffer->width) & (y < (ui32)render->buffer->height);
+    return(inside ? ((y >> PARTICLE_TILE_SHIFT) * render->tiles_x) + (x >> PARTICLE_TILE_SHIFT) : render->tile_count);
+}
+
+static WORK_FUNCTION(particle_count_work){
+    ParticleRender *render = (ParticleRender *)data;
+    ParticleChunk *chunk = &render->chunks[index];
+    ParticleLayer *layer = &render->frame.layers[chunk->layer];
+    ui32 *counts = render->counts + (index * render->bin_count);
+    for(ui32 i=0; i < render->bin_count; ++i){
+        counts[i] = 0;
+    }
+
+    if(layer->size == 1){
+        for(ui32 i=chunk->begin; i < chunk->end; ++i){
+            ++counts[particle_point_bin(render, layer->splats[i])];
+        }
+    }
+    else{
+        ui32 bins[4];
+        for(ui32 i=chunk->begin; i < chunk->end; ++i){
+            ui32 bin_count = particle_splat_bins(render, layer->splats[i], layer->size, bins);
+            for(ui32 k=0; k < bin_count; ++k){
+                ++counts[bins[k]];
+            }
+        }
+    }
+}
+
+static WORK_FUNCTION(particle_scatter_work){
+    ParticleRender *render = (ParticleRender *)data;
+    ParticleChunk *chunk = &render->chunks[index];
+    ParticleLayer *layer = &render->frame.layers[chunk->layer];
+    ui32 *next = render->counts + (index * render->bin_count);
+    ui32 *records = render->records;
+
+    if(layer->size == 1){
+        for(ui32 i=chunk->begin; i < chunk->end; ++i){
+            ui32 splat = layer->splats[i];
+            records[next[particle_point_bin(render, splat)]++] = splat;
+        }
+    }
+    else{
+        ui32 bins[4];
+        for(ui32 i=chunk->begin; i < chunk->end; ++i){
+            ui32 splat = layer->splats[i];
+            ui32 bin_count = particle_splat_bins(render, splat, layer->size, bins);
+            for(ui32 k=0; k < bin_count; ++k){
+                records[next[bins[k]]++] = splat;
+            }
+        }
+    }
+}
+
+// NOTE: the splat's weight, 0 - 256, scales the premultiplied color
+static inline ui32
+particle_weight(ui32 splat){
+    ui32 weight = splat >> 24;
+    return(weight + (weight >> 7));
+}
+
+// NOTE: alpha * weight, 0 - 256, how much of dst the splat covers
+static inline ui32
+particle_factor(ParticleLayer *layer, ui32 splat){
+    return((layer->alpha * particle_weight(splat)) >> 8);
+}
+
+static WORK_FUNCTION(particle_tile_work){
+    ParticleRender *render = (ParticleRender *)data;
+    RenderBuffer *buffer = render->buffer;
+    i32 tile_x0 = (i32)(index % render->tiles_x) * PARTICLE_TILE_SIZE;
+    i32 tile_y0 = (i32)(index / render->tiles_x) * PARTICLE_TILE_SIZE;
+    i32 tile_x1 = (tile_x0 + PARTICLE_TILE_SIZE > buffer->width) ? buffer->width - 1 : tile_x0 + PARTICLE_TILE_SIZE - 1;
+    i32 tile_y1 = (tile_y0 + PARTICLE_TILE_SIZE > buffer->height) ? buffer->height - 1 : tile_y0 + PARTICLE_TILE_SIZE - 1;
+    // NOTE: y is bottom up like draw_pixel, row y is at (height - 1 - y) * pitch
+    ui8 *bottom_row = (ui8 *)buffer->memory + ((buffer->height - 1) * buffer->pitch);
+    __m128i zero = _mm_setzero_si128();
+
+    ui32 layer_count = render->frame.layer_count;
+    for(ui32 layer_index=0; layer_index < layer_count; ++layer_index){
+        ParticleLayer *layer = &render->frame.layers[layer_index];
+        ui32 *record = render->records + render->tile_start[(index * layer_count) + layer_index];
+        ui32 *end = render->records + render->tile_start[(index * layer_count) + layer_index + 1];
+        __m128i color = _mm_unpacklo_epi8(_mm_cvtsi32_si128((i32)layer->color), zero);
+
+        if(layer->size == 1){
+            if(layer->blend == PARTICLE_BLEND_ADD){
+                for(; record < end; ++record){
+                    ui32 splat = *record;
+                    i32 x = (i32)(splat & 0xFFF) - PARTICLE_SPLAT_BIAS;
+                    i32 y = (i32)((splat >> 12) & 0xFFF) - PARTICLE_SPLAT_BIAS;
+                    ui32 *pixel = (ui32 *)(bottom_row - (y * buffer->pitch)) + x;
+                    __m128i src = _mm_srli_epi16(_mm_mullo_epi16(color, _mm_set1_epi16((i16)particle_weight(splat))), 8);
+                    *pixel = (ui32)_mm_cvtsi128_si32(_mm_adds_epu8(_mm_cvtsi32_si128((i32)*pixel), _mm_packus_epi16(src, src)));
+                }
+            }
+            else{
+                for(; record < end; ++record){
+                    ui32 splat = *record;
+                    i32 x = (i32)(splat & 0xFFF) - PARTICLE_SPLAT_BIAS;
+                    i32 y = (i32)((splat >> 12) & 0xFFF) - PARTICLE_SPLAT_BIAS;
+                    ui32 *pixel = (ui32 *)(bottom_row - (y * buffer->pitch)) + x;
+                    ui32 factor = particle_factor(layer, splat);
+                    __m128i src = _mm_mullo_epi16(color, _mm_set1_epi16((i16)particle_weight(splat)));
+                    __m128i dst = _mm_unpacklo_epi8(_mm_cvtsi32_si128((i32)*pixel), zero);
+                    dst = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(dst, _mm_set1_epi16((i16)(256 - factor))), src), 8);
+                    *pixel = (ui32)_mm_cvtsi128_si32(_mm_packus_epi16(dst, dst));
+                }
+            }
+            continue;
+        }
+
+        for(; record < end; ++record){
+            ui32 splat = *record;
+            i32 x0 = (i32)(splat & 0xFFF) - PARTICLE_SPLAT_BIAS - (i32)(layer->size / 2);
+            i32 y0 = (i32)((splat >> 12) & 0xFFF) - PARTICLE_SPLAT_BIAS - (i32)(layer->size / 2);
+            i32 x1 = x0 + (i32)layer->size - 1;
+            i32 y1 = y0 + (i32)layer->size - 1;
+            x0 = (x0 < tile_x0) ? tile_x0 : x0;
+            y0 = (y0 < tile_y0) ? tile_y0 : y0;
+            x1 = (x1 > tile_x1) ? tile_x1 : x1;
+            y1 = (y1 > tile_y1) ? tile_y1 : y1;
+
+            ui32 weight = particle_weight(splat);
+            if(layer->blend == PARTICLE_BLEND_ADD){
+                __m128i src = _mm_srli_epi16(_mm_mullo_epi16(color, _mm_set1_epi16((i16)weight)), 8);
+                src = _mm_packus_epi16(src, src);
+                for(i32 y=y0; y <= y1; ++y){
+                    ui32 *pixel = (ui32 *)(bottom_row - (y * buffer->pitch)) + x0;
+                    ui32 *row_end = pixel + (x1 - x0 + 1);
+                    for(; pixel + 4 <= row_end; pixel += 4){
+                        _mm_storeu_si128((__m128i *)pixel, _mm_adds_epu8(_mm_loadu_si128((__m128i *)pixel), src));
+                    }
+                    for(; pixel < row_end; ++pixel){
+                        *pixel = (ui32)_mm_cvtsi128_si32(_mm_adds_epu8(_mm_cvtsi32_si128((i32)*pixel), src));
+                    }
+                }
+            }
+            else{
+                __m128i src = _mm_mullo_epi16(color, _mm_set1_epi16((i16)weight));
+                src = _mm_unpacklo_epi64(src, src);
+                __m128i inverse = _mm_set1_epi16((i16)(256 - particle_factor(layer, splat)));
+                for(i32 y=y0; y <= y1; ++y){
+                    ui32 *pixel = (ui32 *)(bottom_row - (y * buffer->pitch)) + x0;
+                    ui32 *row_end = pixel + (x1 - x0 + 1);
+                    for(; pixel + 4 <= row_end; pixel += 4){
+                        __m128i dst = _mm_loadu_si128((__m128i *)pixel);
+                        __m128i lo = _mm_unpacklo_epi8(dst, zero);
+                        __m128i hi = _mm_unpackhi_epi8(dst, zero);
+                        lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(lo, inverse), src), 8);
+                        hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(hi, inverse), src), 8);
+                        _mm_storeu_si128((__m128i *)pixel, _mm_packus_epi16(lo, hi));
+                    }
+                    for(; pixel + 2 <= row_end; pixel += 2){
+                        __m128i dst = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)pixel), zero);
+                        dst = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(dst, inverse), src), 8);
+                        _mm_storel_epi64((__m128i *)pixel, _mm_packus_epi16(dst, dst));
+                    }
+                    if(pixel < row_end){
+                        __m128i dst = _mm_unpacklo_epi8(_mm_cvtsi32_si128((i32)*pixel), zero);
+                        dst = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(dst, inverse), src), 8);
+                        *pixel = (ui32)_mm_cvtsi128_si32(_mm_packus_epi16(dst, dst));
+                    }
+                }
+            }
+        }
+    }
+}
+
+// NOTE: draws frame over buffer, scratch holds the bins and is only used for the call. Without room in
+// scratch nothing is drawn.
+static void
+particle_render(ParticleFrame *frame, RenderBuffer *buffer, Arena *scratch, ParallelFor *parallel_for){
+    ParticleRender render = {0};
+    render.frame = *frame;
+    render.buffer = buffer;
+    render.tiles_x = (ui32)(buffer->width + PARTICLE_TILE_SIZE - 1) >> PARTICLE_TILE_SHIFT;
+    render.tiles_y = (ui32)(buffer->height + PARTICLE_TILE_SIZE - 1) >> PARTICLE_TILE_SHIFT;
+    render.tile_count = render.tiles_x * render.tiles_y;
+    render.bin_count = render.tile_count + 1;
+
+    ui32 layer_count = render.frame.layer_count;
+    ui32 first_chunk[PARTICLE_MAX_POOLS + 1];
+    ui32 chunk_count = 0;
+    for(ui32 i=0; i < layer_count; ++i){
+        first_chunk[i] = chunk_count;
+        chunk_count += (render.frame.layers[i].count + PARTICLE_CHUNK - 1) / PARTICLE_CHUNK;
+    }
+    first_chunk[layer_count] = chunk_count;
+    if(!chunk_count){
+        return;
+    }
+
+    render.chunks = push_array(scratch, ParticleChunk, chunk_count);
+    render.counts = push_array(scratch, ui32, chunk_count * render.bin_count);
+    render.tile_start = push_array(scratch, ui32, (render.tile_count * layer_count) + 1);
+    if(!render.chunks || !render.counts || !render.tile_start){
+        // TODO: Logging
+        return;
+    }
+    for(ui32 i=0; i < layer_count; ++i){
+        for(ui32 c=first_chunk[i]; c < first_chunk[i + 1]; ++c){
+            ParticleChunk *chunk = &render.chunks[c];
+            chunk->layer = i;
+            chunk->begin = (c - first_chunk[i]) * PARTICLE_CHUNK;
+            chunk->end = chunk->begin + PARTICLE_CHUNK;
+            chunk->end = (chunk->end > render.frame.layers[i].count) ? render.frame.layers[i].count : chunk->end;
+        }
+    }
+
+    ui32 running = 0;
+    TIMED_BLOCK("particle_count"){
+        run_parallel(parallel_for, particle_count_work, &render, chunk_count);
+
+        // NOTE: tile major, then layer, then chunk, so a tile's splats come out in pool and particle order.
+        // Off screen splats go after all of them.
+        for(ui32 tile=0; tile < render.tile_count; ++tile){
+            for(ui32 i=0; i < layer_count; ++i){
+                render.tile_start[(tile * layer_count) + i] = running;
+                for(ui32 c=first_chunk[i]; c < first_chunk[i + 1]; ++c){
+                    ui32 *count = &render.counts[(c * render.bin_count) + tile];
+                    ui32 n = *count;
+                    *count = running;
+                    running += n;
+                }
+            }
+        }
+        render.tile_start[render.tile_count * layer_count] = running;
+        for(ui32 c=0; c < chunk_count; ++c){
+            ui32 *count = &render.counts[(c * render.bin_count) + render.tile_count];
+            ui32 n = *count;
+            *count = running;
+            running += n;
+        }
+    }
+
+    render.records = push_array(scratch, ui32, running);
+    if(!render.records){
+        // TODO: Logging
+        return;
+    }
+    TIMED_BLOCK("particle_scatter"){
+        run_parallel(parallel_for, particle_scatter_work, &render, chunk_count);
+    }
+
+    TIMED_BLOCK("particle_splat"){
+        run_parallel(parallel_for, particle_tile_work, &render, render.tile_count);
+    }
+}
+
+#define PARTICLES_H
+#endif
@@ -0,0 +1,312 @@
+#if !defined(PROFILE_H)
+
+// NOTE: cycle profiler shared by the game dll and the platform
+//
+//   TIMED_BLOCK("name"){
+//       ...
+//   }
+//
+// Every expansion gets its own slot from __COUNTER__, offset by PROFILE_MODULE so the game and platform
+// translation units dont collide. Each thread writes only to its own table with one interlocked add,
+// cycles live in the low 40 bits and the hit count in the high 24, which lets profile_end_frame swap
+// a slot to zero without ever locking. The platform owns ProfileState and hands it to the game
+// through GameMemory.
+//
+// When trace_events is set (win_platform.exe -trace) every TIMED_BLOCK also writes a begin and an end
+// event into its thread's ring, which win_trace.c turns into a chrome://tracing / Perfetto timeline.
+//
+// IMPORTANT: dont return/break out of a TIMED_BLOCK, the end of the block is what records it
+// Build with -DPROFILE=0 and TIMED_BLOCK turns into a plain { } scope.
+
+#include <intrin.h>
+
+#if !defined(PROFILE)
+#define PROFILE 0
+#endif
+
+#if !defined(PROFILE_MODULE)
+#define PROFILE_MODULE 0 // NOTE: 0 game, 1 platform
+#endif
+
+#define PROFILE_BLOCKS_PER_MODULE 256
+#define PROFILE_MAX_BLOCKS (PROFILE_BLOCKS_PER_MODULE * 2)
+#define PROFILE_MAX_THREADS 32
+#define PROFILE_FRAME_COUNT 128
+#define PROFILE_CYCLE_BITS 40
+#define PROFILE_CYCLE_MASK ((1ULL << PROFILE_CYCLE_BITS) - 1)
+#define PROFILE_FRAME_ID PROFILE_MAX_BLOCKS // NOTE: end of frame marker, past every slot TIMED_BLOCK can get
+#define TRACE_EVENTS_PER_THREAD (64 * 1024) // NOTE: power of 2, the ring wraps with a mask
+
+typedef enum{TRACE_BEGIN, TRACE_END, TRACE_INSTANT} TraceEventType;
+
+typedef struct TraceEvent{
+    ui64 timestamp;
+    ui32 id;
+    ui32 type;
+} TraceEvent;
+
+typedef struct ProfileSlot{
+    ui64 volatile hits_and_cycles;
+    char *name;
+} ProfileSlot;
+
+typedef struct ProfileThreadTable{
+    ui32 thread_id;
+    ui32 module;
+    ProfileSlot slots[PROFILE_MAX_BLOCKS];
+
+    TraceEvent *trace_events; // NOTE: 0 unless tracing, TRACE_EVENTS_PER_THREAD entries
+    ui64 trace_write_index;   // NOTE: only written by the owning thread, never wrapped
+} ProfileThreadTable;
+
+typedef struct ProfileRecord{
+    ui64 cycles;
+    ui32 hits;
+} ProfileRecord;
+
+typedef struct ProfileFrame{
+    ui64 frame_cycles;
+    ProfileRecord records[PROFILE_MAX_BLOCKS];
+} ProfileFrame;
+
+typedef struct ProfileHotspot{
+    char *name;
+    ui32 id;
+    ui64 cycles; // NOTE: average per frame
+    f32 hits;    // NOTE: average per frame
+    f32 frame_percent;
+} ProfileHotspot;
+
+typedef struct ProfileState{
+    i32 volatile thread_count;
+    ProfileThreadTable threads[PROFILE_MAX_THREADS];
+
+    ui64 frame_index;
+    ProfileFrame frames[PROFILE_FRAME_COUNT];
+
+    char names[PROFILE_MAX_BLOCKS + 1][32]; // NOTE: + 1 for PROFILE_FRAME_ID
+
+    bool overlay;
+
+    TraceEvent *trace_events; // NOTE: PROFILE_MAX_THREADS * TRACE_EVENTS_PER_THREAD, allocated by the platform
+} ProfileState;
+
+typedef struct ProfileScope{
+    ProfileThreadTable *table;
+    ProfileSlot *slot;
+    ui64 start;
+    bool done;
+} ProfileScope;
+
+// NOTE: every translation unit (game dll, platform exe) keeps its own pointer to the shared state
+global ProfileState *global_profile_state;
+static __declspec(thread) ProfileThreadTable *profile_thread_table;
+
+static ProfileThreadTable *
+profile_claim_thread_table(void){
+    ProfileThreadTable *result = 0;
+
+    ProfileState *state = global_profile_state;
+    if(state){
+        ui32 thread_id = GetCurrentThreadId();
+
+        // NOTE: a reloaded game dll loses its thread locals, find the table this thread already had
+        i32 count = state->thread_count;
+        for(i32 i=0; i < count && i < PROFILE_MAX_THREADS; ++i){
+            ProfileThreadTable *table = &state->threads[i];
+            if(table->thread_id == thread_id && table->module == PROFILE_MODULE){
+                result = table;
+                break;
+            }
+        }
+
+        if(!result){
+            i32 index = InterlockedIncrement((LONG volatile *)&state->thread_count) - 1;
+            if(index < PROFILE_MAX_THREADS){
+                result = &state->threads[index];
+                result->thread_id = thread_id;
+                result->module = PROFILE_MODULE;
+                if(state->trace_events){
+                    result->trace_events = state->trace_events + (index * TRACE_EVENTS_PER_THREAD);
+                }
+            }
+            else{
+                // TODO: Logging, out of thread tables, this thread goes unprofiled
+                InterlockedDecrement((LONG volatile *)&state->thread_count);
+            }
+        }
+    }
+
+    profile_thread_table = result;
+    return(result);
+}
+
+static void
+trace_event(ProfileThreadTable *table, ui32 id, TraceEventType type, ui64 timestamp){
+    TraceEvent *event = &table->trace_events[table->trace_write_index++ & (TRACE_EVENTS_PER_THREAD - 1)];
+    event->timestamp = timestamp;
+    event->id = id;
+    event->type = type;
+}
+
+// NOTE: block is the module's own __COUNTER__ value, past PROFILE_BLOCKS_PER_MODULE it would land in the
+// next module's slots or off the end of the table
+static ProfileScope
+profile_begin(ui32 module, ui32 block, char *name){
+    ProfileScope result = {0};
+
+    Assert(block < PROFILE_BLOCKS_PER_MODULE);
+    ui32 id = (module * PROFILE_BLOCKS_PER_MODULE) + block;
+    ProfileThreadTable *table = profile_thread_table;
+    if(!table){
+        table = profile_claim_thread_table();
+    }
+    if(table){
+        result.table = table;
+        result.slot = &table->slots[id];
+        result.slot->name = name;
+        result.start = __rdtsc();
+        if(table->trace_events){
+            trace_event(table, id, TRACE_BEGIN, result.start);
+        }
+    }
+
+    return(result);
+}
+
+static void
+profile_end(ProfileScope *scope){
+    if(scope->slot){
+        ui64 end = __rdtsc();
+        if(scope->table->trace_events){
+            trace_event(scope->table, (ui32)(scope->slot - scope->table->slots), TRACE_END, end);
+        }
+        ui64 cycles = (end - scope->start) & PROFILE_CYCLE_MASK;
+        InterlockedExchangeAdd64((LONGLONG volatile *)&scope->slot->hits_and_cycles, (LONGLONG)((1ULL << PROFILE_CYCLE_BITS) | cycles));
+    }
+    scope->done = true;
+}
+
+#if PROFILE
+#define TIMED_BLOCK__(name, id) for(ProfileScope profile_scope_ = profile_begin(PROFILE_MODULE, (id), name); !profile_scope_.done; profile_end(&profile_scope_))
+#define TIMED_BLOCK_(name, id) TIMED_BLOCK__(name, id)
+#define TIMED_BLOCK(name) TIMED_BLOCK_(name, __COUNTER__)
+#else
+#define TIMED_BLOCK(name)
+#endif
+
+// NOTE: platform only, call once per frame after every thread is done with the frame
+static void
+profile_end_frame(ProfileState *state, ui64 frame_cycles){
+    ProfileThreadTable *table = profile_thread_table ? profile_thread_table : profile_claim_thread_table();
+    if(table && table->trace_events){
+        trace_event(table, PROFILE_FRAME_ID, TRACE_INSTANT, __rdtsc());
+    }
+
+    ProfileFrame *frame = &state->frames[state->frame_index % PROFILE_FRAME_COUNT];
+    memset(frame, 0, sizeof(*frame));
+    frame->frame_cycles = frame_cycles;
+
+    i32 count = state->thread_count;
+    for(i32 i=0; i < count && i < PROFILE_MAX_THREADS; ++i){
+        ProfileThreadTable *thread = &state->threads[i];
+        for(ui32 id=0; id < PROFILE_MAX_BLOCKS; ++id){
+            ProfileSlot *slot = &thread->slots[id];
+            if(slot->hits_and_cycles){
+                ui64 value = (ui64)InterlockedExchange64((LONGLONG volatile *)&slot->hits_and_cycles, 0);
+                frame->records[id].cycles += value & PROFILE_CYCLE_MASK;
+                frame->records[id].hits += (ui32)(value >> PROFILE_CYCLE_BITS);
+
+                // NOTE: copy the name while the dll that owns the string is still loaded
+                if(slot->name){
+                    snprintf(state->names[id], sizeof(state->names[id]), "%s", slot->name);
+                }
+            }
+        }
+    }
+
+    ++state->frame_index;
+}
+
+// NOTE: averages the last frame_count frames and returns up to max_count blocks sorted by cycles
+static ui32
+profile_top_hotspots(ProfileState *state, ui32 frame_count, ProfileHotspot *hotspots, ui32 max_count){
+    ui32 result = 0;
+
+    if(frame_count > state->frame_index){
+        frame_count = (ui32)state->frame_index;
+    }
+    if(frame_count > PROFILE_FRAME_COUNT){
+        frame_count = PROFILE_FRAME_COUNT;
+    }
+    if(frame_count == 0){
+        return(result);
+    }
+
+    ui64 total_frame_cycles = 0;
+    for(ui32 f=0; f < frame_count; ++f){
+        total_frame_cycles += state->frames[(state->frame_index - 1 - f) % PROFILE_FRAME_COUNT].frame_cycles;
+    }
+
+    for(ui32 id=0; id < PROFILE_MAX_BLOCKS; ++id){
+        ui64 cycles = 0;
+        ui64 hits = 0;
+        for(ui32 f=0; f < frame_count; ++f){
+            ProfileRecord *record = &state->frames[(state->frame_index - 1 - f) % PROFILE_FRAME_COUNT].records[id];
+            cycles += record->cycles;
+            hits += record->hits;
+        }
+        if(!hits){
+            continue;
+        }
+
+        ProfileHotspot hotspot = {0};
+        hotspot.name = state->names[id];
+        hotspot.id = id;
+        hotspot.cycles = cycles / frame_count;
+        hotspot.hits = (f32)hits / (f32)frame_count;
+        hotspot.frame_percent = total_frame_cycles ? (100.0f * (f32)cycles / (f32)total_frame_cycles) : 0.0f;
+
+        // NOTE: insertion into the sorted top list
+        ui32 index = result;
+        while(index > 0 && hotspots[index - 1].cycles < hotspot.cycles){
+            if(index < max_count){
+                hotspots[index] = hotspots[index - 1];
+            }
+            --index;
+        }
+        if(index < max_count){
+            hotspots[index] = hotspot;
+            if(result < max_count){
+                ++result;
+            }
+        }
+    }
+
+    return(result);
+}
+
+static void
+profile_dump(ProfileState *state, ui32 frame_count, ui32 top_count){
+    ProfileHotspot hotspots[32];
+    if(top_count > array_count(hotspots)){
+        top_count = array_count(hotspots);
+    }
+
+    if(frame_count > state->frame_index){
+        frame_count = (ui32)state->frame_index;
+    }
+    if(frame_count > PROFILE_FRAME_COUNT){
+        frame_count = PROFILE_FRAME_COUNT;
+    }
+
+    ui32 count = profile_top_hotspots(state, frame_count, hotspots, top_count);
+    print("profile: top %u over %u frames\n", count, frame_count);
+    for(ui32 i=0; i < count; ++i){
+        ProfileHotspot *h = &hotspots[i];
+        print("  %2u %-32s %12llucy %8.1fhits %6.2f%%\n", i, h->name, h->cycles, h->hits, h->frame_percent);
+    }
+}
+
+#define PROFILE_H
+#endif
@@ -0,0 +1,53 @@
+#if !defined(SIMD_H)
+
+// NOTE: shared bits for the SIMD paths. x64 always has SSE2, AVX and AVX2 are picked at runtime with
+// simd_level(), functions that use them are marked SIMD_TARGET_AVX / SIMD_TARGET_AVX2 so clang and gcc
+// build them without turning AVX on for the whole file. msvc needs no marking.
+
+#include <immintrin.h>
+
+#if defined(__clang__) || defined(__GNUC__)
+#define SIMD_TARGET_AVX __attribute__((target("avx")))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_AVX
+#define SIMD_TARGET_AVX2
+#endif
+
+typedef enum{SIMD_SSE2, SIMD_AVX, SIMD_AVX2} SimdLevel;
+
+static SimdLevel
+simd_detect(void){
+    SimdLevel result = SIMD_SSE2;
+
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    // NOTE: the os has to save the ymm registers too
+    if(osxsave && avx && ((_xgetbv(0) & 6) == 6)){
+        result = SIMD_AVX;
+        if(max_leaf >= 7){
+            __cpuidex(info, 7, 0);
+            if(info[1] & (1 << 5)){
+                result = SIMD_AVX2;
+            }
+        }
+    }
+
+    return(result);
+}
+
+static SimdLevel
+simd_level(void){
+    local_static i32 level = -1;
+    if(level < 0){
+        level = simd_detect();
+    }
+    return((SimdLevel)level);
+}
+
+#define SIMD_H
+#endif
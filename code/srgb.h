@@ -0,0 +1,119 @@
+#if !defined(SRGB_H)
+
+// NOTE: sRGB <-> linear light for RenderBuffer.linear_blend. The buffer holds sRGB bytes, and the default
+// blend mixes those bytes directly, which darkens every mix: 50% white over black comes out 128, which
+// looks like a 22% grey. The linear blend decodes dst through to_linear, mixes in 16 bit linear light and
+// encodes the result through to_srgb, which is indexed by the top SRGB_LINEAR_BITS of the 16 bit value.
+//
+// A pixel that is decoded and encoded again comes back the same byte, even after the blend rounds it down
+// by one, so transparent parts of a blend leave the buffer as it was.
+
+#include <math.h>
+#include "simd.h"
+
+#define SRGB_LINEAR_BITS 12
+#define SRGB_BUCKET_SHIFT (16 - SRGB_LINEAR_BITS)
+
+typedef struct SrgbTables{
+    ui16 to_linear[256];                // NOTE: 0 - 65535
+    ui8 to_srgb[1 << SRGB_LINEAR_BITS];
+} SrgbTables;
+
+static f32
+srgb_decode(f32 value){
+    f32 result = (value <= 0.04045f) ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+    return(result);
+}
+
+static f32
+srgb_encode(f32 value){
+    f32 result = (value <= 0.0031308f) ? value * 12.92f : (1.055f * powf(value, 1.0f / 2.4f)) - 0.055f;
+    return(result);
+}
+
+static SrgbTables *
+srgb_tables(void){
+    local_static SrgbTables tables;
+    local_static bool built;
+    if(!built){
+        ui32 bucket_count = 1 << SRGB_LINEAR_BITS;
+        for(ui32 i=0; i < bucket_count; ++i){
+            f32 linear = ((f32)i + 0.5f) / (f32)bucket_count;
+            tables.to_srgb[i] = (ui8)((srgb_encode(linear) * 255.0f) + 0.5f);
+        }
+
+        // NOTE: the decoded value, and the value one below it after the blend's mulhi, both have to land
+        // in a bucket that encodes back to the same byte. Holds for every byte with 12 bits.
+        for(ui32 i=0; i < 256; ++i){
+            ui32 linear = (ui32)((srgb_decode((f32)i / 255.0f) * 65535.0f) + 0.5f);
+            tables.to_linear[i] = (ui16)linear;
+            Assert(tables.to_srgb[linear >> SRGB_BUCKET_SHIFT] == i);
+            Assert(tables.to_srgb[(linear ? linear - 1 : 0) >> SRGB_BUCKET_SHIFT] == i);
+        }
+        built = true;
+    }
+    return(&tables);
+}
+
+// NOTE: c decoded for srgb_blend_4, as 2 pixels of 16 bit lanes like blend_packed_2's src. PackedColor
+// is premultiplied in sRGB, so it is unpremultiplied before decoding and multiplied again in linear. The
+// alpha goes to 0 - 65535 in lanes 3 and 7.
+static __m128i
+srgb_linear_color(SrgbTables *tables, PackedColor c){
+    ui32 a = c.argb >> 24;
+    if(!a){
+        return(_mm_setzero_si128());
+    }
+
+    ui16 channels[3];
+    for(ui32 i=0; i < 3; ++i){
+        ui32 value = (((c.argb >> (8 * i)) & 0xFF) * 255 + (a / 2)) / a;
+        value = (value > 255) ? 255 : value;
+        channels[i] = (ui16)(((tables->to_linear[value] * a) + 127) / 255);
+    }
+    ui16 alpha = (ui16)(a * 257);
+    return(_mm_setr_epi16((i16)channels[0], (i16)channels[1], (i16)channels[2], (i16)alpha,
+                          (i16)channels[0], (i16)channels[1], (i16)channels[2], (i16)alpha));
+}
+
+// NOTE: 2 pixels of srgb_linear_color scaled by coverage, 0 - 255 per 16 bit lane
+static inline __m128i
+srgb_scale_2(__m128i src, __m128i coverage){
+    return(_mm_mulhi_epu16(src, _mm_mullo_epi16(coverage, _mm_set1_epi16(257))));
+}
+
+// NOTE: src over dst in linear light for 2 pixels of 16 bit lanes
+static inline __m128i
+srgb_blend_2(__m128i dst, __m128i src){
+    __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i inv_alpha = _mm_xor_si128(alpha, _mm_set1_epi32(-1));
+    return(_mm_adds_epu16(_mm_mulhi_epu16(dst, inv_alpha), src));
+}
+
+// NOTE: blend_packed_4 in linear light. SSE2 has no gather, the 12 decodes and 12 encodes are table
+// loads around the 16 bit blend. The alpha byte is cleared like blend_packed_4.
+static inline __m128i
+srgb_blend_4(SrgbTables *tables, __m128i current, __m128i src_lo, __m128i src_hi){
+    ui32 pixels[4];
+    _mm_storeu_si128((__m128i *)pixels, current);
+    ui8 *bytes = (ui8 *)pixels;
+    ui16 *to_linear = tables->to_linear;
+    __m128i lo = _mm_setr_epi16((i16)to_linear[bytes[0]], (i16)to_linear[bytes[1]], (i16)to_linear[bytes[2]], 0,
+                                (i16)to_linear[bytes[4]], (i16)to_linear[bytes[5]], (i16)to_linear[bytes[6]], 0);
+    __m128i hi = _mm_setr_epi16((i16)to_linear[bytes[8]], (i16)to_linear[bytes[9]], (i16)to_linear[bytes[10]], 0,
+                                (i16)to_linear[bytes[12]], (i16)to_linear[bytes[13]], (i16)to_linear[bytes[14]], 0);
+    lo = _mm_srli_epi16(srgb_blend_2(lo, src_lo), SRGB_BUCKET_SHIFT);
+    hi = _mm_srli_epi16(srgb_blend_2(hi, src_hi), SRGB_BUCKET_SHIFT);
+
+    ui16 buckets[16];
+    _mm_storeu_si128((__m128i *)buckets, lo);
+    _mm_storeu_si128((__m128i *)(buckets + 8), hi);
+    ui8 *to_srgb = tables->to_srgb;
+    for(ui32 i=0; i < 16; ++i){
+        bytes[i] = to_srgb[buckets[i]];
+    }
+    return(_mm_and_si128(_mm_loadu_si128((__m128i *)pixels), _mm_set1_epi32(0x00FFFFFF)));
+}
+
+#define SRGB_H
+#endif
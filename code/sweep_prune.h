@@ -0,0 +1,421 @@
+#if !defined(SWEEP_PRUNE_H)
+
+// NOTE: incremental sweep and prune, the broad phase for scenes where boxes move a little every frame.
+// Unlike the grid in broadphase.h nothing is rebuilt: the min and max endpoints of every box stay
+// sorted along x and along y from one frame to the next, sweep_prune_update writes the new values in
+// and insertion sorts both lists again, which is close to linear when the order barely changed.
+//
+// Two boxes only start or stop overlapping when a min endpoint of one passes a max endpoint of the
+// other on some axis, and insertion sort swaps exactly those neighbours, so the swaps are the only
+// pairs that get looked at. Each one is checked against the final boxes and the set of overlapping
+// pairs, a difference becomes an OVERLAP_BEGIN or OVERLAP_END event. A pair that crosses back and
+// forth within one update produces nothing. Most swaps are boxes passing each other far apart on the
+// other axis, those are settled from the boxes alone without touching the pair set.
+//
+// At equal values max endpoints sort before min endpoints, so boxes that only touch are apart, same
+// as rect_collide_rect. Boxes are the indices of the AabbArray passed to the update, they have to stay
+// put between frames. Boxes appended to the array join on the next update, dropping boxes off the
+// end of it ends their pairs. Adding many boxes at once, the first update included, radix sorts the new
+// endpoints, merges them in and takes their pairs from a spatial grid instead of going through the
+// insertion sort.
+
+typedef struct SweepEndpoint{
+    f32 value;
+    ui32 id; // NOTE: box << 1, low bit set for the min endpoint
+} SweepEndpoint;
+
+typedef enum{OVERLAP_BEGIN, OVERLAP_END} OverlapEventKind;
+
+typedef struct OverlapEvent{
+    ui32 a; // NOTE: a < b
+    ui32 b;
+    OverlapEventKind kind;
+} OverlapEvent;
+
+#define SWEEP_PAIR_EMPTY 0xFFFFFFFFFFFFFFFFULL
+
+// NOTE: more boxes than this added in one update are sorted on their own and merged in, past a handful
+// walking each new endpoint down the whole list costs more than a radix sort and a grid rebuild
+#define SWEEP_PRUNE_BULK_ADD 32
+
+typedef struct SweepPrune{
+    ui32 count;
+    ui32 capacity;
+    SweepEndpoint *x; // NOTE: 2 * capacity
+    SweepEndpoint *y;
+    AabbArray previous; // NOTE: the boxes as of the last update
+
+    // NOTE: the overlapping pairs, open addressing with linear probing, key (a << 32) | b
+    ui64 *pairs;
+    ui32 pair_mask;
+    ui32 pair_count;
+    ui32 max_pairs;
+    bool pairs_overflowed; // NOTE: a pair did not fit once, the set may miss pairs from then on
+} SweepPrune;
+
+// NOTE: returns 0 when the arena is too small, needs to live as long as the boxes do
+static SweepPrune *
+sweep_prune_init(Arena *arena, ui32 capacity, ui32 max_pairs){
+    SweepPrune *result = push_array(arena, SweepPrune, 1);
+    if(result){
+        // NOTE: at most half full keeps the probes short
+        ui32 slots = 16;
+        while(slots < max_pairs * 2){
+            slots *= 2;
+        }
+
+        result->x = push_array(arena, SweepEndpoint, capacity * 2);
+        result->y = push_array(arena, SweepEndpoint, capacity * 2);
+        result->pairs = push_array(arena, ui64, slots);
+        if(!result->x || !result->y || !result->pairs || !aabb_array_init(&result->previous, arena, capacity)){
+            return(0);
+        }
+        memset(result->pairs, 0xFF, sizeof(ui64) * slots);
+        result->count = 0;
+        result->capacity = capacity;
+        result->pair_mask = slots - 1;
+        result->pair_count = 0;
+        result->max_pairs = max_pairs;
+        result->pairs_overflowed = false;
+    }
+    return(result);
+}
+
+static ui32
+sweep_pair_slot(SweepPrune *sap, ui64 key){
+    return((ui32)((key * 0x9E3779B97F4A7C15ULL) >> 32) & sap->pair_mask);
+}
+
+static bool
+sweep_pair_find(SweepPrune *sap, ui64 key, ui32 *slot){
+    ui32 index = sweep_pair_slot(sap, key);
+    while(sap->pairs[index] != SWEEP_PAIR_EMPTY){
+        if(sap->pairs[index] == key){
+            *slot = index;
+            return(true);
+        }
+        index = (index + 1) & sap->pair_mask;
+    }
+    *slot = index;
+    return(false);
+}
+
+// NOTE: backward shift instead of tombstones, so probe lengths do not creep up over a long session
+static void
+sweep_pair_remove(SweepPrune *sap, ui32 slot){
+    ui32 hole = slot;
+    ui32 index = (slot + 1) & sap->pair_mask;
+    while(sap->pairs[index] != SWEEP_PAIR_EMPTY){
+        ui32 home = sweep_pair_slot(sap, sap->pairs[index]);
+        // NOTE: move the entry into the hole when its home is not between the hole and where it sits
+        if(((index - home) & sap->pair_mask) >= ((index - hole) & sap->pair_mask)){
+            sap->pairs[hole] = sap->pairs[index];
+            hole = index;
+        }
+        index = (index + 1) & sap->pair_mask;
+    }
+    sap->pairs[hole] = SWEEP_PAIR_EMPTY;
+    --sap->pair_count;
+}
+
+typedef struct SweepEvents{
+    OverlapEvent *events;
+    ui32 count;
+    ui32 capacity;
+    bool overflowed;
+} SweepEvents;
+
+static void
+sweep_emit(SweepEvents *out, ui32 a, ui32 b, OverlapEventKind kind){
+    if(out->count == out->capacity){
+        out->overflowed = true;
+        return;
+    }
+    OverlapEvent *event = &out->events[out->count++];
+    event->a = a;
+    event->b = b;
+    event->kind = kind;
+}
+
+static void
+sweep_pair_insert(SweepPrune *sap, ui32 slot, ui64 key, SweepEvents *out){
+    if(sap->pair_count >= sap->max_pairs){
+        sap->pairs_overflowed = true;
+        return;
+    }
+    sap->pairs[slot] = key;
+    ++sap->pair_count;
+    sweep_emit(out, (ui32)(key >> 32), (ui32)key, OVERLAP_BEGIN);
+}
+
+static ui64
+sweep_pair_key(ui32 a, ui32 b){
+    return((a < b) ? (((ui64)a << 32) | b) : (((ui64)b << 32) | a));
+}
+
+// NOTE: a min endpoint passed a max endpoint of another box on the way down. Before the swap the two were
+// apart on this axis, so the pair can only be new. Most of these swaps are boxes that are still apart
+// on the other axis, they never get to the pair set.
+static void
+sweep_prune_closer(SweepPrune *sap, AabbArray *boxes, ui32 a, ui32 b, SweepEvents *out){
+    if(aabb_overlap(boxes, a, b)){
+        ui64 key = sweep_pair_key(a, b);
+        ui32 slot;
+        if(!sweep_pair_find(sap, key, &slot)){
+            sweep_pair_insert(sap, slot, key, out);
+        }
+    }
+}
+
+// NOTE: a max endpoint passed a min endpoint of another box on the way down, the two are apart now. The
+// pair can only be in the set when they overlapped last update, which previous answers without a
+// lookup.
+static void
+sweep_prune_apart(SweepPrune *sap, ui32 a, ui32 b, SweepEvents *out){
+    if(aabb_overlap(&sap->previous, a, b)){
+        ui64 key = sweep_pair_key(a, b);
+        ui32 slot;
+        if(sweep_pair_find(sap, key, &slot)){
+            sweep_pair_remove(sap, slot);
+            sweep_emit(out, (ui32)(key >> 32), (ui32)key, OVERLAP_END);
+        }
+    }
+}
+
+static bool
+sweep_less(SweepEndpoint a, SweepEndpoint b){
+    return((a.value < b.value) || ((a.value == b.value) && ((a.id & 1) < (b.id & 1))));
+}
+
+static void
+sweep_prune_sort(SweepPrune *sap, AabbArray *boxes, SweepEndpoint *endpoints, ui32 count, SweepEvents *out){
+    for(ui32 i=1; i < count; ++i){
+        SweepEndpoint moving = endpoints[i];
+        ui32 j = i;
+        while(j > 0){
+            SweepEndpoint before = endpoints[j - 1];
+            if(!sweep_less(moving, before)){
+                break;
+            }
+            if(((moving.id ^ before.id) & 1) && ((moving.id >> 1) != (before.id >> 1))){
+                if(moving.id & 1){
+                    sweep_prune_closer(sap, boxes, moving.id >> 1, before.id >> 1, out);
+                }
+                else{
+                    sweep_prune_apart(sap, moving.id >> 1, before.id >> 1, out);
+                }
+            }
+            endpoints[j] = before;
+            --j;
+        }
+        endpoints[j] = moving;
+    }
+}
+
+static void
+sweep_prune_refresh(SweepEndpoint *endpoints, ui32 count, f32 *min, f32 *max){
+    for(ui32 i=0; i < count; ++i){
+        ui32 box = endpoints[i].id >> 1;
+        endpoints[i].value = (endpoints[i].id & 1) ? min[box] : max[box];
+    }
+}
+
+// NOTE: drops the endpoints of boxes past count, keeping the order of the rest
+static ui32
+sweep_prune_compact(SweepEndpoint *endpoints, ui32 endpoint_count, ui32 count){
+    ui32 kept = 0;
+    for(ui32 i=0; i < endpoint_count; ++i){
+        if((endpoints[i].id >> 1) < count){
+            endpoints[kept++] = endpoints[i];
+        }
+    }
+    return(kept);
+}
+
+// NOTE: float bits flipped so they sort as unsigned, -0 counts as 0 like the compares do
+static ui32
+sweep_radix_key(f32 value){
+    union{f32 f; ui32 u;} bits;
+    bits.f = value + 0.0f;
+    return(bits.u ^ ((bits.u & 0x80000000) ? 0xFFFFFFFF : 0x80000000));
+}
+
+// NOTE: LSD radix sort for the endpoints of boxes added in bulk, insertion sort would be quadratic. It
+// is stable, so putting the max endpoints first keeps max before min at equal values.
+static void
+sweep_sort_endpoints(SweepEndpoint *endpoints, SweepEndpoint *scratch, ui32 count){
+    SweepEndpoint *from = endpoints;
+    SweepEndpoint *to = scratch;
+    for(ui32 shift=0; shift < 32; shift += 8){
+        ui32 offsets[256] = {0};
+        for(ui32 i=0; i < count; ++i){
+            ++offsets[(sweep_radix_key(from[i].value) >> shift) & 0xFF];
+        }
+        ui32 total = 0;
+        for(ui32 digit=0; digit < 256; ++digit){
+            ui32 digit_count = offsets[digit];
+            offsets[digit] = total;
+            total += digit_count;
+        }
+        for(ui32 i=0; i < count; ++i){
+            to[offsets[(sweep_radix_key(from[i].value) >> shift) & 0xFF]++] = from[i];
+        }
+        SweepEndpoint *swap = from;
+        from = to;
+        to = swap;
+    }
+    // NOTE: four passes leave the result back in endpoints
+}
+
+// NOTE: merges sorted added endpoints into the sorted list from the back, list has room for both
+static void
+sweep_merge_endpoints(SweepEndpoint *list, ui32 count, SweepEndpoint *added, ui32 added_count){
+    i64 i = (i64)count - 1;
+    i64 j = (i64)added_count - 1;
+    i64 k = (i64)count + added_count - 1;
+    while(j >= 0){
+        if(i >= 0 && sweep_less(added[j], list[i])){
+            list[k--] = list[i--];
+        }
+        else{
+            list[k--] = added[j--];
+        }
+    }
+}
+
+typedef struct SweepBulk{
+    SweepEndpoint *x;
+    SweepEndpoint *y;
+    SweepEndpoint *scratch;
+    OverlapPair *pairs; // NOTE: every overlapping pair, from a spatial grid over all boxes
+    ui32 pair_count;
+} SweepBulk;
+
+// NOTE: the events go onto the free end of the frame arena. Stops recording events once the arena is
+// full and sets overflowed, the pair set stays right either way.
+static ui32
+sweep_prune_update(SweepPrune *sap, AabbArray *boxes, Arena *arena, OverlapEvent **events, bool *overflowed){
+    ui32 count = (boxes->count < sap->capacity) ? boxes->count : sap->capacity;
+
+    // NOTE: scratch for many added boxes comes first, the events need the end of the arena to themselves
+    SweepBulk bulk = {0};
+    ui32 added = (count > sap->count) ? count - sap->count : 0;
+    if(added > SWEEP_PRUNE_BULK_ADD){
+        ui64 mark = arena->used;
+        bulk.x = push_array(arena, SweepEndpoint, added * 2);
+        bulk.y = push_array(arena, SweepEndpoint, added * 2);
+        bulk.scratch = push_array(arena, SweepEndpoint, added * 2);
+
+        // NOTE: the pairs of the added boxes come from the grid broad phase, one rebuild is far cheaper
+        // than sweeping the whole list with every added box
+        AabbArray all = *boxes;
+        all.count = count;
+        SpatialGrid grid;
+        bool grid_overflowed = true;
+        if(bulk.x && bulk.y && bulk.scratch && spatial_grid_build(&grid, arena, &all, 0.0f)){
+            bulk.pair_count = spatial_grid_pairs(&grid, arena, &bulk.pairs, &grid_overflowed);
+        }
+        if(grid_overflowed){
+            // NOTE: no room, the slow way still gets there
+            arena->used = mark;
+            bulk.x = 0;
+        }
+    }
+
+    SweepEvents out = {0};
+    ui64 begin = (arena->used + 63) & ~63ULL;
+    ui64 available = (begin < arena->size) ? (arena->size - begin) / sizeof(OverlapEvent) : 0;
+    out.events = (OverlapEvent *)(arena->base + begin);
+    out.capacity = (available > 0xFFFFFFFF) ? 0xFFFFFFFF : (ui32)available;
+
+    if(count < sap->count){
+        sweep_prune_compact(sap->x, sap->count * 2, count);
+        sweep_prune_compact(sap->y, sap->count * 2, count);
+        for(ui32 slot=0; slot <= sap->pair_mask; ++slot){
+            ui64 key = sap->pairs[slot];
+            // NOTE: b is the larger index; after a backward shift the same slot holds a new entry
+            while(key != SWEEP_PAIR_EMPTY && (ui32)key >= count){
+                sweep_emit(&out, (ui32)(key >> 32), (ui32)key, OVERLAP_END);
+                sweep_pair_remove(sap, slot);
+                key = sap->pairs[slot];
+            }
+        }
+        sap->count = count;
+    }
+
+    ui32 endpoint_count = sap->count * 2;
+    sweep_prune_refresh(sap->x, endpoint_count, boxes->min_x, boxes->max_x);
+    sweep_prune_refresh(sap->y, endpoint_count, boxes->min_y, boxes->max_y);
+
+    if(bulk.x){
+        sweep_prune_sort(sap, boxes, sap->x, endpoint_count, &out);
+        sweep_prune_sort(sap, boxes, sap->y, endpoint_count, &out);
+
+        ui32 first_added = sap->count;
+        for(ui32 i=0; i < added; ++i){
+            ui32 box = first_added + i;
+            SweepEndpoint min_x = {boxes->min_x[box], (box << 1) | 1};
+            SweepEndpoint max_x = {boxes->max_x[box], box << 1};
+            SweepEndpoint min_y = {boxes->min_y[box], (box << 1) | 1};
+            SweepEndpoint max_y = {boxes->max_y[box], box << 1};
+            bulk.x[i] = max_x;
+            bulk.x[added + i] = min_x;
+            bulk.y[i] = max_y;
+            bulk.y[added + i] = min_y;
+        }
+        sweep_sort_endpoints(bulk.x, bulk.scratch, added * 2);
+        sweep_sort_endpoints(bulk.y, bulk.scratch, added * 2);
+        sweep_merge_endpoints(sap->x, endpoint_count, bulk.x, added * 2);
+        sweep_merge_endpoints(sap->y, endpoint_count, bulk.y, added * 2);
+        sap->count = count;
+        for(ui32 i=0; i < bulk.pair_count; ++i){
+            OverlapPair *pair = &bulk.pairs[i];
+            if(pair->b >= first_added){
+                ui64 key = sweep_pair_key(pair->a, pair->b);
+                ui32 slot;
+                if(!sweep_pair_find(sap, key, &slot)){
+                    sweep_pair_insert(sap, slot, key, &out);
+                }
+            }
+        }
+    }
+    else{
+        // NOTE: a few new boxes go on the end and get sorted in with everything else
+        for(ui32 box=sap->count; box < count; ++box){
+            SweepEndpoint min_x = {boxes->min_x[box], (box << 1) | 1};
+            SweepEndpoint max_x = {boxes->max_x[box], box << 1};
+            SweepEndpoint min_y = {boxes->min_y[box], (box << 1) | 1};
+            SweepEndpoint max_y = {boxes->max_y[box], box << 1};
+            sap->x[endpoint_count] = min_x;
+            sap->y[endpoint_count] = min_y;
+            ++endpoint_count;
+            sap->x[endpoint_count] = max_x;
+            sap->y[endpoint_count] = max_y;
+            ++endpoint_count;
+        }
+        sap->count = count;
+
+        sweep_prune_sort(sap, boxes, sap->x, endpoint_count, &out);
+        sweep_prune_sort(sap, boxes, sap->y, endpoint_count, &out);
+    }
+
+    memcpy(sap->previous.min_x, boxes->min_x, sizeof(f32) * count);
+    memcpy(sap->previous.min_y, boxes->min_y, sizeof(f32) * count);
+    memcpy(sap->previous.max_x, boxes->max_x, sizeof(f32) * count);
+    memcpy(sap->previous.max_y, boxes->max_y, sizeof(f32) * count);
+
+    arena_push(arena, sizeof(OverlapEvent) * out.count, 64);
+    *events = out.events;
+    *overflowed = out.overflowed || sap->pairs_overflowed;
+    return(out.count);
+}
+
+static bool
+sweep_prune_overlapping(SweepPrune *sap, ui32 a, ui32 b){
+    ui64 key = (a < b) ? (((ui64)a << 32) | b) : (((ui64)b << 32) | a);
+    ui32 slot;
+    return(sweep_pair_find(sap, key, &slot));
+}
+
+#define SWEEP_PRUNE_H
+#endif
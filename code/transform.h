@@ -0,0 +1,181 @@
+#if !defined(TRANSFORM_H)
+
+// NOTE: batched 2d affine transforms over structure of arrays point buffers. The mat3 is read once and
+// broadcast, 8 points go through per AVX instruction (4 with SSE2), there is no trig in the loop, build
+// rotations once with rotation3x3. At this width the loop is bound by memory, not by the math.
+//
+// out_x / out_y may be the same buffers as x / y to transform in place. Only the top two rows of the
+// mat3 are used, the last one is assumed to be 0 0 1.
+
+#include "simd.h"
+
+static void
+transform_points_scalar(mat3 *m, f32 *x, f32 *y, f32 *out_x, f32 *out_y, ui32 begin, ui32 end){
+    for(ui32 i=begin; i < end; ++i){
+        f32 px = x[i];
+        f32 py = y[i];
+        out_x[i] = (m->_11 * px) + (m->_12 * py) + m->_13;
+        out_y[i] = (m->_21 * px) + (m->_22 * py) + m->_23;
+    }
+}
+
+static ui32
+transform_points_sse2(mat3 *m, f32 *x, f32 *y, f32 *out_x, f32 *out_y, ui32 count){
+    __m128 m11 = _mm_set1_ps(m->_11);
+    __m128 m12 = _mm_set1_ps(m->_12);
+    __m128 m13 = _mm_set1_ps(m->_13);
+    __m128 m21 = _mm_set1_ps(m->_21);
+    __m128 m22 = _mm_set1_ps(m->_22);
+    __m128 m23 = _mm_set1_ps(m->_23);
+
+    ui32 i = 0;
+    for(; i + 4 <= count; i += 4){
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m11, px), _mm_mul_ps(m12, py)), m13);
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m21, px), _mm_mul_ps(m22, py)), m23);
+        _mm_storeu_ps(out_x + i, rx);
+        _mm_storeu_ps(out_y + i, ry);
+    }
+    return(i);
+}
+
+SIMD_TARGET_AVX static ui32
+transform_points_avx(mat3 *m, f32 *x, f32 *y, f32 *out_x, f32 *out_y, ui32 count){
+    __m256 m11 = _mm256_set1_ps(m->_11);
+    __m256 m12 = _mm256_set1_ps(m->_12);
+    __m256 m13 = _mm256_set1_ps(m->_13);
+    __m256 m21 = _mm256_set1_ps(m->_21);
+    __m256 m22 = _mm256_set1_ps(m->_22);
+    __m256 m23 = _mm256_set1_ps(m->_23);
+
+    ui32 i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 rx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m11, px), _mm256_mul_ps(m12, py)), m13);
+        __m256 ry = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m21, px), _mm256_mul_ps(m22, py)), m23);
+        _mm256_storeu_ps(out_x + i, rx);
+        _mm256_storeu_ps(out_y + i, ry);
+    }
+    // NOTE: leaving ymm dirty makes the following sse code pay for the transition
+    _mm256_zeroupper();
+    return(i);
+}
+
+static void
+transform_points_to(mat3 *m, f32 *x, f32 *y, f32 *out_x, f32 *out_y, ui32 count){
+    ui32 done = 0;
+    if(simd_level() >= SIMD_AVX){
+        done = transform_points_avx(m, x, y, out_x, out_y, count);
+    }
+    else{
+        done = transform_points_sse2(m, x, y, out_x, out_y, count);
+    }
+    transform_points_scalar(m, x, y, out_x, out_y, done, count);
+}
+
+static void
+transform_points(mat3 *m, f32 *x, f32 *y, ui32 count){
+    transform_points_to(m, x, y, x, y, count);
+}
+
+// NOTE: flat transform hierarchy. Every node is an index, parent / local / world / changed are separate
+// arrays out of an Arena. A node's parent always has a smaller index (transform_add enforces it), so one
+// pass in index order sees every parent before its children and there is no recursion and no sorting.
+//
+// transform_set_local marks a node with the generation of the coming update. The update recomputes a
+// node when it was marked or its parent was recomputed in the same pass, which is exactly the changed
+// subtrees, and it starts at the lowest marked index. Afterwards transform_changed tells which world
+// matrices moved. Nodes are only ever appended, transform_clear drops the whole scene.
+
+struct TransformHierarchy{
+    ui32 count;
+    ui32 capacity;
+    i32 *parent;  // NOTE: -1 for roots
+    mat3 *local;
+    mat3 *world;
+    ui32 *changed; // NOTE: generation of the last update that recomputed world, generation + 1 while marked
+    ui32 generation;
+    ui32 first_dirty;
+};
+
+// NOTE: returns 0 when the arena is too small
+static TransformHierarchy *
+transform_hierarchy(Arena *arena, ui32 capacity){
+    TransformHierarchy *result = push_array(arena, TransformHierarchy, 1);
+    if(result){
+        result->parent = push_array(arena, i32, capacity);
+        result->local = push_array(arena, mat3, capacity);
+        result->world = push_array(arena, mat3, capacity);
+        result->changed = push_array(arena, ui32, capacity);
+        if(!result->parent || !result->local || !result->world || !result->changed){
+            return(0);
+        }
+        result->capacity = capacity;
+        result->count = 0;
+        result->generation = 0;
+        result->first_dirty = 0;
+    }
+    return(result);
+}
+
+static void
+transform_clear(TransformHierarchy *h){
+    h->count = 0;
+    h->first_dirty = 0;
+}
+
+// NOTE: returns -1 when the hierarchy is full, parent is -1 or an existing node
+static i32
+transform_add(TransformHierarchy *h, i32 parent, mat3 local){
+    Assert(parent < (i32)h->count);
+    if(h->count >= h->capacity){
+        return(-1);
+    }
+
+    i32 index = (i32)h->count++;
+    h->parent[index] = parent;
+    h->local[index] = local;
+    h->changed[index] = h->generation + 1;
+    if((ui32)index < h->first_dirty){
+        h->first_dirty = index;
+    }
+    return(index);
+}
+
+static void
+transform_set_local(TransformHierarchy *h, i32 index, mat3 local){
+    h->local[index] = local;
+    h->changed[index] = h->generation + 1;
+    if((ui32)index < h->first_dirty){
+        h->first_dirty = index;
+    }
+}
+
+static void
+transform_update(TransformHierarchy *h){
+    ui32 generation = ++h->generation;
+    for(ui32 i=h->first_dirty; i < h->count; ++i){
+        i32 parent = h->parent[i];
+        if(parent < 0){
+            if(h->changed[i] == generation){
+                h->world[i] = h->local[i];
+            }
+        }
+        else if(h->changed[i] == generation || h->changed[parent] == generation){
+            h->world[i] = affine_mul3x3(&h->world[parent], &h->local[i]);
+            h->changed[i] = generation;
+        }
+    }
+    h->first_dirty = h->count;
+}
+
+// NOTE: true when the last transform_update moved the node's world matrix
+static bool
+transform_changed(TransformHierarchy *h, i32 index){
+    return(h->changed[index] == h->generation);
+}
+
+#define TRANSFORM_H
+#endif
@@ -0,0 +1,383 @@
+#if !defined(TRIG_H)
+
+// NOTE: polynomial sin / cos / atan2 for batches of angles, so rotation heavy code (particles, spinning
+// sprites) does not sit in libm once per element. Every function comes scalar, 4 wide (SSE2) and 8
+// wide (AVX2), the _array versions pick the widest one at runtime like transform_points_to.
+//
+// sin and cos reduce the angle to [-pi/4, pi/4] around the nearest multiple of pi/2 (pi/2 split in
+// three parts so the reduction stays exact) and pick the polynomial and sign from the quadrant.
+// atan2 works on min(|x|, |y|) / max(|x|, |y|) in [0, 1] and folds the octant back in.
+//
+// Largest absolute error against libm, the bounds trig_self_check holds them to:
+//   TRIG_FAST      sin / cos 4e-4, atan2 1e-3 (uses the rcp estimate instead of a divide)
+//   TRIG_PRECISE   sin / cos 2e-7, atan2 6e-7
+// for |angle| up to TRIG_MAX_ANGLE, past that the reduction loses bits.
+
+#include <float.h>
+#include <math.h>
+#include "simd.h"
+
+#define TRIG_MAX_ANGLE 8192.0f
+#define TRIG_FAST_SINCOS_MAX_ERROR 4e-4f
+#define TRIG_FAST_ATAN2_MAX_ERROR 1e-3f
+#define TRIG_PRECISE_SINCOS_MAX_ERROR 2e-7f
+#define TRIG_PRECISE_ATAN2_MAX_ERROR 6e-7f
+
+typedef enum{TRIG_FAST, TRIG_PRECISE} TrigPrecision;
+
+#define TRIG_2_OVER_PI 0.636619772f
+#define TRIG_PI_2_A 1.5703125f
+#define TRIG_PI_2_B 4.837512969970703125e-4f
+#define TRIG_PI_2_C 7.54978995489188216e-8f
+
+// NOTE: sin(r) = r + r*z*(s1 + z*(s2 + z*s3)), cos(r) = 1 - z/2 + z*z*(c1 + z*(c2 + z*c3)), z = r*r
+#define TRIG_FAST_S1 -0.162259105f
+#define TRIG_FAST_C1 0.0409084400f
+#define TRIG_PRECISE_S1 -1.6666654611e-1f
+#define TRIG_PRECISE_S2 8.3321608736e-3f
+#define TRIG_PRECISE_S3 -1.9515295891e-4f
+#define TRIG_PRECISE_C1 4.166664568298827e-2f
+#define TRIG_PRECISE_C2 -1.388731625493765e-3f
+#define TRIG_PRECISE_C3 2.443315711809948e-5f
+
+// NOTE: atan(t) = t*(a0 + z*(a1 + z*(a2 + ...))), z = t*t, t in [0, 1]
+#define TRIG_FAST_A0 0.995357961f
+#define TRIG_FAST_A1 -0.288690157f
+#define TRIG_FAST_A2 0.0793389391f
+#define TRIG_PRECISE_A0 0.999996112f
+#define TRIG_PRECISE_A1 -0.333173686f
+#define TRIG_PRECISE_A2 0.198078189f
+#define TRIG_PRECISE_A3 -0.132333523f
+#define TRIG_PRECISE_A4 0.0796238269f
+#define TRIG_PRECISE_A5 -0.0336043351f
+#define TRIG_PRECISE_A6 0.00681182639f
+
+#define TRIG_PI 3.14159265f
+#define TRIG_PI_2 1.57079633f
+
+static void
+trig_sincos(f32 angle, TrigPrecision precision, f32 *out_sin, f32 *out_cos){
+    i32 k = _mm_cvtss_si32(_mm_set_ss(angle * TRIG_2_OVER_PI));
+    f32 fk = (f32)k;
+    f32 r = ((angle - (fk * TRIG_PI_2_A)) - (fk * TRIG_PI_2_B)) - (fk * TRIG_PI_2_C);
+    f32 z = r * r;
+
+    f32 s, c;
+    if(precision == TRIG_FAST){
+        s = r + ((r * z) * TRIG_FAST_S1);
+        c = (1.0f - (z * 0.5f)) + ((z * z) * TRIG_FAST_C1);
+    }
+    else{
+        s = r + ((r * z) * (TRIG_PRECISE_S1 + (z * (TRIG_PRECISE_S2 + (z * TRIG_PRECISE_S3)))));
+        c = (1.0f - (z * 0.5f)) + ((z * z) * (TRIG_PRECISE_C1 + (z * (TRIG_PRECISE_C2 + (z * TRIG_PRECISE_C3)))));
+    }
+
+    f32 sin_result = (k & 1) ? c : s;
+    f32 cos_result = (k & 1) ? s : c;
+    *out_sin = (k & 2) ? -sin_result : sin_result;
+    *out_cos = ((k + 1) & 2) ? -cos_result : cos_result;
+}
+
+static f32
+trig_sin(f32 angle, TrigPrecision precision){
+    f32 s, c;
+    trig_sincos(angle, precision, &s, &c);
+    return(s);
+}
+
+static f32
+trig_cos(f32 angle, TrigPrecision precision){
+    f32 s, c;
+    trig_sincos(angle, precision, &s, &c);
+    return(c);
+}
+
+static f32
+trig_atan2(f32 y, f32 x, TrigPrecision precision){
+    f32 ax = (x < 0.0f) ? -x : x;
+    f32 ay = (y < 0.0f) ? -y : y;
+    f32 mn = (ax < ay) ? ax : ay;
+    f32 mx = (ax < ay) ? ay : ax;
+    mx = (mx < FLT_MIN) ? FLT_MIN : mx;
+
+    f32 a;
+    if(precision == TRIG_FAST){
+        f32 t = mn * _mm_cvtss_f32(_mm_rcp_ss(_mm_set_ss(mx)));
+        f32 z = t * t;
+        a = t * (TRIG_FAST_A0 + (z * (TRIG_FAST_A1 + (z * TRIG_FAST_A2))));
+    }
+    else{
+        f32 t = mn / mx;
+        f32 z = t * t;
+        f32 p = TRIG_PRECISE_A5 + (z * TRIG_PRECISE_A6);
+        p = TRIG_PRECISE_A4 + (z * p);
+        p = TRIG_PRECISE_A3 + (z * p);
+        p = TRIG_PRECISE_A2 + (z * p);
+        p = TRIG_PRECISE_A1 + (z * p);
+        p = TRIG_PRECISE_A0 + (z * p);
+        a = t * p;
+    }
+
+    a = (ay > ax) ? (TRIG_PI_2 - a) : a;
+    a = (x < 0.0f) ? (TRIG_PI - a) : a;
+    return((y < 0.0f) ? -a : a);
+}
+
+static void
+trig_sincos_4(__m128 angle, TrigPrecision precision, __m128 *out_sin, __m128 *out_cos){
+    __m128i k = _mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(TRIG_2_OVER_PI)));
+    __m128 fk = _mm_cvtepi32_ps(k);
+    __m128 r = _mm_sub_ps(angle, _mm_mul_ps(fk, _mm_set1_ps(TRIG_PI_2_A)));
+    r = _mm_sub_ps(r, _mm_mul_ps(fk, _mm_set1_ps(TRIG_PI_2_B)));
+    r = _mm_sub_ps(r, _mm_mul_ps(fk, _mm_set1_ps(TRIG_PI_2_C)));
+    __m128 z = _mm_mul_ps(r, r);
+
+    __m128 s, c;
+    __m128 c_base = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+    if(precision == TRIG_FAST){
+        s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z), _mm_set1_ps(TRIG_FAST_S1)));
+        c = _mm_add_ps(c_base, _mm_mul_ps(_mm_mul_ps(z, z), _mm_set1_ps(TRIG_FAST_C1)));
+    }
+    else{
+        __m128 ps = _mm_add_ps(_mm_set1_ps(TRIG_PRECISE_S2), _mm_mul_ps(z, _mm_set1_ps(TRIG_PRECISE_S3)));
+        ps = _mm_add_ps(_mm_set1_ps(TRIG_PRECISE_S1), _mm_mul_ps(z, ps));
+        s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z), ps));
+        __m128 pc = _mm_add_ps(_mm_set1_ps(TRIG_PRECISE_C2), _mm_mul_ps(z, _mm_set1_ps(TRIG_PRECISE_C3)));
+        pc = _mm_add_ps(_mm_set1_ps(TRIG_PRECISE_C1), _mm_mul_ps(z, pc));
+        c = _mm_add_ps(c_base, _mm_mul_ps(_mm_mul_ps(z, z), pc));
+    }
+
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(k, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128 sin_result = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+    __m128 cos_result = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+    __m128 sin_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(k, _mm_set1_epi32(2)), 30));
+    __m128 cos_sign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(k, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+    *out_sin = _mm_xor_ps(sin_result, sin_sign);
+    *out_cos = _mm_xor_ps(cos_result, cos_sign);
+}
+
+static __m128
+trig_atan2_4(__m128 y, __m128 x, TrigPrecision precision){
+    __m128 sign_bit = _mm_set1_ps(-0.0f);
+    __m128 ax = _mm_andnot_ps(sign_bit, x);
+    __m128 ay = _mm_andnot_ps(sign_bit, y);
+    __m128 mn = _mm_min_ps(ax, ay);
+    __m128 mx = _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(FLT_MIN));
+
+    __m128 a;
+    if(precision == TRIG_FAST){
+        __m128 t = _mm_mul_ps(mn, _mm_rcp_ps(mx));
+        __m128 z = _mm_mul_ps(t, t);
+        __m128 p = _mm_add_ps(_mm_set1_ps(TRIG_FAST_A1), _mm_mul_ps(z, _mm_set1_ps(TRIG_FAST_A2)));
+        p = _mm_add_ps(_mm_set1_ps(TRIG_FAST_A0), _mm_mul_ps(z, p));
+        a = _mm_mul_ps(t, p);
+    }
+    else{
+        __m128 t = _mm_div_ps(mn, mx);
+        __m128 z = _mm_mul_ps(t, t);
+        __m128 p = _mm_add_ps(_mm_set1_ps(TRIG_PRECISE_A5), _mm_mul_ps(z, _mm_set1_ps(TRIG_PRECISE_A6)));
+        p = _mm_add_ps(_mm_set1_ps(TRIG_PRECISE_A4), _mm_mul_ps(z, p));
+        p = _mm_add_ps(_mm_set1_ps(TRIG_PRECISE_A3), _mm_mul_ps(z, p));
+        p = _mm_add_ps(_mm_set1_ps(TRIG_PRECISE_A2), _mm_mul_ps(z, p));
+        p = _mm_add_ps(_mm_set1_ps(TRIG_PRECISE_A1), _mm_mul_ps(z, p));
+        p = _mm_add_ps(_mm_set1_ps(TRIG_PRECISE_A0), _mm_mul_ps(z, p));
+        a = _mm_mul_ps(t, p);
+    }
+
+    __m128 steep = _mm_cmpgt_ps(ay, ax);
+    a = _mm_or_ps(_mm_and_ps(steep, _mm_sub_ps(_mm_set1_ps(TRIG_PI_2), a)), _mm_andnot_ps(steep, a));
+    __m128 left = _mm_cmplt_ps(x, _mm_setzero_ps());
+    a = _mm_or_ps(_mm_and_ps(left, _mm_sub_ps(_mm_set1_ps(TRIG_PI), a)), _mm_andnot_ps(left, a));
+    __m128 below = _mm_and_ps(_mm_cmplt_ps(y, _mm_setzero_ps()), sign_bit);
+    return(_mm_xor_ps(a, below));
+}
+
+SIMD_TARGET_AVX2 static void
+trig_sincos_8(__m256 angle, TrigPrecision precision, __m256 *out_sin, __m256 *out_cos){
+    __m256i k = _mm256_cvtps_epi32(_mm256_mul_ps(angle, _mm256_set1_ps(TRIG_2_OVER_PI)));
+    __m256 fk = _mm256_cvtepi32_ps(k);
+    __m256 r = _mm256_sub_ps(angle, _mm256_mul_ps(fk, _mm256_set1_ps(TRIG_PI_2_A)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(fk, _mm256_set1_ps(TRIG_PI_2_B)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(fk, _mm256_set1_ps(TRIG_PI_2_C)));
+    __m256 z = _mm256_mul_ps(r, r);
+
+    __m256 s, c;
+    __m256 c_base = _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+    if(precision == TRIG_FAST){
+        s = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, z), _mm256_set1_ps(TRIG_FAST_S1)));
+        c = _mm256_add_ps(c_base, _mm256_mul_ps(_mm256_mul_ps(z, z), _mm256_set1_ps(TRIG_FAST_C1)));
+    }
+    else{
+        __m256 ps = _mm256_add_ps(_mm256_set1_ps(TRIG_PRECISE_S2), _mm256_mul_ps(z, _mm256_set1_ps(TRIG_PRECISE_S3)));
+        ps = _mm256_add_ps(_mm256_set1_ps(TRIG_PRECISE_S1), _mm256_mul_ps(z, ps));
+        s = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, z), ps));
+        __m256 pc = _mm256_add_ps(_mm256_set1_ps(TRIG_PRECISE_C2), _mm256_mul_ps(z, _mm256_set1_ps(TRIG_PRECISE_C3)));
+        pc = _mm256_add_ps(_mm256_set1_ps(TRIG_PRECISE_C1), _mm256_mul_ps(z, pc));
+        c = _mm256_add_ps(c_base, _mm256_mul_ps(_mm256_mul_ps(z, z), pc));
+    }
+
+    __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(k, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+    __m256 sin_result = _mm256_blendv_ps(s, c, swap);
+    __m256 cos_result = _mm256_blendv_ps(c, s, swap);
+    __m256 sin_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(k, _mm256_set1_epi32(2)), 30));
+    __m256 cos_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(k, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+    *out_sin = _mm256_xor_ps(sin_result, sin_sign);
+    *out_cos = _mm256_xor_ps(cos_result, cos_sign);
+}
+
+SIMD_TARGET_AVX2 static __m256
+trig_atan2_8(__m256 y, __m256 x, TrigPrecision precision){
+    __m256 sign_bit = _mm256_set1_ps(-0.0f);
+    __m256 ax = _mm256_andnot_ps(sign_bit, x);
+    __m256 ay = _mm256_andnot_ps(sign_bit, y);
+    __m256 mn = _mm256_min_ps(ax, ay);
+    __m256 mx = _mm256_max_ps(_mm256_max_ps(ax, ay), _mm256_set1_ps(FLT_MIN));
+
+    __m256 a;
+    if(precision == TRIG_FAST){
+        __m256 t = _mm256_mul_ps(mn, _mm256_rcp_ps(mx));
+        __m256 z = _mm256_mul_ps(t, t);
+        __m256 p = _mm256_add_ps(_mm256_set1_ps(TRIG_FAST_A1), _mm256_mul_ps(z, _mm256_set1_ps(TRIG_FAST_A2)));
+        p = _mm256_add_ps(_mm256_set1_ps(TRIG_FAST_A0), _mm256_mul_ps(z, p));
+        a = _mm256_mul_ps(t, p);
+    }
+    else{
+        __m256 t = _mm256_div_ps(mn, mx);
+        __m256 z = _mm256_mul_ps(t, t);
+        __m256 p = _mm256_add_ps(_mm256_set1_ps(TRIG_PRECISE_A5), _mm256_mul_ps(z, _mm256_set1_ps(TRIG_PRECISE_A6)));
+        p = _mm256_add_ps(_mm256_set1_ps(TRIG_PRECISE_A4), _mm256_mul_ps(z, p));
+        p = _mm256_add_ps(_mm256_set1_ps(TRIG_PRECISE_A3), _mm256_mul_ps(z, p));
+        p = _mm256_add_ps(_mm256_set1_ps(TRIG_PRECISE_A2), _mm256_mul_ps(z, p));
+        p = _mm256_add_ps(_mm256_set1_ps(TRIG_PRECISE_A1), _mm256_mul_ps(z, p));
+        p = _mm256_add_ps(_mm256_set1_ps(TRIG_PRECISE_A0), _mm256_mul_ps(z, p));
+        a = _mm256_mul_ps(t, p);
+    }
+
+    a = _mm256_blendv_ps(a, _mm256_sub_ps(_mm256_set1_ps(TRIG_PI_2), a), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+    a = _mm256_blendv_ps(a, _mm256_sub_ps(_mm256_set1_ps(TRIG_PI), a), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+    __m256 below = _mm256_and_ps(_mm256_cmp_ps(y, _mm256_setzero_ps(), _CMP_LT_OQ), sign_bit);
+    return(_mm256_xor_ps(a, below));
+}
+
+SIMD_TARGET_AVX2 static ui32
+trig_sincos_array_avx2(TrigPrecision precision, f32 *angles, f32 *out_sin, f32 *out_cos, ui32 count){
+    ui32 i = 0;
+    for(; i + 8 <= count; i += 8){
+        __m256 s, c;
+        trig_sincos_8(_mm256_loadu_ps(angles + i), precision, &s, &c);
+        _mm256_storeu_ps(out_sin + i, s);
+        _mm256_storeu_ps(out_cos + i, c);
+    }
+    _mm256_zeroupper();
+    return(i);
+}
+
+SIMD_TARGET_AVX2 static ui32
+trig_atan2_array_avx2(TrigPrecision precision, f32 *y, f32 *x, f32 *out, ui32 count){
+    ui32 i = 0;
+    for(; i + 8 <= count; i += 8){
+        _mm256_storeu_ps(out + i, trig_atan2_8(_mm256_loadu_ps(y + i), _mm256_loadu_ps(x + i), precision));
+    }
+    _mm256_zeroupper();
+    return(i);
+}
+
+static void
+trig_sincos_array(TrigPrecision precision, f32 *angles, f32 *out_sin, f32 *out_cos, ui32 count){
+    ui32 i = 0;
+    if(simd_level() >= SIMD_AVX2){
+        i = trig_sincos_array_avx2(precision, angles, out_sin, out_cos, count);
+    }
+    for(; i + 4 <= count; i += 4){
+        __m128 s, c;
+        trig_sincos_4(_mm_loadu_ps(angles + i), precision, &s, &c);
+        _mm_storeu_ps(out_sin + i, s);
+        _mm_storeu_ps(out_cos + i, c);
+    }
+    for(; i < count; ++i){
+        trig_sincos(angles[i], precision, out_sin + i, out_cos + i);
+    }
+}
+
+static void
+trig_atan2_array(TrigPrecision precision, f32 *y, f32 *x, f32 *out, ui32 count){
+    ui32 i = 0;
+    if(simd_level() >= SIMD_AVX2){
+        i = trig_atan2_array_avx2(precision, y, x, out, count);
+    }
+    for(; i + 4 <= count; i += 4){
+        _mm_storeu_ps(out + i, trig_atan2_4(_mm_loadu_ps(y + i), _mm_loadu_ps(x + i), precision));
+    }
+    for(; i < count; ++i){
+        out[i] = trig_atan2(y[i], x[i], precision);
+    }
+}
+
+// NOTE: sweeps angles over [-TRIG_MAX_ANGLE, TRIG_MAX_ANGLE] and directions around the circle through every
+// width and compares against libm, returns false when one of them is past its documented bound. scratch
+// needs room for 5 * TRIG_CHECK_COUNT f32s.
+#define TRIG_CHECK_COUNT 4099
+
+static bool
+trig_self_check(f32 *scratch){
+    f32 *angles = scratch;
+    f32 *x = angles + TRIG_CHECK_COUNT;
+    f32 *y = x + TRIG_CHECK_COUNT;
+    f32 *out_a = y + TRIG_CHECK_COUNT;
+    f32 *out_b = out_a + TRIG_CHECK_COUNT;
+
+    bool result = true;
+    for(ui32 precision=TRIG_FAST; precision <= TRIG_PRECISE; ++precision){
+        f32 tolerance = (precision == TRIG_FAST) ? TRIG_FAST_SINCOS_MAX_ERROR : TRIG_PRECISE_SINCOS_MAX_ERROR;
+        f32 bound = (precision == TRIG_FAST) ? TRIG_FAST_ATAN2_MAX_ERROR : TRIG_PRECISE_ATAN2_MAX_ERROR;
+        for(ui32 range=0; range < 2; ++range){
+            // NOTE: first pass over a couple of turns, second pass out to TRIG_MAX_ANGLE to catch the
+            // reduction losing bits
+            f32 limit = range ? TRIG_MAX_ANGLE : 4.0f * TRIG_PI;
+            for(ui32 i=0; i < TRIG_CHECK_COUNT; ++i){
+                f32 t = ((f32)i / (f32)(TRIG_CHECK_COUNT - 1)) * 2.0f - 1.0f;
+                angles[i] = t * limit;
+            }
+            trig_sincos_array((TrigPrecision)precision, angles, out_a, out_b, TRIG_CHECK_COUNT);
+            for(ui32 i=0; i < TRIG_CHECK_COUNT; ++i){
+                f32 s, c;
+                trig_sincos(angles[i], (TrigPrecision)precision, &s, &c);
+                f64 expected_s = sin((f64)angles[i]);
+                f64 expected_c = cos((f64)angles[i]);
+                if(fabs(out_a[i] - expected_s) > tolerance || fabs(out_b[i] - expected_c) > tolerance ||
+                   fabs(s - expected_s) > tolerance || fabs(c - expected_c) > tolerance){
+                    result = false;
+                }
+            }
+        }
+
+        for(ui32 i=0; i < TRIG_CHECK_COUNT; ++i){
+            f32 t = ((f32)i / (f32)(TRIG_CHECK_COUNT - 1)) * 2.0f * TRIG_PI;
+            f32 radius = (i % 3) ? 1.0f + (f32)(i % 97) : 1e-3f;
+            x[i] = radius * (f32)cos(t);
+            y[i] = radius * (f32)sin(t);
+        }
+        x[0] = y[0] = 0.0f;
+        trig_atan2_array((TrigPrecision)precision, y, x, out_a, TRIG_CHECK_COUNT);
+        for(ui32 i=0; i < TRIG_CHECK_COUNT; ++i){
+            f64 expected = atan2((f64)y[i], (f64)x[i]);
+            f64 error = fabs(out_a[i] - expected);
+            f64 scalar_error = fabs(trig_atan2(y[i], x[i], (TrigPrecision)precision) - expected);
+            // NOTE: pi and -pi are the same direction
+            if(error > TRIG_PI){
+                error = fabs(error - 2.0 * TRIG_PI);
+            }
+            if(scalar_error > TRIG_PI){
+                scalar_error = fabs(scalar_error - 2.0 * TRIG_PI);
+            }
+            if(error > bound || scalar_error > bound){
+                result = false;
+            }
+        }
+    }
+
+    return(result);
+}
+
+#define TRIG_H
+#endif
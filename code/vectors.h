@@ -94,7 +94,8 @@ scale2(Vec2 a, f32 s){
 static void
 scale_pts(Vec2 *p, size count, f32 s){
     for(int i=0; i < count; ++i){
-        *p++ = scale2(*p, s);
+        *p = scale2(*p, s);
+        p++;
     }
 }
 
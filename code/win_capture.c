@@ -0,0 +1,234 @@
+#if !defined(WIN_CAPTURE_C)
+
+// NOTE: asynchronous screenshots and frame dumps. Capturing copies the RenderBuffer into a free pool slot
+// (one memcpy) and returns, a background thread encodes it (image_encode.h, format from the file
+// extension: .png, .ppm, anything else is qoi) and writes it with write_entire_file. When every slot is
+// still queued the capture is dropped and counted, the caller never waits.
+//
+//   F3                                     writes build\screenshot_NNNN.png
+//   win_platform.exe -dump                 writes every frame to build\dump\frame_NNNNNN.qoi
+//   win_platform.exe -dump C:\tmp\soak     writes every frame to the given directory
+//
+// The game gets the same thing through GameMemory::capture_frame. Slots are claimed with a compare
+// exchange so more than one thread may capture, e.g. the render and present threads in -pipeline.
+
+#define CAPTURE_SLOT_COUNT 4
+
+typedef enum{CAPTURE_SLOT_FREE, CAPTURE_SLOT_FILLING, CAPTURE_SLOT_READY, CAPTURE_SLOT_WRITING} WIN_CaptureSlotState;
+
+typedef struct WIN_CaptureSlot{
+    LONG volatile state;
+    ui32 *pixels;
+    ui32 width;
+    ui32 height;
+    char filename[MAX_PATH];
+} WIN_CaptureSlot;
+
+typedef struct WIN_Capture{
+    bool enabled;
+    bool volatile quit;
+
+    WIN_CaptureSlot slots[CAPTURE_SLOT_COUNT];
+    int max_width;
+    int max_height;
+    HANDLE free_slots;
+    HANDLE ready_slots;
+    HANDLE thread;
+
+    // NOTE: writer thread only
+    ui8 *encoded;
+    ui64 encoded_size;
+
+    bool dump;
+    char dump_dir[MAX_PATH];
+    ui64 dump_index;
+    LONG volatile screenshot_requested;
+    ui32 screenshot_index;
+    char *root_dir;
+
+    LONG volatile captured;
+    LONG volatile dropped;
+    LONG volatile written;
+    LONG volatile failed;
+} WIN_Capture;
+
+global WIN_Capture capture;
+
+static ImageFormat
+WIN_capture_format(char *filename){
+    if(string_ends_with(filename, ".png")){
+        return(IMAGE_PNG);
+    }
+    if(string_ends_with(filename, ".ppm")){
+        return(IMAGE_PPM);
+    }
+    return(IMAGE_QOI);
+}
+
+static DWORD WINAPI
+WIN_capture_thread(LPVOID parameter){
+    WIN_Capture *capture = (WIN_Capture *)parameter;
+    for(;;){
+        WaitForSingleObject(capture->ready_slots, INFINITE);
+        if(capture->quit){
+            break;
+        }
+
+        // NOTE: exactly one slot per release is READY, order between slots does not matter
+        for(ui32 i=0; i < CAPTURE_SLOT_COUNT; ++i){
+            WIN_CaptureSlot *slot = &capture->slots[i];
+            if(InterlockedCompareExchange(&slot->state, CAPTURE_SLOT_WRITING, CAPTURE_SLOT_READY) == CAPTURE_SLOT_READY){
+                ui32 size = image_encode(WIN_capture_format(slot->filename), capture->encoded, slot->pixels, slot->width, slot->height);
+                if(write_entire_file(slot->filename, capture->encoded, size)){
+                    InterlockedIncrement(&capture->written);
+                }
+                else{
+                    InterlockedIncrement(&capture->failed);
+                }
+                InterlockedExchange(&slot->state, CAPTURE_SLOT_FREE);
+                ReleaseSemaphore(capture->free_slots, 1, 0);
+                break;
+            }
+        }
+    }
+    return(0);
+}
+
+static void
+WIN_init_capture(WIN_Capture *capture, WIN_State *state, char *cmd_line, int width, int height){
+    capture->root_dir = state->root_dir;
+    capture->max_width = width;
+    capture->max_height = height;
+
+    ui64 encoded_size = image_encode_bound(IMAGE_PPM, width, height);
+    for(ui32 format=IMAGE_QOI; format <= IMAGE_PNG; ++format){
+        ui64 bound = image_encode_bound((ImageFormat)format, width, height);
+        encoded_size = (bound > encoded_size) ? bound : encoded_size;
+    }
+    capture->encoded_size = encoded_size;
+
+    ui64 slot_size = (ui64)width * height * sizeof(ui32);
+    ui64 slots_size = slot_size * CAPTURE_SLOT_COUNT;
+    ui8 *memory = (ui8 *)VirtualAlloc(0, (size_t)(slots_size + encoded_size), MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+    if(!memory){
+        // TODO: Logging
+        return;
+    }
+    for(ui32 i=0; i < CAPTURE_SLOT_COUNT; ++i){
+        capture->slots[i].pixels = (ui32 *)(memory + (slot_size * i));
+    }
+    capture->encoded = memory + slots_size;
+
+    capture->free_slots = CreateSemaphoreA(0, CAPTURE_SLOT_COUNT, CAPTURE_SLOT_COUNT, 0);
+    capture->ready_slots = CreateSemaphoreA(0, 0, CAPTURE_SLOT_COUNT + 1, 0);
+    if(capture->free_slots && capture->ready_slots){
+        capture->thread = CreateThread(0, 0, WIN_capture_thread, capture, 0, 0);
+    }
+    capture->enabled = (capture->thread != 0);
+
+    char *dump_arg = strstr(cmd_line, "-dump");
+    if(dump_arg && capture->enabled){
+        char path[MAX_PATH] = {0};
+        dump_arg += string_length("-dump");
+        if(parse_word(&dump_arg, path, sizeof(path)) && path[0] != '-'){
+            snprintf(capture->dump_dir, sizeof(capture->dump_dir), "%s", path);
+        }
+        else{
+            cat_strings(state->root_dir, "build\\dump", capture->dump_dir);
+        }
+        CreateDirectoryA(capture->dump_dir, 0);
+        capture->dump = true;
+        print("capture: dumping every frame to %s\n", capture->dump_dir);
+    }
+}
+
+// NOTE: safe to call from any thread, returns false when the capture was dropped
+static bool
+WIN_capture_buffer(WIN_Capture *capture, RenderBuffer *buffer, char *filename){
+    if(!capture->enabled || buffer->width > capture->max_width || buffer->height > capture->max_height){
+        return(false);
+    }
+    if(WaitForSingleObject(capture->free_slots, 0) != WAIT_OBJECT_0){
+        InterlockedIncrement(&capture->dropped);
+        return(false);
+    }
+
+    // NOTE: the semaphore guarantees a FREE slot for us
+    WIN_CaptureSlot *slot = 0;
+    while(!slot){
+        for(ui32 i=0; i < CAPTURE_SLOT_COUNT; ++i){
+            if(InterlockedCompareExchange(&capture->slots[i].state, CAPTURE_SLOT_FILLING, CAPTURE_SLOT_FREE) == CAPTURE_SLOT_FREE){
+                slot = &capture->slots[i];
+                break;
+            }
+        }
+    }
+
+    TIMED_BLOCK("capture_copy"){
+        slot->width = buffer->width;
+        slot->height = buffer->height;
+        snprintf(slot->filename, sizeof(slot->filename), "%s", filename);
+        if(buffer->pitch == buffer->width * 4){
+            memcpy(slot->pixels, buffer->memory, (size_t)buffer->width * buffer->height * 4);
+        }
+        else{
+            for(int y=0; y < buffer->height; ++y){
+                memcpy(slot->pixels + ((size_t)y * buffer->width), (ui8 *)buffer->memory + ((size_t)y * buffer->pitch), (size_t)buffer->width * 4);
+            }
+        }
+    }
+
+    InterlockedExchange(&slot->state, CAPTURE_SLOT_READY);
+    ReleaseSemaphore(capture->ready_slots, 1, 0);
+    InterlockedIncrement(&capture->captured);
+    return(true);
+}
+
+static CAPTURE_FRAME(capture_frame){
+    return(WIN_capture_buffer(&capture, buffer, filename));
+}
+
+// NOTE: call once per finished frame from the thread that owns buffer, handles -dump and F3
+static void
+WIN_capture_end_frame(WIN_Capture *capture, RenderBuffer *buffer){
+    char filename[MAX_PATH];
+    if(capture->dump){
+        snprintf(filename, sizeof(filename), "%s\\frame_%06llu.qoi", capture->dump_dir, capture->dump_index++);
+        WIN_capture_buffer(capture, buffer, filename);
+    }
+    if(capture->screenshot_requested){
+        capture->screenshot_requested = false;
+        char name[64];
+        snprintf(name, sizeof(name), "build\\screenshot_%04u.png", capture->screenshot_index++);
+        cat_strings(capture->root_dir, name, filename);
+        if(WIN_capture_buffer(capture, buffer, filename)){
+            print("capture: %s\n", filename);
+        }
+    }
+}
+
+static void
+WIN_capture_dump(WIN_Capture *capture){
+    print("capture: %ld captured, %ld written, %ld dropped, %ld failed\n",
+          capture->captured, capture->written, capture->dropped, capture->failed);
+}
+
+static void
+WIN_shutdown_capture(WIN_Capture *capture){
+    if(!capture->enabled){
+        return;
+    }
+
+    // NOTE: let the thread write everything that was captured
+    for(ui32 i=0; i < CAPTURE_SLOT_COUNT; ++i){
+        WaitForSingleObject(capture->free_slots, INFINITE);
+    }
+    capture->enabled = false;
+    capture->quit = true;
+    ReleaseSemaphore(capture->ready_slots, 1, 0);
+    WaitForSingleObject(capture->thread, INFINITE);
+    WIN_capture_dump(capture);
+}
+
+#define WIN_CAPTURE_C
+#endif
@@ -0,0 +1,90 @@
+#if !defined(WIN_FRAME_EXPORT_C)
+
+// NOTE: writer side of the shared memory frame export, see frame_export.h for the layout and protocol.
+// Only the serial loop exports, the pipelined render thread draws into its own slots.
+
+typedef struct WIN_FrameExport{
+    bool enabled;
+    HANDLE mapping;
+    FrameExportHeader *header;
+    ui64 frame_index;
+} WIN_FrameExport;
+
+global WIN_FrameExport frame_export;
+
+static void
+WIN_init_frame_export(WIN_FrameExport *frame_export, int width, int height){
+    ui32 pitch = width * 4;
+    ui32 slot_size = ((pitch * height) + 4095) & ~4095;
+    ui64 total_size = FRAME_EXPORT_HEADER_SIZE + ((ui64)slot_size * FRAME_EXPORT_SLOT_COUNT);
+
+    frame_export->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, (DWORD)(total_size >> 32), (DWORD)(total_size & 0xFFFFFFFF), FRAME_EXPORT_NAME);
+    if(!frame_export->mapping){
+        print("export: could not create %s\n", FRAME_EXPORT_NAME);
+        return;
+    }
+    // NOTE: another instance already exports, writing into its slots would tear every frame it reads
+    if(GetLastError() == ERROR_ALREADY_EXISTS){
+        print("export: %s is already in use by another instance, not exporting\n", FRAME_EXPORT_NAME);
+        CloseHandle(frame_export->mapping);
+        frame_export->mapping = 0;
+        return;
+    }
+
+    frame_export->header = (FrameExportHeader *)MapViewOfFile(frame_export->mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)total_size);
+    if(!frame_export->header){
+        // TODO: Logging
+        CloseHandle(frame_export->mapping);
+        return;
+    }
+
+    FrameExportHeader *header = frame_export->header;
+    ZeroMemory(header, sizeof(*header));
+    header->version = FRAME_EXPORT_VERSION;
+    header->width = width;
+    header->height = height;
+    header->pitch = pitch;
+    header->bytes_per_pixel = 4;
+    header->slot_count = FRAME_EXPORT_SLOT_COUNT;
+    header->slot_size = slot_size;
+    header->header_size = FRAME_EXPORT_HEADER_SIZE;
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    header->qpc_frequency = frequency.QuadPart;
+    // NOTE: magic last, a reader that sees it sees the rest of the header
+    _ReadWriteBarrier();
+    header->magic = FRAME_EXPORT_MAGIC;
+
+    frame_export->enabled = true;
+    print("export: %dx%d frames in %s\n", width, height, FRAME_EXPORT_NAME);
+}
+
+// NOTE: returns the slot the game renders this frame into
+static void *
+WIN_frame_export_begin(WIN_FrameExport *frame_export){
+    FrameExportHeader *header = frame_export->header;
+    FrameExportSlot *slot = &header->slots[frame_export->frame_index % FRAME_EXPORT_SLOT_COUNT];
+    slot->sequence = (2 * frame_export->frame_index) + 1;
+    _ReadWriteBarrier();
+    return(frame_export_pixels(header, (ui32)(frame_export->frame_index % FRAME_EXPORT_SLOT_COUNT)));
+}
+
+static void
+WIN_frame_export_end(WIN_FrameExport *frame_export){
+    FrameExportHeader *header = frame_export->header;
+    FrameExportSlot *slot = &header->slots[frame_export->frame_index % FRAME_EXPORT_SLOT_COUNT];
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    slot->timestamp = now.QuadPart;
+    // NOTE: x64 keeps stores in order, the barriers only stop the compiler from moving them
+    _ReadWriteBarrier();
+    slot->sequence = (2 * frame_export->frame_index) + 2;
+    _ReadWriteBarrier();
+    header->latest_frame = frame_export->frame_index + 1;
+
+    ++frame_export->frame_index;
+}
+
+#define WIN_FRAME_EXPORT_C
+#endif
@@ -0,0 +1,260 @@
+#if !defined(WIN_GOLDEN_C)
+
+// NOTE: headless golden image runner. Every scene the game exports through render_scene is rendered
+// into an offscreen RenderBuffer and compared against data\golden\<scene>.ppm. A missing reference is a
+// failure, new scenes get theirs with -record.
+//
+//   win_platform.exe -golden                   compare every scene, exit code is the number of failures
+//   win_platform.exe -golden -tolerance 2      allow each channel to be off by up to 2
+//   win_platform.exe -golden -record           write every reference from the current output
+//
+// Failures write build\golden\<scene>_actual.ppm and build\golden\<scene>_diff.ppm. After the scenes
+// every check the game exports through run_check runs, each one that does not pass is a failure too.
+
+typedef struct WIN_GoldenResult{
+    ui32 mismatched_pixels;
+    ui32 max_channel_delta;
+} WIN_GoldenResult;
+
+static bool
+WIN_write_ppm(char *filename, RenderBuffer *buffer){
+    bool result = false;
+
+    char header[64];
+    int header_size = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", buffer->width, buffer->height);
+    ui32 file_size = header_size + (buffer->width * buffer->height * 3);
+
+    ui8 *file = (ui8 *)VirtualAlloc(0, file_size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    if(file){
+        CopyMemory(file, header, header_size);
+        ui8 *dest = file + header_size;
+        // NOTE: buffer memory is stored top down already (negative biHeight), same as ppm
+        for(i32 y=0; y < buffer->height; ++y){
+            ui32 *pixel = (ui32 *)((ui8 *)buffer->memory + (y * buffer->pitch));
+            for(i32 x=0; x < buffer->width; ++x){
+                *dest++ = (ui8)((*pixel >> 16) & 0xFF);
+                *dest++ = (ui8)((*pixel >> 8) & 0xFF);
+                *dest++ = (ui8)((*pixel >> 0) & 0xFF);
+                ++pixel;
+            }
+        }
+        result = write_entire_file(filename, file, file_size);
+        VirtualFree(file, 0, MEM_RELEASE);
+    }
+    else{
+        // TODO: Logging
+    }
+
+    return(result);
+}
+
+// NOTE: reads a ppm written by WIN_write_ppm into dest, dest must already have the expected dimensions
+static bool
+WIN_read_ppm(char *filename, RenderBuffer *dest){
+    bool result = false;
+
+    FileData file = read_entire_file(filename);
+    if(file.content){
+        ui32 width = 0;
+        ui32 height = 0;
+        ui32 max_value = 0;
+        char header[64] = {0};
+        CopyMemory(header, file.content, (file.size < sizeof(header) - 1) ? file.size : sizeof(header) - 1);
+
+        char *at = header;
+        bool parsed = (header[0] == 'P' && header[1] == '6');
+        at += 2;
+        parsed = parsed && parse_ui32(&at, &width) && parse_ui32(&at, &height) && parse_ui32(&at, &max_value);
+        ui32 header_size = (ui32)(at - header) + 1; // NOTE: exactly one whitespace after max_value
+
+        if(parsed && width == (ui32)dest->width && height == (ui32)dest->height && max_value == 255 &&
+           file.size >= header_size + (width * height * 3)){
+            ui8 *source = (ui8 *)file.content + header_size;
+            for(i32 y=0; y < dest->height; ++y){
+                ui32 *pixel = (ui32 *)((ui8 *)dest->memory + (y * dest->pitch));
+                for(i32 x=0; x < dest->width; ++x){
+                    *pixel++ = (source[0] << 16 | source[1] << 8 | source[2] << 0);
+                    source += 3;
+                }
+            }
+            result = true;
+        }
+        else{
+            print("golden: %s is not a %dx%d P6 ppm\n", filename, dest->width, dest->height);
+        }
+        free_file_memory(file.content);
+    }
+
+    return(result);
+}
+
+// NOTE: diff is the expected image dimmed to a quarter, with every pixel outside tolerance in red
+static WIN_GoldenResult
+WIN_compare_render_buffers(RenderBuffer *expected, RenderBuffer *actual, RenderBuffer *diff, ui32 tolerance){
+    WIN_GoldenResult result = {0};
+
+    for(i32 y=0; y < actual->height; ++y){
+        ui32 *e = (ui32 *)((ui8 *)expected->memory + (y * expected->pitch));
+        ui32 *a = (ui32 *)((ui8 *)actual->memory + (y * actual->pitch));
+        ui32 *d = (ui32 *)((ui8 *)diff->memory + (y * diff->pitch));
+        for(i32 x=0; x < actual->width; ++x){
+            ui32 max_delta = 0;
+            for(ui32 shift=0; shift <= 16; shift += 8){
+                i32 delta = (i32)((*e >> shift) & 0xFF) - (i32)((*a >> shift) & 0xFF);
+                ui32 abs_delta = (ui32)ABS(delta);
+                if(abs_delta > max_delta){
+                    max_delta = abs_delta;
+                }
+            }
+
+            if(max_delta > result.max_channel_delta){
+                result.max_channel_delta = max_delta;
+            }
+            if(max_delta > tolerance){
+                ++result.mismatched_pixels;
+                *d = 0x00FF0000;
+            }
+            else{
+                *d = (*e >> 2) & 0x003F3F3F;
+            }
+            ++e; ++a; ++d;
+        }
+    }
+
+    return(result);
+}
+
+static RenderBuffer
+WIN_alloc_golden_buffer(int width, int height){
+    RenderBuffer result = {0};
+    result.width = width;
+    result.height = height;
+    result.bytes_per_pixel = 4;
+    result.pitch = result.width * result.bytes_per_pixel;
+    result.memory_size = result.width * result.height * result.bytes_per_pixel;
+    result.memory = VirtualAlloc(0, result.memory_size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    return(result);
+}
+
+static int
+WIN_run_golden(WIN_State *state, WIN_GameCode *gamecode, char *cmd_line){
+    int failures = 0;
+
+    ui32 tolerance = 0;
+    char *tolerance_arg = strstr(cmd_line, "-tolerance");
+    if(tolerance_arg){
+        tolerance_arg += string_length("-tolerance");
+        parse_ui32(&tolerance_arg, &tolerance);
+    }
+    bool record = (strstr(cmd_line, "-record") != 0);
+
+    if(!gamecode->render_scene){
+        print("golden: game.dll does not export render_scene\n");
+        return(1);
+    }
+
+    GameMemory game_memory = {0};
+    game_memory.running = true;
+    game_memory.permanent_storage_size = Megabytes(64);
+    game_memory.temporary_storage_size = Megabytes(64);
+    game_memory.read_entire_file = read_entire_file;
+    game_memory.write_entire_file = write_entire_file;
+    game_memory.free_file_memory = free_file_memory;
+    WIN_init_work_pool(&work_pool);
+    game_memory.parallel_for = work_pool.enabled ? WIN_parallel_for : 0;
+    game_memory.total_size = game_memory.permanent_storage_size + game_memory.temporary_storage_size;
+    game_memory.total_storage = VirtualAlloc(0, (size)game_memory.total_size, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+    game_memory.permanent_storage = game_memory.total_storage;
+    game_memory.temporary_storage = (ui8 *)game_memory.total_storage + game_memory.permanent_storage_size;
+
+    // NOTE: same dimensions as the window so references match what is seen on screen
+    RenderBuffer actual = WIN_alloc_golden_buffer(960, 540);
+    RenderBuffer expected = WIN_alloc_golden_buffer(960, 540);
+    RenderBuffer diff = WIN_alloc_golden_buffer(960, 540);
+    if(!game_memory.total_storage || !actual.memory || !expected.memory || !diff.memory){
+        print("golden: out of memory\n");
+        return(1);
+    }
+
+    char output_dir[256];
+    cat_strings(state->root_dir, "build\\golden", output_dir);
+    CreateDirectoryA(output_dir, 0);
+    cat_strings(state->root_dir, "data\\golden", output_dir);
+    CreateDirectoryA(output_dir, 0);
+
+    SceneInfo info = {0};
+    for(ui32 scene_index=0; gamecode->render_scene(&game_memory, &actual, scene_index, &info); ++scene_index){
+        char relative_path[256];
+        char reference_path[256];
+        char actual_path[256];
+        char diff_path[256];
+        snprintf(relative_path, sizeof(relative_path), "data\\golden\\%s.ppm", info.name);
+        cat_strings(state->root_dir, relative_path, reference_path);
+        snprintf(relative_path, sizeof(relative_path), "build\\golden\\%s_actual.ppm", info.name);
+        cat_strings(state->root_dir, relative_path, actual_path);
+        snprintf(relative_path, sizeof(relative_path), "build\\golden\\%s_diff.ppm", info.name);
+        cat_strings(state->root_dir, relative_path, diff_path);
+
+        bool failed = false;
+        if(info.overdraw_count){
+            print("golden: %s FAILED %u pixels covered by more than one triangle\n", info.name, info.overdraw_count);
+            failed = true;
+        }
+
+        if(record){
+            if(WIN_write_ppm(reference_path, &actual)){
+                print("golden: %s recorded %s\n", info.name, reference_path);
+            }
+            else{
+                print("golden: %s FAILED could not write %s\n", info.name, reference_path);
+                failed = true;
+            }
+        }
+        else if(!WIN_read_ppm(reference_path, &expected)){
+            print("golden: %s FAILED no reference %s, run with -record to create it\n", info.name, reference_path);
+            WIN_write_ppm(actual_path, &actual);
+            failed = true;
+        }
+        else{
+            WIN_GoldenResult compare = WIN_compare_render_buffers(&expected, &actual, &diff, tolerance);
+            if(compare.mismatched_pixels){
+                print("golden: %s FAILED %u pixels differ (max channel delta %u, tolerance %u)\n",
+                      info.name, compare.mismatched_pixels, compare.max_channel_delta, tolerance);
+                WIN_write_ppm(actual_path, &actual);
+                WIN_write_ppm(diff_path, &diff);
+                failed = true;
+            }
+            else if(!failed){
+                print("golden: %s ok\n", info.name);
+            }
+        }
+
+        if(failed){
+            ++failures;
+        }
+    }
+
+    CheckInfo check = {0};
+    if(gamecode->run_check){
+        for(ui32 check_index=0; gamecode->run_check(&game_memory, check_index, &check); ++check_index){
+            if(check.passed){
+                print("golden: check %s ok\n", check.name);
+            }
+            else{
+                print("golden: check %s FAILED\n", check.name);
+                ++failures;
+            }
+        }
+    }
+    else{
+        print("golden: game.dll does not export run_check\n");
+        ++failures;
+    }
+
+    WIN_shutdown_work_pool(&work_pool);
+    print("golden: %d failed\n", failures);
+    return(failures);
+}
+
+#define WIN_GOLDEN_C
+#endif
@@ -0,0 +1,106 @@
+#if !defined(WIN_INPUT_C)
+
+// NOTE: single producer / single consumer ring of timestamped input events.
+//
+// The producer is whoever pumps window messages and polls the controllers, the consumer is the
+// thread that runs the game, once per frame it drains every event up to the frame's cutoff time into
+// Events. Today both are the main thread, but nothing here assumes that.
+//
+// Consecutive EVENT_MOUSEMOTION are coalesced on the producer side: the latest motion is held back in
+// pending_motion and only published once a different event arrives or the producer flushes, so a
+// burst of mouse input costs one slot. When the ring is full new events are dropped and counted, the
+// ring never overwrites events the consumer has not seen. Events that dont fit into Events this frame
+// simply stay in the ring for the next one.
+
+#define INPUT_RING_SIZE 1024 // NOTE: power of 2
+
+typedef struct WIN_InputEvent{
+    ui64 timestamp; // NOTE: QueryPerformanceCounter
+    Event event;
+} WIN_InputEvent;
+
+typedef struct WIN_InputRing{
+    WIN_InputEvent slots[INPUT_RING_SIZE];
+
+    ui64 volatile write_index; // NOTE: written by the producer only
+    ui64 volatile read_index;  // NOTE: written by the consumer only
+
+    // NOTE: producer only
+    WIN_InputEvent pending_motion;
+    bool has_pending_motion;
+    ui64 pushed;
+    ui64 coalesced;
+    ui64 volatile dropped;
+} WIN_InputRing;
+
+static void
+WIN_input_publish(WIN_InputRing *ring, WIN_InputEvent *input){
+    ui64 write_index = ring->write_index;
+    if(write_index - ring->read_index >= INPUT_RING_SIZE){
+        ++ring->dropped;
+        return;
+    }
+
+    ring->slots[write_index & (INPUT_RING_SIZE - 1)] = *input;
+    // NOTE: x64 keeps stores in order, the slot only has to be written before the index as far as the compiler knows
+    _ReadWriteBarrier();
+    ring->write_index = write_index + 1;
+    ++ring->pushed;
+}
+
+// NOTE: producer only, publishes the held back mouse motion
+static void
+WIN_input_flush(WIN_InputRing *ring){
+    if(ring->has_pending_motion){
+        ring->has_pending_motion = false;
+        WIN_input_publish(ring, &ring->pending_motion);
+    }
+}
+
+static void
+WIN_input_push(WIN_InputRing *ring, Event event){
+    WIN_InputEvent input;
+    QueryPerformanceCounter((LARGE_INTEGER *)&input.timestamp);
+    input.event = event;
+
+    if(event.type == EVENT_MOUSEMOTION){
+        if(ring->has_pending_motion){
+            ++ring->coalesced;
+        }
+        ring->pending_motion = input;
+        ring->has_pending_motion = true;
+    }
+    else{
+        WIN_input_flush(ring);
+        WIN_input_publish(ring, &input);
+    }
+}
+
+// NOTE: consumer only, appends every event stamped at or before cutoff that still fits into events
+static void
+WIN_input_drain(WIN_InputRing *ring, Events *events, ui64 cutoff){
+    ui64 read_index = ring->read_index;
+    ui64 write_index = ring->write_index;
+    _ReadWriteBarrier();
+
+    while(read_index < write_index && events->index < array_count(events->event)){
+        WIN_InputEvent *input = &ring->slots[read_index & (INPUT_RING_SIZE - 1)];
+        if(input->timestamp > cutoff){
+            break;
+        }
+        events->event[events->index++] = input->event;
+        ++read_index;
+    }
+
+    _ReadWriteBarrier();
+    ring->read_index = read_index;
+}
+
+static void
+WIN_input_dump(WIN_InputRing *ring){
+    print("input: %llu events, %llu mouse motions coalesced, %llu dropped on overflow\n",
+          ring->pushed, ring->coalesced, ring->dropped);
+}
+
+#define WIN_INPUT_C
+#endif
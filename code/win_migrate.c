@@ -0,0 +1,106 @@
+#if !defined(WIN_MIGRATE_C)
+
+// NOTE: GameState migration across hot reloads. Before the old dll goes away its game_state_layout and the
+// GameState bytes are copied out, once the new dll is in and reports a different layout hash the
+// GameState region of permanent_storage is rebuilt in place: fields whose name, type and size still
+// match are copied over (ARENA fields also need the same target_size and GAME_STATE_VERSION), everything
+// else starts out zero, then the new dll's migrate_game_state gets to convert what is left. The arena
+// past GAME_STATE_RESERVE is never touched.
+//
+// Without game_state_layout on either side, or before the game initialized, nothing happens, same as before.
+
+#define MIGRATION_MAX_FIELDS 256
+
+typedef struct WIN_Migration{
+    bool active;
+    GameStateLayout old_layout; // NOTE: fields points at old_fields
+    GameStateField old_fields[MIGRATION_MAX_FIELDS];
+    void *old_state;
+    ui64 old_state_capacity;
+} WIN_Migration;
+
+global WIN_Migration migration;
+
+// NOTE: call while the old gamecode is still loaded
+static void
+WIN_begin_migration(WIN_Migration *migration, WIN_GameCode *gamecode, GameMemory *game_memory){
+    migration->active = false;
+    if(!game_memory->initialized || !gamecode->game_state_layout){
+        return;
+    }
+
+    GameStateLayout layout = gamecode->game_state_layout();
+    if(layout.field_count > MIGRATION_MAX_FIELDS || layout.size > GAME_STATE_RESERVE){
+        // TODO: Logging
+        return;
+    }
+
+    if(layout.size > migration->old_state_capacity){
+        if(migration->old_state){
+            VirtualFree(migration->old_state, 0, MEM_RELEASE);
+        }
+        migration->old_state_capacity = layout.size;
+        migration->old_state = VirtualAlloc(0, (size_t)migration->old_state_capacity, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+        if(!migration->old_state){
+            // TODO: Logging
+            migration->old_state_capacity = 0;
+            return;
+        }
+    }
+
+    migration->old_layout = layout;
+    migration->old_layout.fields = migration->old_fields;
+    CopyMemory(migration->old_fields, layout.fields, sizeof(GameStateField) * layout.field_count);
+    CopyMemory(migration->old_state, game_memory->permanent_storage, layout.size);
+    migration->active = true;
+}
+
+// NOTE: call once the new gamecode is loaded, before it runs
+static void
+WIN_end_migration(WIN_Migration *migration, WIN_GameCode *gamecode, GameMemory *game_memory){
+    if(!migration->active){
+        return;
+    }
+    migration->active = false;
+
+    if(!gamecode->game_state_layout){
+        print("reload: game.dll has no game_state_layout, GameState kept as is\n");
+        return;
+    }
+
+    GameStateLayout layout = gamecode->game_state_layout();
+    if(layout.hash == migration->old_layout.hash){
+        return;
+    }
+    if(layout.size > GAME_STATE_RESERVE){
+        print("reload: GameState needs %u bytes, only %u are reserved in front of the arena\n", layout.size, (ui32)GAME_STATE_RESERVE);
+        return;
+    }
+
+    TIMED_BLOCK("migrate_game_state"){
+        ui8 *state = (ui8 *)game_memory->permanent_storage;
+        ui8 *old_state = (ui8 *)migration->old_state;
+        ZeroMemory(state, layout.size);
+
+        ui32 carried = 0;
+        for(ui32 i=0; i < layout.field_count; ++i){
+            GameStateField *field = &layout.fields[i];
+            GameStateField *old_field = game_state_field(&migration->old_layout, field->name);
+            bool arena_ok = (old_field && old_field->target_size == field->target_size &&
+                             (!field->target_size || migration->old_layout.version == layout.version));
+            if(arena_ok && old_field->size == field->size && string_equal(old_field->type, field->type)){
+                CopyMemory(state + field->offset, old_state + old_field->offset, field->size);
+                ++carried;
+            }
+        }
+
+        if(gamecode->migrate_game_state){
+            gamecode->migrate_game_state(game_memory, &migration->old_layout, migration->old_state);
+        }
+        print("reload: GameState layout changed, %u of %u fields carried over (%u -> %u bytes)\n",
+              carried, layout.field_count, migration->old_layout.size, layout.size);
+    }
+}
+
+#define WIN_MIGRATE_C
+#endif
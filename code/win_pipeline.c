@@ -0,0 +1,185 @@
+#if !defined(WIN_PIPELINE_C)
+
+// NOTE: pipelined mode (win_platform.exe -pipeline). The main thread simulates frame N+1 while the render
+// thread rasterizes frame N and the present thread blits frame N-1.
+//
+// Every slot is owned by exactly one stage at a time and moves through the stages in order:
+//
+//   free_slots -> simulate (main) -> simulated_slots -> render -> rendered_slots -> present -> free_slots
+//
+// A stage only ever touches the slot it took off its semaphore, so a RenderBuffer is never read while
+// it is being written. Each stage walks the slots round robin with its own index, which keeps the
+// frames in order without a queue.
+//
+// The render thread draws from the GameFrame the simulation wrote into the slot with its own scratch as
+// temporary_storage. GameFrame.particles still points into game storage, the game keeps what a GameFrame
+// points at for GAME_FRAMES_IN_FLIGHT simulates, so there can't be more slots than that. Anything else that
+// writes game storage (reloads, starting a recording or a playback, looping it) drains the pipeline first.
+
+#define PIPELINE_SLOT_COUNT GAME_FRAMES_IN_FLIGHT
+
+typedef struct WIN_PipelineSlot{
+    WIN_RenderBuffer buffer;
+    GameFrame frame;
+} WIN_PipelineSlot;
+
+typedef struct WIN_Pipeline{
+    bool enabled;
+    bool volatile quit;
+
+    WIN_PipelineSlot slots[PIPELINE_SLOT_COUNT];
+    HANDLE free_slots;
+    HANDLE simulated_slots;
+    HANDLE rendered_slots;
+
+    // NOTE: each only touched by its own stage
+    ui32 simulate_index;
+    ui32 render_index;
+    ui32 present_index;
+
+    HANDLE render_thread;
+    HANDLE present_thread;
+    HWND window;
+    WIN_GameCode *gamecode;
+    GameMemory render_memory;
+} WIN_Pipeline;
+
+global WIN_Pipeline pipeline;
+
+static RenderBuffer
+WIN_game_render_buffer(WIN_RenderBuffer *buffer){
+    RenderBuffer result = {0};
+    result.memory = buffer->memory;
+    result.memory_size = buffer->memory_size;
+    result.bytes_per_pixel = buffer->bytes_per_pixel;
+    result.width = buffer->width;
+    result.height = buffer->height;
+    result.pitch = buffer->pitch;
+    return(result);
+}
+
+static DWORD WINAPI
+WIN_render_thread(LPVOID parameter){
+    WIN_Pipeline *pipeline = (WIN_Pipeline *)parameter;
+
+    for(;;){
+        WaitForSingleObject(pipeline->simulated_slots, INFINITE);
+        if(pipeline->quit){
+            break;
+        }
+
+        WIN_PipelineSlot *slot = &pipeline->slots[pipeline->render_index++ % PIPELINE_SLOT_COUNT];
+        TIMED_BLOCK("render_game"){
+            RenderBuffer render_buffer = WIN_game_render_buffer(&slot->buffer);
+            if(pipeline->gamecode->render_game){
+                pipeline->gamecode->render_game(&pipeline->render_memory, &render_buffer, &slot->frame);
+            }
+        }
+        ReleaseSemaphore(pipeline->rendered_slots, 1, 0);
+    }
+
+    return(0);
+}
+
+static DWORD WINAPI
+WIN_present_thread(LPVOID parameter){
+    WIN_Pipeline *pipeline = (WIN_Pipeline *)parameter;
+    HDC DC = GetDC(pipeline->window);
+
+    for(;;){
+        WaitForSingleObject(pipeline->rendered_slots, INFINITE);
+        if(pipeline->quit){
+            break;
+        }
+
+        WIN_PipelineSlot *slot = &pipeline->slots[pipeline->present_index++ % PIPELINE_SLOT_COUNT];
+        RenderBuffer render_buffer = WIN_game_render_buffer(&slot->buffer);
+        WIN_video_capture(&video, &render_buffer);
+        WIN_capture_end_frame(&capture, &render_buffer);
+        TIMED_BLOCK("present"){
+            WIN_WindowDimensions wd = WIN_get_window_dimensions(pipeline->window);
+            WIN_update_window(slot->buffer, DC, wd.width, wd.height);
+        }
+        ReleaseSemaphore(pipeline->free_slots, 1, 0);
+    }
+
+    ReleaseDC(pipeline->window, DC);
+    return(0);
+}
+
+static void
+WIN_init_pipeline(WIN_Pipeline *pipeline, HWND window, WIN_GameCode *gamecode, GameMemory *game_memory, int width, int height){
+    pipeline->window = window;
+    pipeline->gamecode = gamecode;
+
+    // NOTE: same memory the game sees minus the storage, rendering must not read or write game state
+    pipeline->render_memory = *game_memory;
+    pipeline->render_memory.total_storage = 0;
+    pipeline->render_memory.permanent_storage = 0;
+    pipeline->render_memory.temporary_storage_size = Megabytes(16);
+    pipeline->render_memory.temporary_storage = VirtualAlloc(0, (size_t)pipeline->render_memory.temporary_storage_size, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+    if(!pipeline->render_memory.temporary_storage){
+        // TODO: Logging
+        return;
+    }
+
+    for(ui32 i=0; i < PIPELINE_SLOT_COUNT; ++i){
+        WIN_init_render_buffer(&pipeline->slots[i].buffer, width, height);
+        if(!pipeline->slots[i].buffer.memory){
+            // TODO: Logging
+            return;
+        }
+    }
+
+    pipeline->free_slots = CreateSemaphoreA(0, PIPELINE_SLOT_COUNT, PIPELINE_SLOT_COUNT, 0);
+    pipeline->simulated_slots = CreateSemaphoreA(0, 0, PIPELINE_SLOT_COUNT, 0);
+    pipeline->rendered_slots = CreateSemaphoreA(0, 0, PIPELINE_SLOT_COUNT, 0);
+    if(pipeline->free_slots && pipeline->simulated_slots && pipeline->rendered_slots){
+        pipeline->render_thread = CreateThread(0, 0, WIN_render_thread, pipeline, 0, 0);
+        pipeline->present_thread = CreateThread(0, 0, WIN_present_thread, pipeline, 0, 0);
+        pipeline->enabled = (pipeline->render_thread && pipeline->present_thread);
+    }
+    if(!pipeline->enabled){
+        // TODO: Logging, falls back to the serial loop
+    }
+}
+
+// NOTE: main thread only, blocks until the present thread hands back a slot
+static WIN_PipelineSlot *
+WIN_pipeline_begin_simulate(WIN_Pipeline *pipeline){
+    WaitForSingleObject(pipeline->free_slots, INFINITE);
+    return(&pipeline->slots[pipeline->simulate_index % PIPELINE_SLOT_COUNT]);
+}
+
+static void
+WIN_pipeline_end_simulate(WIN_Pipeline *pipeline){
+    ++pipeline->simulate_index;
+    ReleaseSemaphore(pipeline->simulated_slots, 1, 0);
+}
+
+// NOTE: main thread only, waits until every slot is back in free_slots, call before the game dll goes away
+static void
+WIN_pipeline_drain(WIN_Pipeline *pipeline){
+    if(pipeline->enabled){
+        for(ui32 i=0; i < PIPELINE_SLOT_COUNT; ++i){
+            WaitForSingleObject(pipeline->free_slots, INFINITE);
+        }
+        ReleaseSemaphore(pipeline->free_slots, PIPELINE_SLOT_COUNT, 0);
+    }
+}
+
+static void
+WIN_shutdown_pipeline(WIN_Pipeline *pipeline){
+    if(pipeline->enabled){
+        WIN_pipeline_drain(pipeline);
+        pipeline->quit = true;
+        ReleaseSemaphore(pipeline->simulated_slots, 1, 0);
+        ReleaseSemaphore(pipeline->rendered_slots, 1, 0);
+        HANDLE threads[2] = {pipeline->render_thread, pipeline->present_thread};
+        WaitForMultipleObjects(2, threads, TRUE, INFINITE);
+        pipeline->enabled = false;
+    }
+}
+
+#define WIN_PIPELINE_C
+#endif
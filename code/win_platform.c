@@ -113,13 +113,19 @@ FUTURE TODO: Game dev stuff to accomplish
     scene manager
 */
 
+#define PROFILE_MODULE 1
 #include "game.h"
 
 #include <windows.h>
 #include <windowsx.h>
 #include <xinput.h>
 #include <stdio.h>
+#include <string.h>
 
+#include "frame_pacer.h"
+#include "frame_export.h"
+#include "yuv.h"
+#include "image_encode.h"
 #include "win_platform.h"
 
 
@@ -137,12 +143,15 @@ FUTURE TODO: Game dev stuff to accomplish
 //}
 
 
+#include "win_input.c"
+
 // TODO: re-organize this
 global bool global_pause;
 global int global_running;
 global WIN_Clock clock;
 global WIN_RenderBuffer offscreen_render_buffer;
 global Events events;
+global WIN_InputRing input_ring;
 
 global ui32 eventkey_mapping[0xFF] = {
     [VK_ESCAPE]=KEY_ESCAPE,
@@ -155,6 +164,11 @@ global ui32 eventkey_mapping[0xFF] = {
     ['1']=KEY_1,
     ['2']=KEY_2,
     ['3']=KEY_3,
+    ['4']=KEY_4,
+    ['5']=KEY_5,
+    [VK_F1]=KEY_F1,
+    [VK_F2]=KEY_F2,
+    [VK_F3]=KEY_F3,
 };
 
 global ui32 eventpad_mapping[0x5838] = {
@@ -214,11 +228,23 @@ WIN_load_gamecode(char *source_dll, char *copy_dll){
     result.gamecode_dll = LoadLibraryA(copy_dll);
     if(result.gamecode_dll){
         result.main_game_loop = (MainGameLoop *)GetProcAddress(result.gamecode_dll, "main_game_loop");
+        result.simulate_game = (SimulateGame *)GetProcAddress(result.gamecode_dll, "simulate_game");
+        result.render_game = (RenderGame *)GetProcAddress(result.gamecode_dll, "render_game");
+        result.render_scene = (RenderScene *)GetProcAddress(result.gamecode_dll, "render_scene");
+        result.run_check = (RunCheck *)GetProcAddress(result.gamecode_dll, "run_check");
+        result.game_state_layout = (GameStateLayoutFunction *)GetProcAddress(result.gamecode_dll, "game_state_layout");
+        result.migrate_game_state = (MigrateGameState *)GetProcAddress(result.gamecode_dll, "migrate_game_state");
         result.is_valid = result.main_game_loop && 1;
     }
 
     if(!result.is_valid){
         result.main_game_loop = 0;
+        result.simulate_game = 0;
+        result.render_game = 0;
+        result.render_scene = 0;
+        result.run_check = 0;
+        result.game_state_layout = 0;
+        result.migrate_game_state = 0;
     }
 
     return(result);
@@ -233,6 +259,12 @@ WIN_unload_gamecode(WIN_GameCode *gamecode){
 
     gamecode->is_valid = false;
     gamecode->main_game_loop = 0;
+    gamecode->simulate_game = 0;
+    gamecode->render_game = 0;
+    gamecode->render_scene = 0;
+    gamecode->run_check = 0;
+    gamecode->game_state_layout = 0;
+    gamecode->migrate_game_state = 0;
 }
 
 static void
@@ -390,6 +422,19 @@ WIN_update_window(WIN_RenderBuffer buffer, HDC DC, int width, int height){
                   buffer.memory, &buffer.info, DIB_RGB_COLORS, SRCCOPY);
 }
 
+static void
+WIN_init_root_dir(WIN_State *state){
+    char exe_path[MAX_PATH];
+    GetModuleFileNameA(0, exe_path, sizeof(exe_path));
+    char *starting_point = string_point_at_last(exe_path, '\\', 2);
+    // QUESTION: I dont understand this
+    state->root_dir_length = starting_point - exe_path;
+    get_root_dir(state->root_dir, state->root_dir_length, exe_path);
+}
+
+#include "win_work.c"
+#include "win_golden.c"
+
 static void
 WIN_process_controller_input(void){
     for(ui32 i=0; i < XUSER_MAX_COUNT; ++i){
@@ -403,7 +448,7 @@ WIN_process_controller_input(void){
                 e.type = EVENT_PADUP;
             }
             e.pad = eventpad_mapping[controller_state.VirtualKey];
-            events.event[events.index++] = e;
+            WIN_input_push(&input_ring, e);
         }
 
         // INCOMPLETE: I kind of like using GetState more than GetKeyStroke
@@ -422,78 +467,192 @@ WIN_process_controller_input(void){
     }
 }
 
+#include "win_snapshot.c"
+#include "win_recording.c"
+
+static bool
+WIN_alloc_input_streams(WIN_State *state){
+    if(!state->input_stream){
+        state->input_stream = (WIN_InputStream *)VirtualAlloc(0, sizeof(WIN_InputStream) * 2, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+        if(state->input_stream){
+            state->keyframe_stream = state->input_stream + 1;
+        }
+    }
+    return(state->input_stream != 0);
+}
+
+static void
+WIN_recording_path(WIN_State *state, int index, char *extension, char *full_path){
+    char recording_string[64];
+    wsprintf(recording_string, "build\\recording_%d.%s", index, extension);
+    cat_strings(state->root_dir, recording_string, full_path);
+}
+
+static WIN_KeyframeFileHeader
+WIN_keyframe_file_header(WIN_State *state, WIN_GameCode *gamecode){
+    WIN_KeyframeFileHeader result;
+    ZeroMemory(&result, sizeof(result));
+    if(gamecode->game_state_layout){
+        result.layout_hash = gamecode->game_state_layout().hash;
+    }
+    result.storage_base = (ui64)state->page_watch.base;
+    result.storage_size = state->page_watch.size;
+    result.run_id = state->run_id;
+    result.fixed_base = state->fixed_base;
+    return(result);
+}
+
+// NOTE: returns false when the keyframes in the file would not restore into the current GameState
+static bool
+WIN_check_keyframe_file(WIN_State *state, WIN_GameCode *gamecode, WIN_KeyframeFileHeader *recorded){
+    WIN_KeyframeFileHeader current = WIN_keyframe_file_header(state, gamecode);
+
+    if(recorded->layout_hash != current.layout_hash){
+        print("replay: recording_%d has GameState layout %016llx, game.dll has %016llx, keyframes not restored\n",
+              state->playback_index, recorded->layout_hash, current.layout_hash);
+        return(false);
+    }
+    if(recorded->run_id != current.run_id){
+        if(!recorded->fixed_base || !current.fixed_base){
+            print("replay: recording_%d is from an earlier run and total_storage has no fixed address, keyframes not restored\n",
+                  state->playback_index);
+            return(false);
+        }
+        if(recorded->storage_base != current.storage_base || recorded->storage_size != current.storage_size){
+            print("replay: recording_%d has total_storage at %llx size %llu, now at %llx size %llu, keyframes not restored\n",
+                  state->playback_index, recorded->storage_base, recorded->storage_size, current.storage_base, current.storage_size);
+            return(false);
+        }
+    }
+    return(true);
+}
+
 static void 
-WIN_init_recording_handle(WIN_State *state, GameMemory *game_memory, int recording_index){
-    //Assert((ui64)recording_index < array_count(state->replay_buffers));
-    // CONSIDER: maybe do this in the future of it ends up slowing down
-    //WIN_ReplayBuffer *replay_buffer = &state->replay_buffers[recording_index];
-    //if(replay_buffer->memory){
-    if(state->replay_buffers[recording_index]){
+WIN_init_recording_handle(WIN_State *state, GameMemory *game_memory, WIN_GameCode *gamecode, int recording_index){
+    Assert((ui64)recording_index < array_count(state->replay_buffers));
+    if(state->replay_buffers[recording_index].memory && WIN_alloc_input_streams(state)){
         state->recording_index = recording_index;
-        char recording_string[64];
-        wsprintf(recording_string, "build\\recording_%d.out", recording_index);
         char full_path[256];
-        cat_strings(state->root_dir, recording_string, full_path);
+        WIN_recording_path(state, recording_index, "out", full_path);
         state->recording_handle = CreateFileA(full_path, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
-        //state->recording_handle = replay_buffer->file_handle;
+        WIN_begin_input_stream(state->input_stream, state->recording_handle, 0);
+        WIN_write_stream_header(state->input_stream, RECORDING_MAGIC, RECORDING_VERSION, 0);
 
-        CopyMemory(state->replay_buffers[recording_index], game_memory->permanent_storage, game_memory->total_size);
+        WIN_recording_path(state, recording_index, "keys", full_path);
+        state->keyframe_handle = CreateFileA(full_path, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+        WIN_begin_input_stream(state->keyframe_stream, state->keyframe_handle, 0);
+        WIN_write_stream_header(state->keyframe_stream, KEYFRAME_MAGIC, KEYFRAME_VERSION, (ui32)state->page_watch.page_size);
+        WIN_KeyframeFileHeader file_header = WIN_keyframe_file_header(state, gamecode);
+        WIN_stream_write(state->keyframe_stream, &file_header, sizeof(file_header));
+
+        WIN_snapshot_game_memory(state, recording_index);
     }
 }
 
 static void
 WIN_release_recording_handle(WIN_State *state){
+    WIN_stream_flush(state->input_stream);
+    WIN_stream_flush(state->keyframe_stream);
     CloseHandle(state->recording_handle);
+    CloseHandle(state->keyframe_handle);
     state->recording_index = 0;
 }
 
 
 static void
 WIN_record_input(WIN_State *state, Events *events){
-    DWORD bytes_written;
-    WriteFile(state->recording_handle, events, sizeof(*events), &bytes_written, 0);
+    if(state->page_watch.touched && (state->input_stream->frame_index % RECORDING_KEYFRAME_INTERVAL) == 0){
+        WIN_write_keyframe(state, state->input_stream);
+    }
+    WIN_write_input_frame(state->input_stream, events);
+}
+
+// NOTE: restores the keyframe at or before frame_index and moves the input stream to it, returns the
+// frame it landed on or -1 without a usable keyframe
+static i64
+WIN_seek_keyframe(WIN_State *state, GameMemory *game_memory, WIN_GameCode *gamecode, ui64 frame_index){
+    i64 result = -1;
+
+    LARGE_INTEGER start = {0};
+    SetFilePointerEx(state->keyframe_handle, start, 0, FILE_BEGIN);
+    WIN_begin_input_stream(state->keyframe_stream, state->keyframe_handle, 0);
+
+    if(!WIN_read_stream_header(state->keyframe_stream, KEYFRAME_MAGIC, KEYFRAME_VERSION, (ui32)state->page_watch.page_size)){
+        print("replay: recording_%d.keys is missing or from an older build\n", state->playback_index);
+        return(result);
+    }
+    WIN_KeyframeFileHeader file_header;
+    if(!WIN_stream_read(state->keyframe_stream, &file_header, sizeof(file_header)) ||
+       !WIN_check_keyframe_file(state, gamecode, &file_header)){
+        return(result);
+    }
+
+    WIN_KeyframeHeader keyframe;
+    if(WIN_apply_keyframes(state, frame_index, &keyframe)){
+        LARGE_INTEGER offset;
+        offset.QuadPart = (LONGLONG)keyframe.input_offset;
+        SetFilePointerEx(state->playback_handle, offset, 0, FILE_BEGIN);
+        WIN_begin_input_stream(state->input_stream, state->playback_handle, keyframe.input_offset);
+        state->input_stream->frame_index = keyframe.frame_index;
+        state->input_stream->previous = keyframe.previous;
+
+        // NOTE: the keyframes come from a game that was already running, dont let it initialize over them
+        game_memory->initialized = true;
+        result = (i64)keyframe.frame_index;
+    }
+
+    return(result);
 }
 
 static void
-WIN_init_playback_handle(WIN_State *state, GameMemory *game_memory, int playback_index){
-    //Assert(playback_index < array_count(state->replay_buffers));
-    // CONSIDER: maybe do this in the future of it ends up slowing down
-    //WIN_ReplayBuffer *replay_buffer = &state->replay_buffers[playback_index];
-    //if(replay_buffer->memory){
-    if(state->replay_buffers[playback_index]){
+WIN_init_playback_handle(WIN_State *state, GameMemory *game_memory, WIN_GameCode *gamecode, int playback_index){
+    Assert((ui64)playback_index < array_count(state->replay_buffers));
+    if(state->replay_buffers[playback_index].memory && WIN_alloc_input_streams(state)){
         state->playback_index = playback_index;
-        //state->playback_handle = replay_buffer->file_handle;
 
-        char recording_string[64];
-        wsprintf(recording_string, "build\\recording_%d.out", playback_index);
         char full_path[256];
-        cat_strings(state->root_dir, recording_string, full_path);
+        WIN_recording_path(state, playback_index, "out", full_path);
         state->playback_handle = CreateFileA(full_path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+        WIN_recording_path(state, playback_index, "keys", full_path);
+        state->keyframe_handle = CreateFileA(full_path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
 
-        CopyMemory(game_memory->permanent_storage, state->replay_buffers[playback_index], game_memory->total_size);
+        WIN_begin_input_stream(state->input_stream, state->playback_handle, 0);
+        if(!WIN_read_stream_header(state->input_stream, RECORDING_MAGIC, RECORDING_VERSION, 0)){
+            print("replay: recording_%d.out is missing or from an older build\n", playback_index);
+        }
+
+        // NOTE: a recording from an earlier run has no snapshot in memory, start from its first keyframe
+        if(state->replay_buffers[playback_index].has_snapshot){
+            WIN_restore_game_memory(state, playback_index);
+        }
+        else if(WIN_seek_keyframe(state, game_memory, gamecode, 0) < 0){
+            print("replay: recording_%d has no usable keyframes, playing back from the current state\n", playback_index);
+        }
     }
 }
 
 static void
 WIN_release_playback_handle(WIN_State *state){
     CloseHandle(state->playback_handle);
+    CloseHandle(state->keyframe_handle);
     state->playback_index = 0;
 }
 
+// NOTE: returns false at the end of the recording, WIN_loop_playback goes back to its beginning
+static bool
+WIN_play_input(WIN_State *state, Events *events){
+    return(WIN_read_input_frame(state->input_stream, events));
+}
+
+// NOTE: rewinds game memory to the start of the recording, nothing may still be reading it
 static void
-WIN_play_input(WIN_State *state, GameMemory *game_memory, Events *events){
-    DWORD bytes_read;
-    if(ReadFile(state->playback_handle, events, sizeof(*events), &bytes_read, 0)){
-        if(bytes_read == 0){
-            // NOTE: We've hit the end of the stream, go back to the beginning
-            int playback_index = state->playback_index;
-            WIN_release_playback_handle(state);
-            WIN_init_playback_handle(state, game_memory, playback_index);
-            ReadFile(state->playback_handle, events, sizeof(*events), &bytes_read, 0);
-        }
-    }
-    else{
-        // TODO: Loggin
+WIN_loop_playback(WIN_State *state, GameMemory *game_memory, WIN_GameCode *gamecode, Events *events){
+    int playback_index = state->playback_index;
+    WIN_release_playback_handle(state);
+    WIN_init_playback_handle(state, game_memory, gamecode, playback_index);
+    if(!WIN_read_input_frame(state->input_stream, events)){
+        // NOTE: empty recording
+        events->index = 0;
     }
 }
 
@@ -505,42 +664,116 @@ WIN_get_clock(void){
     return(result);
 }
 
-static f32
+static f64
 WIN_get_seconds_elapsed(LARGE_INTEGER start, LARGE_INTEGER end){
-    f32 result;
-    result = ((f32)(end.QuadPart - start.QuadPart) / ((f32)clock.frequency.QuadPart));
+    f64 result;
+    result = ((f64)(end.QuadPart - start.QuadPart) / ((f64)clock.frequency.QuadPart));
 
     return(result);
 }
 
+#if !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// NOTE: high resolution waitable timers (Windows 10 1803+) wake within tens of microseconds, otherwise
+// fall back to Sleep at whatever granularity timeBeginPeriod gave us
 static void
-WIN_sync_framerate(void){
-    LARGE_INTEGER time_stamp = WIN_get_clock();
-    f32 seconds_elapsed = WIN_get_seconds_elapsed(clock.start, time_stamp);
-    if(seconds_elapsed < clock.target_seconds_per_frame){
-        if(clock.sleep_granularity_set){
-            DWORD sleep_ms = (DWORD)(1000.0f * (clock.target_seconds_per_frame - seconds_elapsed));
-            if(sleep_ms > 0){
-                Sleep(sleep_ms);
-            }
+WIN_init_frame_pacer(void){
+    clock.sleep_timer = CreateWaitableTimerExW(0, 0, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+
+    // NOTE: start pessimistic, a whole timer tick, the calibration pulls it down within a second
+    f64 initial_margin = clock.sleep_timer ? 0.0005 : 0.002;
+    frame_pacer_init(&clock.pacer, clock.target_seconds_per_frame, initial_margin);
+}
+
+static void
+WIN_sleep_seconds(f64 seconds){
+    if(clock.sleep_timer){
+        LARGE_INTEGER due_time;
+        due_time.QuadPart = -(LONGLONG)(seconds * 10000000.0); // NOTE: negative is relative, in 100ns units
+        if(due_time.QuadPart < 0 && SetWaitableTimer(clock.sleep_timer, &due_time, 0, 0, 0, FALSE)){
+            WaitForSingleObject(clock.sleep_timer, INFINITE);
         }
+    }
+    else if(clock.sleep_granularity_set){
+        DWORD sleep_ms = (DWORD)(1000.0 * seconds);
+        if(sleep_ms > 0){
+            Sleep(sleep_ms);
+        }
+    }
+}
 
-        f32 seconds_elapsed_remaining = WIN_get_seconds_elapsed(clock.start, WIN_get_clock());
-        if(seconds_elapsed_remaining < clock.target_seconds_per_frame){
-            // TODO: LOG MISSED SLEEP HERE
+static void
+WIN_sync_framerate(void){
+    f64 target = clock.target_seconds_per_frame;
+    LARGE_INTEGER time_stamp = WIN_get_clock();
+    f64 seconds_elapsed = WIN_get_seconds_elapsed(clock.start, time_stamp);
+    bool missed_frame = (seconds_elapsed >= target);
+
+    if(!missed_frame){
+        f64 seconds_remaining = target - seconds_elapsed;
+        f64 sleep_seconds = frame_pacer_sleep_seconds(&clock.pacer, seconds_remaining);
+        if(sleep_seconds > 0.0){
+            WIN_sleep_seconds(sleep_seconds);
+            LARGE_INTEGER woke = WIN_get_clock();
+            frame_pacer_record_wake(&clock.pacer, sleep_seconds, WIN_get_seconds_elapsed(time_stamp, woke), seconds_remaining);
+            time_stamp = woke;
         }
 
+        LARGE_INTEGER spin_start = time_stamp;
         seconds_elapsed = WIN_get_seconds_elapsed(clock.start, time_stamp);
-        while(seconds_elapsed < clock.target_seconds_per_frame){
-            seconds_elapsed = WIN_get_seconds_elapsed(clock.start, WIN_get_clock());
+        while(seconds_elapsed < target){
+            _mm_pause();
+            time_stamp = WIN_get_clock();
+            seconds_elapsed = WIN_get_seconds_elapsed(clock.start, time_stamp);
         }
+        frame_pacer_record_spin(&clock.pacer, WIN_get_seconds_elapsed(spin_start, time_stamp));
     }
-    else{
-        // TODO: MISSED FRAME RATE!
-        // TODO: Logging
+
+    frame_pacer_record_frame(&clock.pacer, seconds_elapsed, missed_frame);
+}
+
+// NOTE: playback only, jumps to frame_index by restoring the keyframe before it and running the game
+// with rendering disabled up to it
+static void
+WIN_seek_playback(WIN_State *state, GameMemory *game_memory, WIN_GameCode *gamecode, RenderBuffer *render_buffer, ui64 frame_index){
+    LARGE_INTEGER start = WIN_get_clock();
+
+    i64 keyframe_index = WIN_seek_keyframe(state, game_memory, gamecode, frame_index);
+    if(keyframe_index < 0){
+        print("replay: recording_%d has no keyframes, cannot seek\n", state->playback_index);
+        return;
+    }
+
+    Events seek_events = {0};
+    seek_events.size = array_count(seek_events.event);
+    Controller controller = {0};
+    controller.dt = clock.target_seconds_per_frame;
+
+    game_memory->fast_forward = true;
+    TIMED_BLOCK("fast_forward"){
+        while(state->input_stream->frame_index < frame_index &&
+              WIN_read_input_frame(state->input_stream, &seek_events)){
+            if(gamecode->main_game_loop){
+                gamecode->main_game_loop(game_memory, render_buffer, &seek_events, &controller);
+            }
+        }
     }
+    game_memory->fast_forward = false;
+
+    print("replay: seeked to frame %llu from keyframe %lld in %.2fms\n",
+          state->input_stream->frame_index, keyframe_index, 1000.0 * WIN_get_seconds_elapsed(start, WIN_get_clock()));
 }
 
+#include "win_trace.c"
+#include "win_video.c"
+#include "win_capture.c"
+#include "win_pipeline.c"
+#include "win_frame_export.c"
+#include "win_migrate.c"
+#include "win_reload.c"
+
 LRESULT CALLBACK
 Win32WindowCallback(HWND window, UINT message, WPARAM wParam, LPARAM lParam){
     LRESULT result = 0;
@@ -550,7 +783,7 @@ Win32WindowCallback(HWND window, UINT message, WPARAM wParam, LPARAM lParam){
             Event e = {0};
             e.type = EVENT_TEXT;
             e.text = (ui16)wParam;
-            events.event[events.index++] = e;
+            WIN_input_push(&input_ring, e);
         }break;
         case WM_SYSKEYDOWN:
         case WM_SYSKEYUP:
@@ -566,7 +799,7 @@ Win32WindowCallback(HWND window, UINT message, WPARAM wParam, LPARAM lParam){
                 Event e = {0};
                 e.type = is_down ? EVENT_KEYDOWN : EVENT_KEYUP;
                 e.key = eventkey_mapping[wParam];
-                events.event[events.index++] = e;
+                WIN_input_push(&input_ring, e);
             }
         } break;
         // TODO: maybe later case WM_MOUSEHWHEEL:
@@ -577,7 +810,7 @@ Win32WindowCallback(HWND window, UINT message, WPARAM wParam, LPARAM lParam){
             //QUESTION: ask about this being 8bytes but behaving like 4bytes
             e.mouse_x = (i32)(lParam & 0xFFFF);
             e.mouse_y = (i32)(lParam >> 16);
-            events.event[events.index++] = e;
+            WIN_input_push(&input_ring, e);
         } break;
         case WM_MOUSEWHEEL:
         {
@@ -601,7 +834,7 @@ Win32WindowCallback(HWND window, UINT message, WPARAM wParam, LPARAM lParam){
             else{
                 e.wheel_y = -1;
             }
-            events.event[events.index++] = e;
+            WIN_input_push(&input_ring, e);
         } break;
         case WM_LBUTTONDOWN:
         case WM_MBUTTONDOWN:
@@ -614,7 +847,7 @@ Win32WindowCallback(HWND window, UINT message, WPARAM wParam, LPARAM lParam){
             //QUESTION: ask about this being 8bytes but behaving like 4bytes
             e.mouse_x = (i32)(lParam & 0xFFFF);
             e.mouse_y = (i32)(lParam >> 16);
-            events.event[events.index++] = e;
+            WIN_input_push(&input_ring, e);
 		} break;
         case WM_LBUTTONUP:
         case WM_MBUTTONUP:
@@ -626,7 +859,7 @@ Win32WindowCallback(HWND window, UINT message, WPARAM wParam, LPARAM lParam){
             e.mouse = eventmouse_mapping[wParam];
             e.mouse_x = (i32)lParam & 0xFFFF;
             e.mouse_y = (i32)lParam >> 16;
-            events.event[events.index++] = e;
+            WIN_input_push(&input_ring, e);
         } break;
         case WM_CLOSE:
         {
@@ -641,8 +874,11 @@ Win32WindowCallback(HWND window, UINT message, WPARAM wParam, LPARAM lParam){
         {
             PAINTSTRUCT paint;
             HDC DC = BeginPaint(window, &paint);
-            WIN_WindowDimensions wd = WIN_get_window_dimensions(window);
-            WIN_update_window(offscreen_render_buffer, DC, wd.width, wd.height);
+            // NOTE: pipelined, the present thread owns the window and repaints it next frame
+            if(!pipeline.enabled){
+                WIN_WindowDimensions wd = WIN_get_window_dimensions(window);
+                WIN_update_window(offscreen_render_buffer, DC, wd.width, wd.height);
+            }
             EndPaint(window, &paint);
         } break;
 
@@ -662,6 +898,22 @@ Win32WindowCallback(HWND window, UINT message, WPARAM wParam, LPARAM lParam){
 // GetModuleHandle(0) -> gets hinstance
 int CALLBACK
 WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int show_cmd){
+    // NOTE: headless, no window or input, see win_golden.c
+    if(strstr(cmd_line, "-golden")){
+        WIN_State state = {0};
+        WIN_init_root_dir(&state);
+
+        char gamecode_dll_fullpath[256];
+        cat_strings(state.root_dir, "build\\game.dll", gamecode_dll_fullpath);
+        char copy_gamecode_dll_fullpath[256];
+        cat_strings(state.root_dir, "build\\copy_game.dll", copy_gamecode_dll_fullpath);
+
+        WIN_GameCode gamecode = WIN_load_gamecode(gamecode_dll_fullpath, copy_gamecode_dll_fullpath);
+        int failures = WIN_run_golden(&state, &gamecode, cmd_line);
+        WIN_unload_gamecode(&gamecode);
+        return(failures);
+    }
+
     WIN_load_xinput();
     WIN_init_render_buffer(&offscreen_render_buffer, 960, 540);
 
@@ -690,15 +942,11 @@ WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int show_cm
             clock.start = WIN_get_clock();
             QueryPerformanceFrequency(&clock.frequency);
             clock.cpu_start = __rdtsc();
+            WIN_init_frame_pacer();
 
             WIN_State state = {0};
 
-            char exe_path[MAX_PATH];
-            GetModuleFileNameA(0, exe_path, sizeof(exe_path));
-            char *starting_point = string_point_at_last(exe_path, '\\', 2);
-            // QUESTION: I dont understand this
-            state.root_dir_length = starting_point - exe_path;
-            get_root_dir(state.root_dir, state.root_dir_length, exe_path);
+            WIN_init_root_dir(&state);
 
             char gamecode_dll[] = "build\\game.dll";
             char gamecode_dll_fullpath[256]; 
@@ -725,34 +973,35 @@ WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int show_cm
 
             game_memory.read_entire_file = read_entire_file;
             game_memory.write_entire_file = write_entire_file;
+            game_memory.capture_frame = capture_frame;
             game_memory.free_file_memory = free_file_memory;
 
+            WIN_init_work_pool(&work_pool);
+            game_memory.parallel_for = work_pool.enabled ? WIN_parallel_for : 0;
+
             game_memory.total_size = game_memory.permanent_storage_size + game_memory.temporary_storage_size;
-            game_memory.total_storage = VirtualAlloc(base_address, (size)game_memory.total_size, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+            // NOTE: write watch lets the replay snapshots copy only the pages the game actually wrote
+            bool write_watch = true;
+            game_memory.total_storage = VirtualAlloc(base_address, (size)game_memory.total_size, MEM_COMMIT|MEM_RESERVE|MEM_WRITE_WATCH, PAGE_READWRITE);
+            if(!game_memory.total_storage){
+                write_watch = false;
+                game_memory.total_storage = VirtualAlloc(base_address, (size)game_memory.total_size, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+            }
             game_memory.permanent_storage = game_memory.total_storage;
+            // NOTE: replay keyframes from an earlier run hold pointers into total_storage, only valid at the same address
+            state.run_id = __rdtsc();
+            state.fixed_base = (base_address != 0 && game_memory.total_storage == base_address);
             game_memory.temporary_storage = (ui8 *)game_memory.total_storage + game_memory.permanent_storage_size;
 
-            for(ui64 i=0; i<array_count(state.replay_buffers); ++i){
-                state.replay_buffers[i] = VirtualAlloc(0, (size_t)game_memory.total_size, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
-
-                // CONSIDER: maybe do this in the future of it ends up slowing down
-                //WIN_ReplayBuffer *replay_buffer = &state.replay_buffers[i];
-                //char recording_string[64];
-                //wsprintf(recording_string, "build\\recording_%d.hmi", i);
-                //cat_strings(state.root_dir, recording_string, replay_buffer->file_name);
-                //replay_buffer->file_handle = CreateFileA(replay_buffer->file_name, GENERIC_WRITE|GENERIC_READ, 0, 0, CREATE_ALWAYS, 0, 0);
-
-                //DWORD highorder_size = game_memory.total_size >> 32;
-                //DWORD loworder_size = game_memory.total_size & 0xFFFFFFFF;
-                //replay_buffer->file_memory_mapping = CreateFileMapping(replay_buffer->file_handle, 0, PAGE_READWRITE, highorder_size, loworder_size, 0);
-                //replay_buffer->memory = MapViewOfFile(replay_buffer->file_memory_mapping, FILE_MAP_ALL_ACCESS, 0, 0, game_memory.total_size);
-                //if(replay_buffer->memory){
-                if(state.replay_buffers[i]){
-                }
-                else{
-                    //TODO: Logging
-                }
-            }
+#if PROFILE
+            // NOTE: lives outside of total_storage so recording/playback never rewinds the profiler
+            global_profile_state = (ProfileState *)VirtualAlloc(0, sizeof(ProfileState), MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+            game_memory.profile_state = global_profile_state;
+#endif
+            WIN_Trace trace = {0};
+            WIN_init_trace(&trace, &state, global_profile_state, cmd_line);
+
+            WIN_init_page_watch(&state, &game_memory, write_watch);
 
             // INCOMPLETE: this might need to be moved inside the loop because some things might change such as width/height but im not sure yet
             RenderBuffer render_buffer = {0};
@@ -771,19 +1020,66 @@ WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int show_cm
             global_pause = false;
 
             if(game_memory.permanent_storage && game_memory.temporary_storage && render_buffer.memory){
+                if(strstr(cmd_line, "-pipeline")){
+                    WIN_init_pipeline(&pipeline, window, &gamecode, &game_memory, render_buffer.width, render_buffer.height);
+                }
+                // NOTE: -export renders every frame into a shared memory slot another process can read, serial loop only
+                if(strstr(cmd_line, "-export") && !pipeline.enabled){
+                    WIN_init_frame_export(&frame_export, render_buffer.width, render_buffer.height);
+                }
+                WIN_init_video(&video, &state, cmd_line, render_buffer.width, render_buffer.height, clock.target_seconds_per_frame);
+                WIN_init_capture(&capture, &state, cmd_line, render_buffer.width, render_buffer.height);
+
+                // NOTE: watches build\ for a new game.dll, without it the loop polls the write time every frame
+                char copy_gamecode_prefix[256];
+                cat_strings(state.root_dir, "build\\copy_game", copy_gamecode_prefix);
+                WIN_init_reloader(&reloader, state.root_dir, gamecode_dll_fullpath, copy_gamecode_prefix);
+
+                // NOTE: -seek N starts playing back recording 1 at frame N
+                char *seek_arg = strstr(cmd_line, "-seek");
+                ui32 seek_frame = 0;
+                if(seek_arg){
+                    seek_arg += string_length("-seek");
+                    if(parse_ui32(&seek_arg, &seek_frame)){
+                        WIN_pipeline_drain(&pipeline);
+                        WIN_init_playback_handle(&state, &game_memory, &gamecode, 1);
+                        WIN_seek_playback(&state, &game_memory, &gamecode, &render_buffer, seek_frame);
+                    }
+                }
+
                 while(global_running){
                     controller.dt = clock.target_seconds_per_frame;
-                    FILETIME current_write_time = WIN_get_file_write_time(gamecode_dll);
-                    if((CompareFileTime(&current_write_time, &gamecode.write_time)) != 0){
-                        WIN_unload_gamecode(&gamecode);
-                        gamecode = WIN_load_gamecode(gamecode_dll_fullpath, copy_gamecode_dll_fullpath);
+                    TIMED_BLOCK("reload_gamecode"){
+                        if(reloader.enabled){
+                            if(reloader.pending){
+                                WIN_pipeline_drain(&pipeline);
+                                WIN_begin_migration(&migration, &gamecode, &game_memory);
+                                WIN_reload_swap(&reloader, &gamecode);
+                                WIN_end_migration(&migration, &gamecode, &game_memory);
+                            }
+                        }
+                        else{
+                            FILETIME current_write_time = WIN_get_file_write_time(gamecode_dll);
+                            if((CompareFileTime(&current_write_time, &gamecode.write_time)) != 0){
+                                WIN_pipeline_drain(&pipeline);
+                                WIN_begin_migration(&migration, &gamecode, &game_memory);
+                                WIN_unload_gamecode(&gamecode);
+                                gamecode = WIN_load_gamecode(gamecode_dll_fullpath, copy_gamecode_dll_fullpath);
+                                WIN_end_migration(&migration, &gamecode, &game_memory);
+                            }
+                        }
                     }
 
-                    MSG message;
-                    while(PeekMessageA(&message, 0, 0, 0, PM_REMOVE)){
-                        TranslateMessage(&message);
-                        DispatchMessageA(&message);
+                    TIMED_BLOCK("input"){
+                        MSG message;
+                        while(PeekMessageA(&message, 0, 0, 0, PM_REMOVE)){
+                            TranslateMessage(&message);
+                            DispatchMessageA(&message);
+                        }
+                        WIN_process_controller_input();
+                        WIN_input_flush(&input_ring);
 
+                        WIN_input_drain(&input_ring, &events, (ui64)WIN_get_clock().QuadPart);
                         for(ui32 i=0; i < events.index; ++i){
                             Event *event = &events.event[i];
                             if(event->type == EVENT_KEYDOWN){
@@ -791,13 +1087,16 @@ WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int show_cm
                                     global_running = false;
                                 }
                                 if(event->key == KEY_L){
+                                    // NOTE: starting a recording or a playback snapshots or rewinds game memory, the
+                                    // render thread may still be drawing particles that live in it
+                                    WIN_pipeline_drain(&pipeline);
                                     if(state.playback_index == 0){
                                         if(state.recording_index == 0){
-                                            WIN_init_recording_handle(&state, &game_memory, 1);
+                                            WIN_init_recording_handle(&state, &game_memory, &gamecode, 1);
                                         }
                                         else{
                                             WIN_release_recording_handle(&state);
-                                            WIN_init_playback_handle(&state, &game_memory, 1);
+                                            WIN_init_playback_handle(&state, &game_memory, &gamecode, 1);
                                         }
                                     }
                                     else{
@@ -809,42 +1108,100 @@ WinMain(HINSTANCE instance, HINSTANCE prev_instance, LPSTR cmd_line, int show_cm
                                     global_pause = !global_pause;
                                     event->key = KEY_NONE;
                                 }
+                                if(event->key == KEY_F1 && global_profile_state){
+                                    global_profile_state->overlay = !global_profile_state->overlay;
+                                    event->key = KEY_NONE;
+                                }
+                                if(event->key == KEY_F2){
+                                    if(global_profile_state){
+                                        profile_dump(global_profile_state, PROFILE_FRAME_COUNT, 16);
+                                    }
+                                    frame_pacer_dump(&clock.pacer);
+                                    WIN_input_dump(&input_ring);
+                                    WIN_capture_dump(&capture);
+                                    event->key = KEY_NONE;
+                                }
+                                if(event->key == KEY_F3){
+                                    capture.screenshot_requested = true;
+                                    event->key = KEY_NONE;
+                                }
                             }
                         }
+
+                        // NOTE: the game never sees input from while it was paused
+                        if(global_pause){
+                            events.index = 0;
+                        }
                     }
-                    WIN_process_controller_input();
 
                     if(!global_pause){
                         if(state.recording_index){
                             WIN_record_input(&state, &events);
                         }
-                        if(state.playback_index){
-                            WIN_play_input(&state, &game_memory, &events);
+                        if(state.playback_index && !WIN_play_input(&state, &events)){
+                            WIN_pipeline_drain(&pipeline);
+                            WIN_loop_playback(&state, &game_memory, &gamecode, &events);
                         }
-                        if(gamecode.main_game_loop){
-                            gamecode.main_game_loop(&game_memory, &render_buffer, &events, &controller);
+                        bool pipelined = (pipeline.enabled && gamecode.simulate_game && gamecode.render_game);
+                        TIMED_BLOCK("main_game_loop"){
+                            if(pipelined){
+                                WIN_PipelineSlot *slot = WIN_pipeline_begin_simulate(&pipeline);
+                                gamecode.simulate_game(&game_memory, &events, &controller, &slot->frame);
+                                WIN_pipeline_end_simulate(&pipeline);
+                            }
+                            else if(gamecode.main_game_loop){
+                                if(frame_export.enabled){
+                                    render_buffer.memory = WIN_frame_export_begin(&frame_export);
+                                    offscreen_render_buffer.memory = render_buffer.memory;
+                                }
+                                gamecode.main_game_loop(&game_memory, &render_buffer, &events, &controller);
+                                if(frame_export.enabled){
+                                    WIN_frame_export_end(&frame_export);
+                                }
+                                WIN_video_capture(&video, &render_buffer);
+                                WIN_capture_end_frame(&capture, &render_buffer);
+                            }
                             if(!game_memory.running){
                                 global_running = game_memory.running;
                             }
                         }
                         events.index = 0;
 
-                        WIN_sync_framerate();
+                        TIMED_BLOCK("sync_framerate"){
+                            WIN_sync_framerate();
+                        }
 
                         //f32 MSPF = 1000 * WIN_get_seconds_elapsed(clock.start, WIN_get_clock());
                         //f32 FPS = ((f32)clock.frequency.QuadPart / (f32)(WIN_get_clock().QuadPart - clock.start.QuadPart));
                         //f32 CPUCYCLES = (f32)(__rdtsc() - clock.cpu_start) / (1000 * 1000);
                         //print("MSPF: %.02fms - FPS: %.02f - CPU: %.02f\n", MSPF, FPS, CPUCYCLES);
 
-                        WIN_WindowDimensions wd = WIN_get_window_dimensions(window);
-                        WIN_update_window(offscreen_render_buffer, DC, wd.width, wd.height);
+                        if(!pipelined){
+                            TIMED_BLOCK("update_window"){
+                                WIN_WindowDimensions wd = WIN_get_window_dimensions(window);
+                                WIN_update_window(offscreen_render_buffer, DC, wd.width, wd.height);
+                            }
+                        }
 
                         clock.cpu_end = __rdtsc();
                         clock.end = WIN_get_clock();
+                        if(global_profile_state){
+                            profile_end_frame(global_profile_state, clock.cpu_end - clock.cpu_start);
+                        }
                         clock.start = clock.end;
                         clock.cpu_start = clock.cpu_end;
                     }
                 }
+                WIN_shutdown_pipeline(&pipeline);
+                WIN_shutdown_work_pool(&work_pool);
+                WIN_shutdown_video(&video);
+                WIN_shutdown_capture(&capture);
+                WIN_shutdown_reloader(&reloader);
+                if(state.recording_index){
+                    WIN_release_recording_handle(&state);
+                }
+                WIN_write_trace(&trace, global_profile_state);
+                frame_pacer_dump(&clock.pacer);
             }
             else{
                 // TODO: Logging
@@ -27,6 +27,9 @@ typedef struct WIN_Clock{
 
     f32 target_seconds_per_frame;
     bool sleep_granularity_set;
+
+    HANDLE sleep_timer; // NOTE: 0 when high resolution waitable timers are unavailable
+    FramePacer pacer;
 } WIN_Clock;
 
 typedef struct WIN_GameCode{
@@ -34,30 +37,68 @@ typedef struct WIN_GameCode{
 
     HMODULE gamecode_dll;
     MainGameLoop *main_game_loop;
+    SimulateGame *simulate_game;
+    RenderGame *render_game;
+    RenderScene *render_scene;
+    RunCheck *run_check;
+    GameStateLayoutFunction *game_state_layout;
+    MigrateGameState *migrate_game_state;
 
     FILETIME write_time;
     bool is_valid;
 } WIN_GameCode;
 
 typedef struct WIN_ReplayBuffer{
-    void *memory;
-    char file_name[MAX_PATH];
-    HANDLE file_handle;
-    HANDLE file_memory_mapping;
+    void *memory;      // NOTE: total_size reserved, pages are committed when first snapshotted
+    ui64 *committed;   // NOTE: bit per page committed in memory
+    ui64 *differs;     // NOTE: bit per page that may differ from game memory
+    bool has_snapshot; // NOTE: false until recorded into in this run, playback then starts from the keyframes
 } WIN_ReplayBuffer;
 
+typedef struct WIN_PageWatch{
+    void *base;
+    ui64 size;
+    ui64 page_size;
+    ui64 page_count;
+    ui64 bitmap_words;
+
+    bool write_watch;  // NOTE: false when total_storage could not be allocated with MEM_WRITE_WATCH
+    void **addresses;  // NOTE: page_count entries, filled by GetWriteWatch
+
+    ui64 *touched;         // NOTE: bit per page ever written, every other page is still zero
+    ui64 *keyframe_dirty;  // NOTE: bit per page written since the last replay keyframe
+} WIN_PageWatch;
+
+// NOTE: buffered reader/writer for the input recording, see win_recording.c for the format
+typedef struct WIN_InputStream{
+    HANDLE file;
+    ui32 used;         // NOTE: bytes in buffer
+    ui32 at;           // NOTE: playback read position in buffer
+    ui64 frame_index;
+    ui64 file_offset;  // NOTE: file position of buffer[0]
+    Event previous;    // NOTE: last event written/read, fields are delta encoded against it
+    ui8 buffer[Kilobytes(64)];
+} WIN_InputStream;
+
 typedef struct WIN_State{
     char root_dir[256];
     ui64 root_dir_length;
 
-    void *replay_buffers[4];
-    // CONSIDER: maybe do this in the future if it ends up slowing down WIN_ReplayBuffer replay_buffers[4];
+    WIN_ReplayBuffer replay_buffers[4];
+    WIN_PageWatch page_watch;
 
     int recording_index;
     HANDLE recording_handle;
 
     HANDLE playback_handle;
     int playback_index;
+
+    WIN_InputStream *input_stream; // NOTE: recording and playback are never active at the same time
+    HANDLE keyframe_handle;
+    WIN_InputStream *keyframe_stream;
+
+    ui64 run_id;     // NOTE: rdtsc at startup, tells keyframes of this run from ones of an earlier run
+    bool fixed_base; // NOTE: total_storage got the address it asked for, the same one every run
 } WIN_State;
 
 #define WIN_PLATFORM_H
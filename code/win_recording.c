@@ -0,0 +1,434 @@
+#if !defined(WIN_RECORDING_C)
+
+// NOTE: compact input recording format for build\recording_%d.out
+//
+//   header  "GREC" ui32 version, ui32 0
+//   frame   varint event_count, then event_count events
+//   event   ui8 type, ui8 field mask, then every field whose mask bit is set as a varint
+//
+// Fields are only written when they differ from the previous event in the stream, mouse_x/mouse_y
+// are written as a zigzag delta from it. An idle frame is a single 0 byte. The delta state starts
+// zeroed at the header, which is also where playback restarts when it loops.
+//
+// Every RECORDING_KEYFRAME_INTERVAL frames a keyframe goes to build\recording_%d.keys
+//
+//   header    "GKEY" ui32 version, ui32 page_size, then WIN_KeyframeFileHeader
+//   keyframe  WIN_KeyframeHeader, then per page varint page_index + 1 and the packed page, 0 ends it
+//   page      varint token, odd is a run of token >> 1 copies of the next ui32, even is token >> 1
+//             literal ui32s
+//
+// The first keyframe holds every page the game ever wrote, the rest only the pages written since the
+// keyframe before, so seeking applies keyframes in order up to the frame and then fast forwards the
+// game from there.
+//
+// Keyframes are raw pages of total_storage, pointers included, so they are only restored into the same
+// GameState layout, and from an earlier run only when total_storage sits at the same fixed address.
+
+#define RECORDING_MAGIC 0x43455247 // NOTE: "GREC"
+#define RECORDING_VERSION 2
+#define KEYFRAME_MAGIC 0x59454B47 // NOTE: "GKEY"
+#define KEYFRAME_VERSION 2
+#define RECORDING_KEYFRAME_INTERVAL 300 // NOTE: 10 seconds at 30hz, the most a seek ever fast forwards
+
+typedef struct WIN_KeyframeFileHeader{
+    ui64 layout_hash;  // NOTE: game_state_layout().hash of the dll that recorded, 0 without the export
+    ui64 storage_base; // NOTE: address of total_storage, the pages hold pointers into it
+    ui64 storage_size;
+    ui64 run_id;       // NOTE: WIN_State.run_id of the run that recorded
+    ui32 fixed_base;   // NOTE: total_storage was allocated at a fixed address, see WinMain
+    ui32 pad;
+} WIN_KeyframeFileHeader;
+
+typedef struct WIN_KeyframeHeader{
+    ui64 frame_index;
+    ui64 input_offset; // NOTE: position of frame_index in the input recording
+    Event previous;    // NOTE: input delta state at input_offset
+    ui32 full;         // NOTE: every page not in this keyframe is zero
+} WIN_KeyframeHeader;
+
+#define RECORDING_FIELD_KEY     (1 << 0)
+#define RECORDING_FIELD_PAD     (1 << 1)
+#define RECORDING_FIELD_MOUSE   (1 << 2)
+#define RECORDING_FIELD_MOUSE_X (1 << 3)
+#define RECORDING_FIELD_MOUSE_Y (1 << 4)
+#define RECORDING_FIELD_WHEEL_Y (1 << 5)
+#define RECORDING_FIELD_WHEEL_X (1 << 6)
+#define RECORDING_FIELD_TEXT    (1 << 7)
+
+// NOTE: type + mask + 8 fields of at most 5 bytes each
+#define RECORDING_MAX_EVENT_BYTES (2 + (8 * 5))
+
+static ui32
+WIN_zigzag_encode(i32 value){
+    return(((ui32)value << 1) ^ (ui32)(value >> 31));
+}
+
+static i32
+WIN_zigzag_decode(ui32 value){
+    return((i32)(value >> 1) ^ -(i32)(value & 1));
+}
+
+static void
+WIN_stream_flush(WIN_InputStream *stream){
+    if(stream->used){
+        DWORD bytes_written;
+        WriteFile(stream->file, stream->buffer, stream->used, &bytes_written, 0);
+        stream->file_offset += stream->used;
+        stream->used = 0;
+    }
+}
+
+static void
+WIN_stream_write(WIN_InputStream *stream, void *data, ui32 data_size){
+    if(stream->used + data_size > sizeof(stream->buffer)){
+        WIN_stream_flush(stream);
+    }
+    CopyMemory(stream->buffer + stream->used, data, data_size);
+    stream->used += data_size;
+}
+
+static void
+WIN_stream_write_varint(WIN_InputStream *stream, ui32 value){
+    while(value >= 0x80){
+        stream->buffer[stream->used++] = (ui8)(value | 0x80);
+        value >>= 7;
+    }
+    stream->buffer[stream->used++] = (ui8)value;
+}
+
+// NOTE: playback only, keeps at least min_bytes buffered unless the file runs out
+static void
+WIN_stream_fill(WIN_InputStream *stream, ui32 min_bytes){
+    ui32 remaining = stream->used - stream->at;
+    if(remaining < min_bytes){
+        MoveMemory(stream->buffer, stream->buffer + stream->at, remaining);
+        stream->file_offset += stream->at;
+        stream->used = remaining;
+        stream->at = 0;
+
+        DWORD bytes_read = 0;
+        if(ReadFile(stream->file, stream->buffer + stream->used, sizeof(stream->buffer) - stream->used, &bytes_read, 0)){
+            stream->used += bytes_read;
+        }
+        else{
+            // TODO: Logging
+        }
+    }
+}
+
+static bool
+WIN_stream_read_varint(WIN_InputStream *stream, ui32 *value){
+    ui32 result = 0;
+    for(ui32 shift=0; shift < 35; shift += 7){
+        if(stream->at >= stream->used){
+            return(false);
+        }
+        ui8 byte = stream->buffer[stream->at++];
+        result |= (ui32)(byte & 0x7F) << shift;
+        if(!(byte & 0x80)){
+            *value = result;
+            return(true);
+        }
+    }
+    return(false);
+}
+
+static bool
+WIN_stream_read(WIN_InputStream *stream, void *data, ui32 data_size){
+    WIN_stream_fill(stream, data_size);
+    if(stream->used - stream->at < data_size){
+        return(false);
+    }
+    CopyMemory(data, stream->buffer + stream->at, data_size);
+    stream->at += data_size;
+    return(true);
+}
+
+// NOTE: file has to be positioned at file_offset already
+static void
+WIN_begin_input_stream(WIN_InputStream *stream, HANDLE file, ui64 file_offset){
+    stream->file = file;
+    stream->used = 0;
+    stream->at = 0;
+    stream->frame_index = 0;
+    stream->file_offset = file_offset;
+    ZeroMemory(&stream->previous, sizeof(stream->previous));
+}
+
+static void
+WIN_write_stream_header(WIN_InputStream *stream, ui32 magic, ui32 version, ui32 value){
+    ui32 header[3] = {magic, version, value};
+    WIN_stream_write(stream, header, sizeof(header));
+}
+
+// NOTE: returns false when the file is not in this format
+static bool
+WIN_read_stream_header(WIN_InputStream *stream, ui32 magic, ui32 version, ui32 value){
+    ui32 header[3] = {0};
+    bool result = (WIN_stream_read(stream, header, sizeof(header)) &&
+                   header[0] == magic && header[1] == version && header[2] == value);
+    if(!result){
+        // NOTE: nothing can be read from a stream in an unknown format
+        stream->at = stream->used;
+    }
+    return(result);
+}
+
+static void
+WIN_write_input_frame(WIN_InputStream *stream, Events *events){
+    ui32 count = events->index;
+    if(count > array_count(events->event)){
+        count = array_count(events->event);
+    }
+
+    if(stream->used + 5 > sizeof(stream->buffer)){
+        WIN_stream_flush(stream);
+    }
+    WIN_stream_write_varint(stream, count);
+
+    Event *previous = &stream->previous;
+    for(ui32 i=0; i < count; ++i){
+        Event *event = &events->event[i];
+        if(stream->used + RECORDING_MAX_EVENT_BYTES > sizeof(stream->buffer)){
+            WIN_stream_flush(stream);
+        }
+
+        ui8 mask = 0;
+        if(event->key != previous->key){ mask |= RECORDING_FIELD_KEY; }
+        if(event->pad != previous->pad){ mask |= RECORDING_FIELD_PAD; }
+        if(event->mouse != previous->mouse){ mask |= RECORDING_FIELD_MOUSE; }
+        if(event->mouse_x != previous->mouse_x){ mask |= RECORDING_FIELD_MOUSE_X; }
+        if(event->mouse_y != previous->mouse_y){ mask |= RECORDING_FIELD_MOUSE_Y; }
+        if(event->wheel_y != previous->wheel_y){ mask |= RECORDING_FIELD_WHEEL_Y; }
+        if(event->wheel_x != previous->wheel_x){ mask |= RECORDING_FIELD_WHEEL_X; }
+        if(event->text != previous->text){ mask |= RECORDING_FIELD_TEXT; }
+
+        stream->buffer[stream->used++] = (ui8)event->type;
+        stream->buffer[stream->used++] = mask;
+        if(mask & RECORDING_FIELD_KEY){ WIN_stream_write_varint(stream, (ui32)event->key); }
+        if(mask & RECORDING_FIELD_PAD){ WIN_stream_write_varint(stream, (ui32)event->pad); }
+        if(mask & RECORDING_FIELD_MOUSE){ WIN_stream_write_varint(stream, (ui32)event->mouse); }
+        if(mask & RECORDING_FIELD_MOUSE_X){ WIN_stream_write_varint(stream, WIN_zigzag_encode(event->mouse_x - previous->mouse_x)); }
+        if(mask & RECORDING_FIELD_MOUSE_Y){ WIN_stream_write_varint(stream, WIN_zigzag_encode(event->mouse_y - previous->mouse_y)); }
+        if(mask & RECORDING_FIELD_WHEEL_Y){ WIN_stream_write_varint(stream, WIN_zigzag_encode(event->wheel_y)); }
+        if(mask & RECORDING_FIELD_WHEEL_X){ WIN_stream_write_varint(stream, WIN_zigzag_encode(event->wheel_x)); }
+        if(mask & RECORDING_FIELD_TEXT){ WIN_stream_write_varint(stream, (ui32)event->text); }
+
+        *previous = *event;
+    }
+
+    ++stream->frame_index;
+}
+
+// NOTE: returns false at the end of the stream or on a truncated frame
+static bool
+WIN_read_input_frame(WIN_InputStream *stream, Events *events){
+    WIN_stream_fill(stream, 5 + (array_count(events->event) * RECORDING_MAX_EVENT_BYTES));
+
+    ui32 count = 0;
+    if(!WIN_stream_read_varint(stream, &count) || count > array_count(events->event)){
+        return(false);
+    }
+
+    Event *previous = &stream->previous;
+    for(ui32 i=0; i < count; ++i){
+        if(stream->used - stream->at < 2){
+            return(false);
+        }
+        Event event = *previous;
+        event.type = (EventType)stream->buffer[stream->at++];
+        ui8 mask = stream->buffer[stream->at++];
+
+        ui32 value = 0;
+        bool ok = true;
+        if(mask & RECORDING_FIELD_KEY){ ok = ok && WIN_stream_read_varint(stream, &value); event.key = (EventKey)value; }
+        if(mask & RECORDING_FIELD_PAD){ ok = ok && WIN_stream_read_varint(stream, &value); event.pad = (EventPad)value; }
+        if(mask & RECORDING_FIELD_MOUSE){ ok = ok && WIN_stream_read_varint(stream, &value); event.mouse = (EventMouse)value; }
+        if(mask & RECORDING_FIELD_MOUSE_X){ ok = ok && WIN_stream_read_varint(stream, &value); event.mouse_x = previous->mouse_x + WIN_zigzag_decode(value); }
+        if(mask & RECORDING_FIELD_MOUSE_Y){ ok = ok && WIN_stream_read_varint(stream, &value); event.mouse_y = previous->mouse_y + WIN_zigzag_decode(value); }
+        if(mask & RECORDING_FIELD_WHEEL_Y){ ok = ok && WIN_stream_read_varint(stream, &value); event.wheel_y = (i8)WIN_zigzag_decode(value); }
+        if(mask & RECORDING_FIELD_WHEEL_X){ ok = ok && WIN_stream_read_varint(stream, &value); event.wheel_x = (i8)WIN_zigzag_decode(value); }
+        if(mask & RECORDING_FIELD_TEXT){ ok = ok && WIN_stream_read_varint(stream, &value); event.text = (ui16)value; }
+        if(!ok){
+            return(false);
+        }
+
+        events->event[i] = event;
+        *previous = event;
+    }
+
+    events->index = count;
+    ++stream->frame_index;
+    return(true);
+}
+
+static void
+WIN_stream_write_page(WIN_InputStream *stream, ui32 *words, ui32 word_count){
+    if(stream->used + (word_count * 8) + 16 > sizeof(stream->buffer)){
+        WIN_stream_flush(stream);
+    }
+
+    ui32 i = 0;
+    while(i < word_count){
+        ui32 run = 1;
+        while(i + run < word_count && words[i + run] == words[i]){
+            ++run;
+        }
+
+        if(run >= 3){
+            WIN_stream_write_varint(stream, (run << 1) | 1);
+            CopyMemory(stream->buffer + stream->used, &words[i], sizeof(ui32));
+            stream->used += sizeof(ui32);
+            i += run;
+        }
+        else{
+            // NOTE: literal up to the next run worth encoding
+            ui32 start = i;
+            while(i < word_count && !(i + 2 < word_count && words[i] == words[i + 1] && words[i] == words[i + 2])){
+                ++i;
+            }
+            WIN_stream_write_varint(stream, (i - start) << 1);
+            CopyMemory(stream->buffer + stream->used, &words[start], (i - start) * sizeof(ui32));
+            stream->used += (i - start) * sizeof(ui32);
+        }
+    }
+}
+
+static bool
+WIN_stream_read_page(WIN_InputStream *stream, ui32 *words, ui32 word_count){
+    WIN_stream_fill(stream, (word_count * 8) + 16);
+
+    ui32 i = 0;
+    while(i < word_count){
+        ui32 token = 0;
+        if(!WIN_stream_read_varint(stream, &token)){
+            return(false);
+        }
+        ui32 count = token >> 1;
+        if(count > word_count - i){
+            return(false);
+        }
+
+        if(token & 1){
+            ui32 value = 0;
+            if(stream->used - stream->at < sizeof(ui32)){
+                return(false);
+            }
+            CopyMemory(&value, stream->buffer + stream->at, sizeof(ui32));
+            stream->at += sizeof(ui32);
+            for(ui32 end=i + count; i < end; ++i){
+                words[i] = value;
+            }
+        }
+        else{
+            if(stream->used - stream->at < count * sizeof(ui32)){
+                return(false);
+            }
+            CopyMemory(&words[i], stream->buffer + stream->at, count * sizeof(ui32));
+            stream->at += count * sizeof(ui32);
+            i += count;
+        }
+    }
+
+    return(true);
+}
+
+// NOTE: recording only, call before the input of input->frame_index is written
+static void
+WIN_write_keyframe(WIN_State *state, WIN_InputStream *input){
+    WIN_PageWatch *watch = &state->page_watch;
+    WIN_InputStream *keys = state->keyframe_stream;
+
+    TIMED_BLOCK("write_keyframe"){
+        WIN_harvest_written_pages(state);
+
+        WIN_KeyframeHeader header;
+        ZeroMemory(&header, sizeof(header));
+        header.frame_index = input->frame_index;
+        header.input_offset = input->file_offset + input->used;
+        header.previous = input->previous;
+        header.full = (input->frame_index == 0);
+        WIN_stream_write(keys, &header, sizeof(header));
+
+        ui64 *pages = header.full ? watch->touched : watch->keyframe_dirty;
+        for(ui64 word=0; word < watch->bitmap_words; ++word){
+            ui64 bits = pages[word];
+            unsigned long bit;
+            while(_BitScanForward64(&bit, bits)){
+                bits &= bits - 1;
+                ui64 page = (word * 64) + bit;
+                if(keys->used + 8 > sizeof(keys->buffer)){
+                    WIN_stream_flush(keys);
+                }
+                WIN_stream_write_varint(keys, (ui32)(page + 1));
+                WIN_stream_write_page(keys, (ui32 *)((ui8 *)watch->base + (page * watch->page_size)), (ui32)(watch->page_size / sizeof(ui32)));
+            }
+        }
+        if(keys->used + 8 > sizeof(keys->buffer)){
+            WIN_stream_flush(keys);
+        }
+        WIN_stream_write_varint(keys, 0);
+
+        ZeroMemory(watch->keyframe_dirty, sizeof(ui64) * watch->bitmap_words);
+    }
+}
+
+// NOTE: rebuilds game memory as it was at the last keyframe at or before frame_index, the keyframe
+// stream has to be positioned right after its header. Returns false when not even the first keyframe
+// could be applied.
+static bool
+WIN_apply_keyframes(WIN_State *state, ui64 frame_index, WIN_KeyframeHeader *applied){
+    WIN_PageWatch *watch = &state->page_watch;
+    WIN_InputStream *keys = state->keyframe_stream;
+    bool result = false;
+
+    TIMED_BLOCK("apply_keyframes"){
+        // NOTE: touched has to be up to date before a full keyframe zeroes everything else
+        WIN_harvest_written_pages(state);
+
+        WIN_KeyframeHeader header;
+        while(WIN_stream_read(keys, &header, sizeof(header))){
+            if(result && header.frame_index > frame_index){
+                break;
+            }
+
+            if(header.full){
+                for(ui64 word=0; word < watch->bitmap_words; ++word){
+                    ui64 bits = watch->touched[word];
+                    unsigned long bit;
+                    while(_BitScanForward64(&bit, bits)){
+                        bits &= bits - 1;
+                        ZeroMemory((ui8 *)watch->base + (((word * 64) + bit) * watch->page_size), watch->page_size);
+                    }
+                }
+            }
+
+            bool ok = true;
+            for(;;){
+                ui32 page_plus_one = 0;
+                WIN_stream_fill(keys, 8);
+                ok = WIN_stream_read_varint(keys, &page_plus_one) && page_plus_one <= watch->page_count;
+                if(!ok || page_plus_one == 0){
+                    break;
+                }
+                ui64 page = page_plus_one - 1;
+                ok = WIN_stream_read_page(keys, (ui32 *)((ui8 *)watch->base + (page * watch->page_size)), (ui32)(watch->page_size / sizeof(ui32)));
+                if(!ok){
+                    break;
+                }
+            }
+            if(!ok){
+                // TODO: Logging, truncated keyframe, memory is somewhere in between two keyframes now
+                break;
+            }
+
+            *applied = header;
+            result = true;
+        }
+    }
+
+    return(result);
+}
+
+#define WIN_RECORDING_C
+#endif
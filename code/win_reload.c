@@ -0,0 +1,187 @@
+#if !defined(WIN_RELOAD_C)
+
+// NOTE: event driven hot reload. A watcher thread waits on ReadDirectoryChangesW for build\ instead of the
+// main loop stat'ing game.dll every frame. Once game.dll has been quiet for RELOAD_SETTLE_MS and the
+// linker has let go of it, the thread copies it, loads the copy and resolves the exports, then marks it
+// pending. The main thread only swaps the already loaded code in at the top of the next frame.
+//
+// The new copy can not reuse the name of the copy that is still loaded, so they alternate between
+// copy_game_0.dll and copy_game_1.dll. Only one prepared dll is pending at a time, the watcher waits for
+// the main thread to take it before it prepares the next.
+
+#define RELOAD_SETTLE_MS 20
+
+typedef struct WIN_Reloader{
+    bool enabled;
+    HANDLE directory;
+    HANDLE thread;
+    HANDLE quit_event;
+
+    char source_dll[MAX_PATH];
+    char copy_dll_prefix[MAX_PATH];
+    ui32 copy_index;
+
+    // NOTE: written by the watcher while pending is false, read by the main thread while it is true
+    WIN_GameCode prepared;
+    LARGE_INTEGER last_change;
+    bool volatile pending;
+
+    DWORD notify_buffer[1024]; // NOTE: FILE_NOTIFY_INFORMATION has to be DWORD aligned
+} WIN_Reloader;
+
+global WIN_Reloader reloader;
+
+static bool
+WIN_reload_names_dll(WIN_Reloader *reloader, DWORD bytes){
+    // NOTE: 0 bytes means the notifications overflowed, assume the worst
+    if(bytes == 0){
+        return(true);
+    }
+
+    FILE_NOTIFY_INFORMATION *info = (FILE_NOTIFY_INFORMATION *)reloader->notify_buffer;
+    for(;;){
+        if(CompareStringOrdinal(info->FileName, info->FileNameLength / sizeof(WCHAR), L"game.dll", -1, TRUE) == CSTR_EQUAL){
+            return(true);
+        }
+        if(!info->NextEntryOffset){
+            break;
+        }
+        info = (FILE_NOTIFY_INFORMATION *)((ui8 *)info + info->NextEntryOffset);
+    }
+    return(false);
+}
+
+// NOTE: false while the linker still has game.dll open, try again after the next quiet period
+static bool
+WIN_reload_prepare(WIN_Reloader *reloader){
+    HANDLE file = CreateFileA(reloader->source_dll, GENERIC_READ, 0, 0, OPEN_EXISTING, 0, 0);
+    if(file == INVALID_HANDLE_VALUE){
+        return(false);
+    }
+    CloseHandle(file);
+
+    while(reloader->pending){
+        if(WaitForSingleObject(reloader->quit_event, 1) == WAIT_OBJECT_0){
+            return(true);
+        }
+    }
+
+    char copy_dll[MAX_PATH];
+    snprintf(copy_dll, sizeof(copy_dll), "%s_%u.dll", reloader->copy_dll_prefix, ++reloader->copy_index % 2);
+    reloader->prepared = WIN_load_gamecode(reloader->source_dll, copy_dll);
+    if(!reloader->prepared.is_valid){
+        // NOTE: broken or half written build, keep running the old code until the next change
+        print("reload: %s has no main_game_loop, keeping the loaded code\n", reloader->source_dll);
+        WIN_unload_gamecode(&reloader->prepared);
+        return(true);
+    }
+
+    _ReadWriteBarrier();
+    reloader->pending = true;
+    return(true);
+}
+
+static DWORD WINAPI
+WIN_reload_thread(LPVOID parameter){
+    WIN_Reloader *reloader = (WIN_Reloader *)parameter;
+
+    OVERLAPPED overlapped = {0};
+    overlapped.hEvent = CreateEventA(0, TRUE, FALSE, 0);
+    if(!overlapped.hEvent){
+        // TODO: Logging
+        return(0);
+    }
+    HANDLE handles[2] = {overlapped.hEvent, reloader->quit_event};
+
+    bool read_pending = false;
+    bool dirty = false;
+    for(;;){
+        if(!read_pending){
+            ResetEvent(overlapped.hEvent);
+            if(!ReadDirectoryChangesW(reloader->directory, reloader->notify_buffer, sizeof(reloader->notify_buffer), FALSE,
+                                      FILE_NOTIFY_CHANGE_LAST_WRITE|FILE_NOTIFY_CHANGE_FILE_NAME|FILE_NOTIFY_CHANGE_SIZE, 0, &overlapped, 0)){
+                // TODO: Logging
+                break;
+            }
+            read_pending = true;
+        }
+
+        DWORD wait = WaitForMultipleObjects(2, handles, FALSE, dirty ? RELOAD_SETTLE_MS : INFINITE);
+        if(wait == WAIT_OBJECT_0){
+            read_pending = false;
+            DWORD bytes = 0;
+            GetOverlappedResult(reloader->directory, &overlapped, &bytes, FALSE);
+            if(WIN_reload_names_dll(reloader, bytes)){
+                dirty = true;
+                reloader->last_change = WIN_get_clock();
+            }
+        }
+        else if(wait == WAIT_TIMEOUT){
+            if(WIN_reload_prepare(reloader)){
+                dirty = false;
+            }
+        }
+        else{
+            break;
+        }
+    }
+
+    if(read_pending){
+        DWORD bytes;
+        CancelIo(reloader->directory);
+        GetOverlappedResult(reloader->directory, &overlapped, &bytes, TRUE);
+    }
+    CloseHandle(overlapped.hEvent);
+    return(0);
+}
+
+// NOTE: copy_dll_prefix is the copy path without ".dll", falls back to polling when this returns with enabled false
+static void
+WIN_init_reloader(WIN_Reloader *reloader, char *root_dir, char *source_dll, char *copy_dll_prefix){
+    snprintf(reloader->source_dll, sizeof(reloader->source_dll), "%s", source_dll);
+    snprintf(reloader->copy_dll_prefix, sizeof(reloader->copy_dll_prefix), "%s", copy_dll_prefix);
+
+    char directory[MAX_PATH];
+    cat_strings(root_dir, "build", directory);
+    reloader->directory = CreateFileA(directory, FILE_LIST_DIRECTORY, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, 0,
+                                      OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OVERLAPPED, 0);
+    if(reloader->directory == INVALID_HANDLE_VALUE){
+        // TODO: Logging
+        return;
+    }
+
+    reloader->quit_event = CreateEventA(0, TRUE, FALSE, 0);
+    if(reloader->quit_event){
+        reloader->thread = CreateThread(0, 0, WIN_reload_thread, reloader, 0, 0);
+    }
+    reloader->enabled = (reloader->thread != 0);
+}
+
+// NOTE: main thread, top of the frame, nothing of the old dll may be running anymore
+static void
+WIN_reload_swap(WIN_Reloader *reloader, WIN_GameCode *gamecode){
+    _ReadWriteBarrier();
+    WIN_unload_gamecode(gamecode);
+    *gamecode = reloader->prepared;
+    f64 latency_ms = 1000.0 * WIN_get_seconds_elapsed(reloader->last_change, WIN_get_clock());
+    _ReadWriteBarrier();
+    reloader->pending = false;
+    print("reload: game.dll swapped in %.1fms after its last write\n", latency_ms);
+}
+
+static void
+WIN_shutdown_reloader(WIN_Reloader *reloader){
+    if(reloader->enabled){
+        SetEvent(reloader->quit_event);
+        WaitForSingleObject(reloader->thread, INFINITE);
+        if(reloader->pending){
+            WIN_unload_gamecode(&reloader->prepared);
+            reloader->pending = false;
+        }
+        CloseHandle(reloader->directory);
+        reloader->enabled = false;
+    }
+}
+
+#define WIN_RELOAD_C
+#endif
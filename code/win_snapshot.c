@@ -0,0 +1,194 @@
+#if !defined(WIN_SNAPSHOT_C)
+
+// NOTE: incremental snapshots of game memory for the live loop replay.
+//
+// total_storage is allocated with MEM_WRITE_WATCH, so the kernel tracks which pages were written. At
+// every snapshot/restore the written pages are harvested into a per replay buffer "differs" bitmap, and
+// only those pages are copied. Replay buffers only reserve total_size up front, pages get committed the
+// first time they are snapshotted, so memory follows the working set instead of 4x total_size.
+//
+// A page that is set in differs may or may not actually differ, a page that is clear is identical in
+// the replay buffer and in game memory. Pages never committed in a replay buffer are all zero.
+//
+// The same harvest also feeds touched (every page ever written, so everything else is still zero) and
+// keyframe_dirty (written since the last replay keyframe, see win_recording.c).
+
+static void
+WIN_set_page_bit(ui64 *bitmap, ui64 page){
+    bitmap[page / 64] |= (1ULL << (page % 64));
+}
+
+static bool
+WIN_get_page_bit(ui64 *bitmap, ui64 page){
+    return((bitmap[page / 64] >> (page % 64)) & 1);
+}
+
+static void
+WIN_init_page_watch(WIN_State *state, GameMemory *game_memory, bool write_watch){
+    WIN_PageWatch *watch = &state->page_watch;
+
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    watch->base = game_memory->total_storage;
+    watch->size = game_memory->total_size;
+    watch->page_size = system_info.dwPageSize;
+    watch->page_count = (watch->size + watch->page_size - 1) / watch->page_size;
+    watch->bitmap_words = (watch->page_count + 63) / 64;
+    watch->write_watch = write_watch;
+
+    if(write_watch){
+        watch->addresses = (void **)VirtualAlloc(0, sizeof(void *) * watch->page_count, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+        if(!watch->addresses){
+            // TODO: Logging
+            watch->write_watch = false;
+        }
+    }
+
+    watch->touched = (ui64 *)VirtualAlloc(0, sizeof(ui64) * watch->bitmap_words * 2, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+    if(watch->touched){
+        watch->keyframe_dirty = watch->touched + watch->bitmap_words;
+    }
+    else{
+        // TODO: Logging
+    }
+
+    for(ui64 i=0; i<array_count(state->replay_buffers); ++i){
+        WIN_ReplayBuffer *replay_buffer = &state->replay_buffers[i];
+        replay_buffer->memory = VirtualAlloc(0, (size_t)watch->size, MEM_RESERVE, PAGE_READWRITE);
+        replay_buffer->committed = (ui64 *)VirtualAlloc(0, sizeof(ui64) * watch->bitmap_words * 2, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+        if(replay_buffer->memory && replay_buffer->committed){
+            replay_buffer->differs = replay_buffer->committed + watch->bitmap_words;
+        }
+        else{
+            //TODO: Logging
+            replay_buffer->memory = 0;
+        }
+    }
+}
+
+static void
+WIN_mark_written_pages(WIN_State *state, ui64 word, ui64 bits){
+    WIN_PageWatch *watch = &state->page_watch;
+    for(ui64 b=0; b<array_count(state->replay_buffers); ++b){
+        if(state->replay_buffers[b].memory){
+            state->replay_buffers[b].differs[word] |= bits;
+        }
+    }
+    if(watch->touched){
+        watch->touched[word] |= bits;
+        watch->keyframe_dirty[word] |= bits;
+    }
+}
+
+// NOTE: moves every page written since the last harvest into the differs bitmap of every replay buffer
+static void
+WIN_harvest_written_pages(WIN_State *state){
+    WIN_PageWatch *watch = &state->page_watch;
+
+    if(watch->write_watch){
+        ULONG_PTR count = (ULONG_PTR)watch->page_count;
+        DWORD granularity = 0;
+        if(GetWriteWatch(WRITE_WATCH_FLAG_RESET, watch->base, (SIZE_T)watch->size, watch->addresses, &count, &granularity) == 0){
+            for(ULONG_PTR i=0; i < count; ++i){
+                ui64 page = ((ui8 *)watch->addresses[i] - (ui8 *)watch->base) / watch->page_size;
+                WIN_mark_written_pages(state, page / 64, 1ULL << (page % 64));
+            }
+            return;
+        }
+        // TODO: Logging
+    }
+
+    // NOTE: no write watch, every page has to be assumed written
+    for(ui64 word=0; word < watch->bitmap_words; ++word){
+        ui64 bits = ~0ULL;
+        if((word + 1) * 64 > watch->page_count){
+            bits = (1ULL << (watch->page_count % 64)) - 1;
+        }
+        WIN_mark_written_pages(state, word, bits);
+    }
+}
+
+// NOTE: returns the number of pages copied
+static ui64
+WIN_snapshot_game_memory(WIN_State *state, int replay_index){
+    WIN_PageWatch *watch = &state->page_watch;
+    WIN_ReplayBuffer *replay_buffer = &state->replay_buffers[replay_index];
+    ui64 result = 0;
+
+    TIMED_BLOCK("snapshot_game_memory"){
+        WIN_harvest_written_pages(state);
+
+        for(ui64 word=0; word < watch->bitmap_words; ++word){
+            ui64 bits = replay_buffer->differs[word];
+            if(!bits){
+                continue;
+            }
+
+            // NOTE: commit the span of this word in one call, committing an already committed page is a no-op
+            ui64 first_page = word * 64;
+            ui64 page_count = (first_page + 64 > watch->page_count) ? (watch->page_count - first_page) : 64;
+            VirtualAlloc((ui8 *)replay_buffer->memory + (first_page * watch->page_size), (size_t)(page_count * watch->page_size), MEM_COMMIT, PAGE_READWRITE);
+
+            unsigned long bit;
+            while(_BitScanForward64(&bit, bits)){
+                bits &= bits - 1;
+                ui64 offset = (first_page + bit) * watch->page_size;
+                CopyMemory((ui8 *)replay_buffer->memory + offset, (ui8 *)watch->base + offset, watch->page_size);
+                ++result;
+            }
+
+            replay_buffer->committed[word] |= replay_buffer->differs[word];
+            replay_buffer->differs[word] = 0;
+        }
+        replay_buffer->has_snapshot = true;
+    }
+
+    return(result);
+}
+
+// NOTE: returns the number of pages copied
+static ui64
+WIN_restore_game_memory(WIN_State *state, int replay_index){
+    WIN_PageWatch *watch = &state->page_watch;
+    WIN_ReplayBuffer *replay_buffer = &state->replay_buffers[replay_index];
+    ui64 result = 0;
+
+    TIMED_BLOCK("restore_game_memory"){
+        WIN_harvest_written_pages(state);
+
+        for(ui64 word=0; word < watch->bitmap_words; ++word){
+            ui64 bits = replay_buffer->differs[word];
+            if(!bits){
+                continue;
+            }
+
+            unsigned long bit;
+            while(_BitScanForward64(&bit, bits)){
+                bits &= bits - 1;
+                ui64 page = (word * 64) + bit;
+                ui64 offset = page * watch->page_size;
+                if(WIN_get_page_bit(replay_buffer->committed, page)){
+                    CopyMemory((ui8 *)watch->base + offset, (ui8 *)replay_buffer->memory + offset, watch->page_size);
+                }
+                else{
+                    ZeroMemory((ui8 *)watch->base + offset, watch->page_size);
+                }
+                ++result;
+            }
+
+            // NOTE: the pages just restored now differ from every other replay buffer
+            WIN_mark_written_pages(state, word, replay_buffer->differs[word]);
+            replay_buffer->differs[word] = 0;
+        }
+
+        // NOTE: the restore itself wrote those pages, they are already accounted for above
+        if(watch->write_watch){
+            ResetWriteWatch(watch->base, (SIZE_T)watch->size);
+        }
+    }
+
+    return(result);
+}
+
+#define WIN_SNAPSHOT_C
+#endif
@@ -0,0 +1,148 @@
+#if !defined(WIN_TRACE_C)
+
+// NOTE: writes the per thread TraceEvent rings from profile.h out as chrome trace event json, which
+// chrome://tracing and ui.perfetto.dev both open directly.
+//
+//   win_platform.exe -trace                    writes build\trace.json on exit
+//   win_platform.exe -trace C:\tmp\run.json    writes to the given path
+//
+// Only the last TRACE_EVENTS_PER_THREAD events of every thread survive, older ones are overwritten.
+
+typedef struct WIN_TraceWriter{
+    HANDLE file;
+    ui32 used;
+    char buffer[Kilobytes(64)];
+} WIN_TraceWriter;
+
+typedef struct WIN_Trace{
+    bool enabled;
+    char file_name[MAX_PATH];
+    ui64 tsc_start;
+    LARGE_INTEGER qpc_start;
+} WIN_Trace;
+
+static void
+WIN_trace_flush(WIN_TraceWriter *writer){
+    if(writer->used){
+        DWORD bytes_written;
+        WriteFile(writer->file, writer->buffer, writer->used, &bytes_written, 0);
+        writer->used = 0;
+    }
+}
+
+static void
+WIN_trace_printf(WIN_TraceWriter *writer, char *format, ...){
+    if(writer->used + 512 > sizeof(writer->buffer)){
+        WIN_trace_flush(writer);
+    }
+
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(writer->buffer + writer->used, sizeof(writer->buffer) - writer->used, format, args);
+    va_end(args);
+
+    if(written > 0){
+        writer->used += written;
+    }
+}
+
+static void
+WIN_init_trace(WIN_Trace *trace, WIN_State *state, ProfileState *profile_state, char *cmd_line){
+    char *trace_arg = strstr(cmd_line, "-trace");
+    if(trace_arg && profile_state){
+        char path[MAX_PATH] = {0};
+        trace_arg += string_length("-trace");
+        if(parse_word(&trace_arg, path, sizeof(path)) && path[0] != '-'){
+            snprintf(trace->file_name, sizeof(trace->file_name), "%s", path);
+        }
+        else{
+            cat_strings(state->root_dir, "build\\trace.json", trace->file_name);
+        }
+
+        profile_state->trace_events = (TraceEvent *)VirtualAlloc(0, sizeof(TraceEvent) * PROFILE_MAX_THREADS * TRACE_EVENTS_PER_THREAD, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+        if(profile_state->trace_events){
+            snprintf(profile_state->names[PROFILE_FRAME_ID], sizeof(profile_state->names[PROFILE_FRAME_ID]), "frame");
+            trace->enabled = true;
+            trace->tsc_start = __rdtsc();
+            trace->qpc_start = WIN_get_clock();
+        }
+        else{
+            // TODO: Logging
+        }
+    }
+}
+
+static void
+WIN_write_trace(WIN_Trace *trace, ProfileState *profile_state){
+    if(!trace->enabled){
+        return;
+    }
+
+    // NOTE: rdtsc has no fixed unit, calibrate it against the performance counter over the whole run
+    ui64 tsc_end = __rdtsc();
+    f64 elapsed_microseconds = 1000000.0 * (f64)(WIN_get_clock().QuadPart - trace->qpc_start.QuadPart) / (f64)clock.frequency.QuadPart;
+    f64 tsc_per_microsecond = (elapsed_microseconds > 0.0) ? ((f64)(tsc_end - trace->tsc_start) / elapsed_microseconds) : 1.0;
+
+    WIN_TraceWriter *writer = (WIN_TraceWriter *)VirtualAlloc(0, sizeof(WIN_TraceWriter), MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+    if(!writer){
+        // TODO: Logging
+        return;
+    }
+
+    writer->file = CreateFileA(trace->file_name, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, 0, 0);
+    if(writer->file != INVALID_HANDLE_VALUE){
+        WIN_trace_printf(writer, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        WIN_trace_printf(writer, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"game\"}}");
+
+        ui64 event_count = 0;
+        i32 thread_count = profile_state->thread_count;
+        for(i32 i=0; i < thread_count && i < PROFILE_MAX_THREADS; ++i){
+            ProfileThreadTable *table = &profile_state->threads[i];
+            if(!table->trace_events){
+                continue;
+            }
+
+            ui64 first = 0;
+            if(table->trace_write_index > TRACE_EVENTS_PER_THREAD){
+                first = table->trace_write_index - TRACE_EVENTS_PER_THREAD;
+            }
+
+            // NOTE: once the ring wraps the oldest begins are gone, drop ends that have no begin left
+            i32 depth = 0;
+            for(ui64 index=first; index < table->trace_write_index; ++index){
+                TraceEvent *event = &table->trace_events[index & (TRACE_EVENTS_PER_THREAD - 1)];
+                char *phase = "i";
+                if(event->type == TRACE_BEGIN){
+                    phase = "B";
+                    ++depth;
+                }
+                else if(event->type == TRACE_END){
+                    if(depth == 0){
+                        continue;
+                    }
+                    phase = "E";
+                    --depth;
+                }
+
+                f64 timestamp = (f64)(event->timestamp - trace->tsc_start) / tsc_per_microsecond;
+                char *name = profile_state->names[event->id][0] ? profile_state->names[event->id] : "?";
+                WIN_trace_printf(writer, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%u%s}",
+                                 name, phase, timestamp, table->thread_id, (event->type == TRACE_INSTANT) ? ",\"s\":\"t\"" : "");
+                ++event_count;
+            }
+        }
+
+        WIN_trace_printf(writer, "\n]}\n");
+        WIN_trace_flush(writer);
+        CloseHandle(writer->file);
+        print("trace: wrote %llu events to %s\n", event_count, trace->file_name);
+    }
+    else{
+        // TODO: Logging
+    }
+
+    VirtualFree(writer, 0, MEM_RELEASE);
+}
+
+#define WIN_TRACE_C
+#endif
@@ -0,0 +1,239 @@
+#if !defined(WIN_VIDEO_C)
+
+// NOTE: video capture to a raw y4m stream that any encoder reads, e.g. ffmpeg -i capture.y4m out.mp4
+//
+//   win_platform.exe -video                    writes build\capture.y4m
+//   win_platform.exe -video C:\tmp\run.y4m     writes to the given path
+//   win_platform.exe -video -bt601             BT.601 instead of BT.709
+//
+// The thread that owns the finished RenderBuffer converts it to YUV 4:2:0 (yuv.h) with the widest SIMD
+// path the cpu has, split into row bands with VIDEO_MAX_BANDS - 1 helper threads so the conversion is
+// done before the buffer is touched again. Writing the file happens on a writer thread from
+// VIDEO_FRAME_COUNT frames, when both are still waiting on the disk the capture is dropped and counted
+// rather than stalling the frame.
+
+#define VIDEO_FRAME_COUNT 2
+#define VIDEO_MAX_BANDS 4
+
+typedef struct WIN_Video{
+    bool enabled;
+    bool volatile quit;
+    HANDLE file;
+
+    i32 width;
+    i32 height;
+    YuvCoefficients coefficients;
+    YuvPath path;
+    ui32 frame_size;
+    ui8 *frames[VIDEO_FRAME_COUNT];
+    HANDLE free_frames;
+    HANDLE ready_frames;
+    HANDLE writer_thread;
+    ui32 capture_index; // NOTE: capturing thread only
+    ui32 write_index;   // NOTE: writer thread only
+
+    // NOTE: the current conversion, band 0 is done by the capturing thread
+    ui32 band_count;
+    HANDLE band_threads[VIDEO_MAX_BANDS];
+    HANDLE band_start;
+    HANDLE band_done;
+    LONG volatile next_band;
+    RenderBuffer *band_source;
+    ui8 *band_dest;
+
+    ui64 captured;
+    ui64 dropped;
+    f64 convert_seconds;
+    f64 worst_convert_seconds;
+} WIN_Video;
+
+global WIN_Video video;
+
+static void
+WIN_video_convert_band(WIN_Video *video, ui32 band){
+    // NOTE: bands are whole row pairs
+    i32 pairs = video->height / 2;
+    i32 row_begin = 2 * (i32)((pairs * band) / video->band_count);
+    i32 row_end = 2 * (i32)((pairs * (band + 1)) / video->band_count);
+
+    ui8 *y_plane = video->band_dest;
+    ui8 *u_plane = y_plane + (video->width * video->height);
+    ui8 *v_plane = u_plane + ((video->width / 2) * (video->height / 2));
+    yuv420_convert_rows(&video->coefficients, video->path, (ui8 *)video->band_source->memory, video->band_source->pitch,
+                        video->width, y_plane, u_plane, v_plane, row_begin, row_end);
+}
+
+static DWORD WINAPI
+WIN_video_band_thread(LPVOID parameter){
+    WIN_Video *video = (WIN_Video *)parameter;
+    for(;;){
+        WaitForSingleObject(video->band_start, INFINITE);
+        if(video->quit){
+            break;
+        }
+        ui32 band = (ui32)InterlockedIncrement(&video->next_band);
+        WIN_video_convert_band(video, band);
+        ReleaseSemaphore(video->band_done, 1, 0);
+    }
+    return(0);
+}
+
+static DWORD WINAPI
+WIN_video_writer_thread(LPVOID parameter){
+    WIN_Video *video = (WIN_Video *)parameter;
+    for(;;){
+        WaitForSingleObject(video->ready_frames, INFINITE);
+        if(video->quit){
+            break;
+        }
+        ui8 *frame = video->frames[video->write_index++ % VIDEO_FRAME_COUNT];
+        DWORD bytes_written;
+        WriteFile(video->file, "FRAME\n", 6, &bytes_written, 0);
+        if(!WriteFile(video->file, frame, video->frame_size, &bytes_written, 0) || bytes_written != video->frame_size){
+            // TODO: Logging
+        }
+        ReleaseSemaphore(video->free_frames, 1, 0);
+    }
+    return(0);
+}
+
+static void
+WIN_init_video(WIN_Video *video, WIN_State *state, char *cmd_line, i32 width, i32 height, f32 seconds_per_frame){
+    char *video_arg = strstr(cmd_line, "-video");
+    if(!video_arg){
+        return;
+    }
+    if((width & 1) || (height & 1)){
+        print("video: 4:2:0 needs an even size, %dx%d\n", width, height);
+        return;
+    }
+
+    char file_name[MAX_PATH] = {0};
+    char path[MAX_PATH] = {0};
+    video_arg += string_length("-video");
+    if(parse_word(&video_arg, path, sizeof(path)) && path[0] != '-'){
+        snprintf(file_name, sizeof(file_name), "%s", path);
+    }
+    else{
+        cat_strings(state->root_dir, "build\\capture.y4m", file_name);
+    }
+
+    video->width = width;
+    video->height = height;
+    YuvMatrix matrix = strstr(cmd_line, "-bt601") ? YUV_BT601 : YUV_BT709;
+    video->coefficients = yuv_coefficients(matrix);
+    video->path = (simd_level() == SIMD_AVX2) ? YUV_PATH_AVX2 : YUV_PATH_SSE2;
+    video->frame_size = (width * height) + (2 * (width / 2) * (height / 2));
+
+    video->frames[0] = (ui8 *)VirtualAlloc(0, (size_t)video->frame_size * VIDEO_FRAME_COUNT, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+    if(!video->frames[0]){
+        // TODO: Logging
+        return;
+    }
+    for(ui32 i=1; i < VIDEO_FRAME_COUNT; ++i){
+        video->frames[i] = video->frames[0] + ((size_t)video->frame_size * i);
+    }
+
+    video->file = CreateFileA(file_name, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+    if(video->file == INVALID_HANDLE_VALUE){
+        print("video: could not create %s\n", file_name);
+        return;
+    }
+
+    char header[256];
+    ui32 fps = (ui32)((1.0f / seconds_per_frame) + 0.5f);
+    int header_size = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width, height, fps);
+    DWORD bytes_written;
+    WriteFile(video->file, header, header_size, &bytes_written, 0);
+
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    video->band_count = system_info.dwNumberOfProcessors / 2;
+    video->band_count = (video->band_count < 1) ? 1 : ((video->band_count > VIDEO_MAX_BANDS) ? VIDEO_MAX_BANDS : video->band_count);
+
+    video->free_frames = CreateSemaphoreA(0, VIDEO_FRAME_COUNT, VIDEO_FRAME_COUNT, 0);
+    video->ready_frames = CreateSemaphoreA(0, 0, VIDEO_FRAME_COUNT + 1, 0);
+    video->band_start = CreateSemaphoreA(0, 0, VIDEO_MAX_BANDS, 0);
+    video->band_done = CreateSemaphoreA(0, 0, VIDEO_MAX_BANDS, 0);
+    if(!video->free_frames || !video->ready_frames || !video->band_start || !video->band_done){
+        // TODO: Logging
+        return;
+    }
+    for(ui32 i=1; i < video->band_count; ++i){
+        video->band_threads[i] = CreateThread(0, 0, WIN_video_band_thread, video, 0, 0);
+        if(!video->band_threads[i]){
+            // NOTE: fewer bands, band_threads[1..band_count) stay valid
+            video->band_count = i;
+            break;
+        }
+    }
+    video->writer_thread = CreateThread(0, 0, WIN_video_writer_thread, video, 0, 0);
+    video->enabled = (video->writer_thread != 0);
+
+    char *path_names[] = {"scalar", "sse2", "avx2"};
+    print("video: %dx%d@%u %s to %s, %s in %u bands\n", width, height, fps, (matrix == YUV_BT709) ? "bt709" : "bt601",
+          file_name, path_names[video->path], video->band_count);
+}
+
+// NOTE: call once per finished frame from the thread that owns buffer, returns before buffer is touched
+// again. Never waits on the disk.
+static void
+WIN_video_capture(WIN_Video *video, RenderBuffer *buffer){
+    if(!video->enabled){
+        return;
+    }
+    if(WaitForSingleObject(video->free_frames, 0) != WAIT_OBJECT_0){
+        ++video->dropped;
+        return;
+    }
+
+    TIMED_BLOCK("video_capture"){
+        LARGE_INTEGER start = WIN_get_clock();
+        video->band_source = buffer;
+        video->band_dest = video->frames[video->capture_index++ % VIDEO_FRAME_COUNT];
+        video->next_band = 0;
+        if(video->band_count > 1){
+            ReleaseSemaphore(video->band_start, video->band_count - 1, 0);
+        }
+        WIN_video_convert_band(video, 0);
+        for(ui32 i=1; i < video->band_count; ++i){
+            WaitForSingleObject(video->band_done, INFINITE);
+        }
+        ReleaseSemaphore(video->ready_frames, 1, 0);
+
+        f64 seconds = WIN_get_seconds_elapsed(start, WIN_get_clock());
+        video->convert_seconds += seconds;
+        if(seconds > video->worst_convert_seconds){
+            video->worst_convert_seconds = seconds;
+        }
+        ++video->captured;
+    }
+}
+
+static void
+WIN_shutdown_video(WIN_Video *video){
+    if(!video->enabled){
+        return;
+    }
+
+    // NOTE: let the writer finish every frame, then wake everyone up to quit
+    for(ui32 i=0; i < VIDEO_FRAME_COUNT; ++i){
+        WaitForSingleObject(video->free_frames, INFINITE);
+    }
+    video->quit = true;
+    ReleaseSemaphore(video->ready_frames, 1, 0);
+    WaitForSingleObject(video->writer_thread, INFINITE);
+    if(video->band_count > 1){
+        ReleaseSemaphore(video->band_start, video->band_count - 1, 0);
+        WaitForMultipleObjects(video->band_count - 1, video->band_threads + 1, TRUE, INFINITE);
+    }
+    CloseHandle(video->file);
+    video->enabled = false;
+
+    f64 average_ms = video->captured ? (1000.0 * video->convert_seconds / (f64)video->captured) : 0.0;
+    print("video: %llu frames, %llu dropped, convert %.3fms average %.3fms worst\n",
+          video->captured, video->dropped, average_ms, 1000.0 * video->worst_convert_seconds);
+}
+
+#define WIN_VIDEO_C
+#endif
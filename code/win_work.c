@@ -0,0 +1,125 @@
+#if !defined(WIN_WORK_C)
+
+// NOTE: worker threads behind GameMemory.parallel_for. The calling thread takes indices too, so with
+// WORK_MAX_THREADS - 1 helpers a parallel_for runs on up to WORK_MAX_THREADS cores. Indices are handed
+// out one at a time with an interlocked increment, a few expensive indices next to cheap ones (tiles full
+// of particles next to empty sky) even themselves out. One parallel_for runs at a time, a second caller
+// (the render thread while the main thread seeks) waits for the first to finish.
+
+#define WORK_MAX_THREADS 16
+
+typedef struct WIN_WorkPool{
+    bool enabled;
+    bool volatile quit;
+    ui32 thread_count; // NOTE: helpers plus the calling thread
+    HANDLE threads[WORK_MAX_THREADS];
+    HANDLE start;
+    HANDLE done;
+    CRITICAL_SECTION lock;
+
+    // NOTE: the current parallel_for, written before start is released
+    WorkFunction *work;
+    void *data;
+    ui32 count;
+    LONG volatile next_index;
+} WIN_WorkPool;
+
+global WIN_WorkPool work_pool;
+
+static void
+WIN_work_run(WIN_WorkPool *pool){
+    for(;;){
+        ui32 index = (ui32)InterlockedIncrement(&pool->next_index) - 1;
+        if(index >= pool->count){
+            break;
+        }
+        pool->work(pool->data, index);
+    }
+}
+
+static DWORD WINAPI
+WIN_work_thread(LPVOID parameter){
+    WIN_WorkPool *pool = (WIN_WorkPool *)parameter;
+    for(;;){
+        WaitForSingleObject(pool->start, INFINITE);
+        if(pool->quit){
+            break;
+        }
+        WIN_work_run(pool);
+        ReleaseSemaphore(pool->done, 1, 0);
+    }
+    return(0);
+}
+
+static PARALLEL_FOR(WIN_parallel_for){
+    WIN_WorkPool *pool = &work_pool;
+    if(!pool->enabled || count < 2){
+        for(ui32 i=0; i < count; ++i){
+            work(data, i);
+        }
+        return;
+    }
+
+    EnterCriticalSection(&pool->lock);
+    pool->work = work;
+    pool->data = data;
+    pool->count = count;
+    pool->next_index = 0;
+
+    ui32 helpers = pool->thread_count - 1;
+    helpers = (helpers > count - 1) ? count - 1 : helpers;
+    ReleaseSemaphore(pool->start, helpers, 0);
+    WIN_work_run(pool);
+    for(ui32 i=0; i < helpers; ++i){
+        WaitForSingleObject(pool->done, INFINITE);
+    }
+    LeaveCriticalSection(&pool->lock);
+}
+
+// NOTE: one thread per logical core, the cores also run the main, render and present threads but those
+// are blocked while their parallel_for runs
+static void
+WIN_init_work_pool(WIN_WorkPool *pool){
+    SYSTEM_INFO system_info;
+    GetSystemInfo(&system_info);
+    ui32 thread_count = system_info.dwNumberOfProcessors;
+    thread_count = (thread_count > WORK_MAX_THREADS) ? WORK_MAX_THREADS : thread_count;
+    if(thread_count < 2){
+        return;
+    }
+
+    InitializeCriticalSection(&pool->lock);
+    pool->start = CreateSemaphoreA(0, 0, WORK_MAX_THREADS, 0);
+    pool->done = CreateSemaphoreA(0, 0, WORK_MAX_THREADS, 0);
+    if(!pool->start || !pool->done){
+        // TODO: Logging
+        return;
+    }
+    pool->thread_count = 1;
+    for(ui32 i=1; i < thread_count; ++i){
+        pool->threads[i] = CreateThread(0, 0, WIN_work_thread, pool, 0, 0);
+        if(!pool->threads[i]){
+            // NOTE: fewer helpers, threads[1..thread_count) stay valid
+            break;
+        }
+        ++pool->thread_count;
+    }
+    pool->enabled = (pool->thread_count > 1);
+}
+
+static void
+WIN_shutdown_work_pool(WIN_WorkPool *pool){
+    if(!pool->enabled){
+        return;
+    }
+
+    EnterCriticalSection(&pool->lock);
+    pool->enabled = false;
+    pool->quit = true;
+    ReleaseSemaphore(pool->start, pool->thread_count - 1, 0);
+    WaitForMultipleObjects(pool->thread_count - 1, pool->threads + 1, TRUE, INFINITE);
+    LeaveCriticalSection(&pool->lock);
+}
+
+#define WIN_WORK_C
+#endif
@@ -0,0 +1,229 @@
+#if !defined(YUV_H)
+
+// NOTE: 0x00RRGGBB -> planar YUV 4:2:0 (limited range, chroma centered between the 2x2 block like
+// y4m's C420jpeg), BT.601 or BT.709. No platform calls, the caller picks the path and splits the image
+// into bands of even rows however it likes.
+//
+// All three paths do exactly the same fixed point math so they produce identical bytes: every channel
+// is scaled to 8.7 (chroma sums of 4 pixels to 10.5, same scale), multiplied by a 1.15 coefficient
+// keeping the high 16 bits (_mm_mulhi_epi16), the three terms are summed in 10.6 and rounded.
+
+#include "simd.h"
+
+typedef enum{YUV_BT601, YUV_BT709} YuvMatrix;
+typedef enum{YUV_PATH_SCALAR, YUV_PATH_SSE2, YUV_PATH_AVX2} YuvPath;
+
+typedef struct YuvCoefficients{
+    i16 y[3]; // NOTE: r, g, b in 1.15
+    i16 u[3];
+    i16 v[3];
+} YuvCoefficients;
+
+#define YUV_Y_OFFSET ((16 << 6) + 32)
+#define YUV_C_OFFSET ((128 << 6) + 32)
+
+static i16
+yuv_fixed(f32 value){
+    return((i16)(value * 32768.0f + (value < 0 ? -0.5f : 0.5f)));
+}
+
+static YuvCoefficients
+yuv_coefficients(YuvMatrix matrix){
+    f32 kr = (matrix == YUV_BT709) ? 0.2126f : 0.299f;
+    f32 kb = (matrix == YUV_BT709) ? 0.0722f : 0.114f;
+    f32 kg = 1.0f - kr - kb;
+    f32 y_scale = 219.0f / 255.0f;
+    f32 c_scale = 224.0f / 255.0f;
+
+    YuvCoefficients result;
+    result.y[0] = yuv_fixed(y_scale * kr);
+    result.y[1] = yuv_fixed(y_scale * kg);
+    result.y[2] = yuv_fixed(y_scale * kb);
+    result.u[0] = yuv_fixed(c_scale * -kr / (2.0f * (1.0f - kb)));
+    result.u[1] = yuv_fixed(c_scale * -kg / (2.0f * (1.0f - kb)));
+    result.u[2] = yuv_fixed(c_scale * 0.5f);
+    result.v[0] = yuv_fixed(c_scale * 0.5f);
+    result.v[1] = yuv_fixed(c_scale * -kg / (2.0f * (1.0f - kr)));
+    result.v[2] = yuv_fixed(c_scale * -kb / (2.0f * (1.0f - kr)));
+    return(result);
+}
+
+static ui8
+yuv_clamp(i32 value){
+    return((ui8)(value < 0 ? 0 : (value > 255 ? 255 : value)));
+}
+
+// NOTE: r, g, b in 8.7 (pixel << 7 or sum of 4 pixels << 5), matches _mm_mulhi_epi16 which floors
+static ui8
+yuv_dot(i16 *coefficients, i32 r, i32 g, i32 b, i32 offset){
+    i32 sum = ((r * coefficients[0]) >> 16) + ((g * coefficients[1]) >> 16) + ((b * coefficients[2]) >> 16);
+    return(yuv_clamp((sum + offset) >> 6));
+}
+
+static void
+yuv420_scalar(YuvCoefficients *c, ui32 *row0, ui32 *row1, ui8 *y0, ui8 *y1, ui8 *u, ui8 *v, i32 begin, i32 end){
+    for(i32 x=begin; x < end; x += 2){
+        ui32 p[4] = {row0[x], row0[x + 1], row1[x], row1[x + 1]};
+        i32 r = 0;
+        i32 g = 0;
+        i32 b = 0;
+        for(i32 i=0; i < 4; ++i){
+            i32 pr = (p[i] >> 16) & 0xFF;
+            i32 pg = (p[i] >> 8) & 0xFF;
+            i32 pb = p[i] & 0xFF;
+            ui8 *y = (i < 2) ? y0 : y1;
+            y[x + (i & 1)] = yuv_dot(c->y, pr << 7, pg << 7, pb << 7, YUV_Y_OFFSET);
+            r += pr;
+            g += pg;
+            b += pb;
+        }
+        u[x >> 1] = yuv_dot(c->u, r << 5, g << 5, b << 5, YUV_C_OFFSET);
+        v[x >> 1] = yuv_dot(c->v, r << 5, g << 5, b << 5, YUV_C_OFFSET);
+    }
+}
+
+// NOTE: one channel of 8 pixels as 8 x i16
+static __m128i
+yuv_sse2_channel(__m128i p0, __m128i p1, int shift){
+    __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i a = _mm_and_si128(_mm_srli_epi32(p0, shift), mask);
+    __m128i b = _mm_and_si128(_mm_srli_epi32(p1, shift), mask);
+    return(_mm_packs_epi32(a, b));
+}
+
+static __m128i
+yuv_sse2_dot(i16 *coefficients, __m128i r, __m128i g, __m128i b, i32 offset){
+    __m128i sum = _mm_add_epi16(_mm_mulhi_epi16(r, _mm_set1_epi16(coefficients[0])),
+                                _mm_mulhi_epi16(g, _mm_set1_epi16(coefficients[1])));
+    sum = _mm_add_epi16(sum, _mm_mulhi_epi16(b, _mm_set1_epi16(coefficients[2])));
+    return(_mm_srai_epi16(_mm_add_epi16(sum, _mm_set1_epi16((i16)offset)), 6));
+}
+
+// NOTE: 16 pixels of two rows -> 2 x 16 luma, 8 u, 8 v
+static i32
+yuv420_sse2(YuvCoefficients *c, ui32 *row0, ui32 *row1, ui8 *y0, ui8 *y1, ui8 *u, ui8 *v, i32 end){
+    __m128i ones = _mm_set1_epi16(1);
+    i32 x = 0;
+    for(; x + 16 <= end; x += 16){
+        __m128i sums[3][2];
+        for(i32 i=0; i < 3; ++i){
+            sums[i][0] = sums[i][1] = _mm_setzero_si128();
+        }
+        for(i32 row=0; row < 2; ++row){
+            ui32 *src = row ? row1 : row0;
+            ui8 *y = row ? y1 : y0;
+            __m128i luma[2];
+            for(i32 half=0; half < 2; ++half){
+                __m128i p0 = _mm_loadu_si128((__m128i *)(src + x + (half * 8)));
+                __m128i p1 = _mm_loadu_si128((__m128i *)(src + x + (half * 8) + 4));
+                __m128i r = yuv_sse2_channel(p0, p1, 16);
+                __m128i g = yuv_sse2_channel(p0, p1, 8);
+                __m128i b = yuv_sse2_channel(p0, p1, 0);
+                luma[half] = yuv_sse2_dot(c->y, _mm_slli_epi16(r, 7), _mm_slli_epi16(g, 7), _mm_slli_epi16(b, 7), YUV_Y_OFFSET);
+                sums[0][half] = _mm_add_epi16(sums[0][half], r);
+                sums[1][half] = _mm_add_epi16(sums[1][half], g);
+                sums[2][half] = _mm_add_epi16(sums[2][half], b);
+            }
+            _mm_storeu_si128((__m128i *)(y + x), _mm_packus_epi16(luma[0], luma[1]));
+        }
+
+        // NOTE: add horizontal pairs, 4 pixel sums in 10.5
+        __m128i rgb[3];
+        for(i32 i=0; i < 3; ++i){
+            rgb[i] = _mm_slli_epi16(_mm_packs_epi32(_mm_madd_epi16(sums[i][0], ones), _mm_madd_epi16(sums[i][1], ones)), 5);
+        }
+        __m128i uv = _mm_packus_epi16(yuv_sse2_dot(c->u, rgb[0], rgb[1], rgb[2], YUV_C_OFFSET),
+                                      yuv_sse2_dot(c->v, rgb[0], rgb[1], rgb[2], YUV_C_OFFSET));
+        _mm_storel_epi64((__m128i *)(u + (x >> 1)), uv);
+        _mm_storel_epi64((__m128i *)(v + (x >> 1)), _mm_srli_si128(uv, 8));
+    }
+    return(x);
+}
+
+// NOTE: one channel of 16 pixels as 16 x i16, pack works per 128 bit lane so put the quads back in order
+SIMD_TARGET_AVX2 static __m256i
+yuv_avx2_channel(__m256i p0, __m256i p1, int shift){
+    __m256i mask = _mm256_set1_epi32(0xFF);
+    __m256i a = _mm256_and_si256(_mm256_srli_epi32(p0, shift), mask);
+    __m256i b = _mm256_and_si256(_mm256_srli_epi32(p1, shift), mask);
+    return(_mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8));
+}
+
+SIMD_TARGET_AVX2 static __m256i
+yuv_avx2_dot(i16 *coefficients, __m256i r, __m256i g, __m256i b, i32 offset){
+    __m256i sum = _mm256_add_epi16(_mm256_mulhi_epi16(r, _mm256_set1_epi16(coefficients[0])),
+                                   _mm256_mulhi_epi16(g, _mm256_set1_epi16(coefficients[1])));
+    sum = _mm256_add_epi16(sum, _mm256_mulhi_epi16(b, _mm256_set1_epi16(coefficients[2])));
+    return(_mm256_srai_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16((i16)offset)), 6));
+}
+
+// NOTE: 32 pixels of two rows -> 2 x 32 luma, 16 u, 16 v
+SIMD_TARGET_AVX2 static i32
+yuv420_avx2(YuvCoefficients *c, ui32 *row0, ui32 *row1, ui8 *y0, ui8 *y1, ui8 *u, ui8 *v, i32 end){
+    __m256i ones = _mm256_set1_epi16(1);
+    i32 x = 0;
+    for(; x + 32 <= end; x += 32){
+        __m256i sums[3][2];
+        for(i32 i=0; i < 3; ++i){
+            sums[i][0] = sums[i][1] = _mm256_setzero_si256();
+        }
+        for(i32 row=0; row < 2; ++row){
+            ui32 *src = row ? row1 : row0;
+            ui8 *y = row ? y1 : y0;
+            __m256i luma[2];
+            for(i32 half=0; half < 2; ++half){
+                __m256i p0 = _mm256_loadu_si256((__m256i *)(src + x + (half * 16)));
+                __m256i p1 = _mm256_loadu_si256((__m256i *)(src + x + (half * 16) + 8));
+                __m256i r = yuv_avx2_channel(p0, p1, 16);
+                __m256i g = yuv_avx2_channel(p0, p1, 8);
+                __m256i b = yuv_avx2_channel(p0, p1, 0);
+                luma[half] = yuv_avx2_dot(c->y, _mm256_slli_epi16(r, 7), _mm256_slli_epi16(g, 7), _mm256_slli_epi16(b, 7), YUV_Y_OFFSET);
+                sums[0][half] = _mm256_add_epi16(sums[0][half], r);
+                sums[1][half] = _mm256_add_epi16(sums[1][half], g);
+                sums[2][half] = _mm256_add_epi16(sums[2][half], b);
+            }
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(luma[0], luma[1]), 0xD8);
+            _mm256_storeu_si256((__m256i *)(y + x), packed);
+        }
+
+        __m256i rgb[3];
+        for(i32 i=0; i < 3; ++i){
+            __m256i pairs = _mm256_packs_epi32(_mm256_madd_epi16(sums[i][0], ones), _mm256_madd_epi16(sums[i][1], ones));
+            rgb[i] = _mm256_slli_epi16(_mm256_permute4x64_epi64(pairs, 0xD8), 5);
+        }
+        __m256i uv = _mm256_packus_epi16(yuv_avx2_dot(c->u, rgb[0], rgb[1], rgb[2], YUV_C_OFFSET),
+                                         yuv_avx2_dot(c->v, rgb[0], rgb[1], rgb[2], YUV_C_OFFSET));
+        uv = _mm256_permute4x64_epi64(uv, 0xD8);
+        _mm_storeu_si128((__m128i *)(u + (x >> 1)), _mm256_castsi256_si128(uv));
+        _mm_storeu_si128((__m128i *)(v + (x >> 1)), _mm256_extracti128_si256(uv, 1));
+    }
+    return(x);
+}
+
+// NOTE: converts rows [row_begin, row_end) of an even sized image, row_begin and row_end must be even.
+// The planes are tightly packed: y is width * height, u and v (width / 2) * (height / 2).
+static void
+yuv420_convert_rows(YuvCoefficients *c, YuvPath path, ui8 *src, i32 src_pitch, i32 width,
+                    ui8 *y_plane, ui8 *u_plane, ui8 *v_plane, i32 row_begin, i32 row_end){
+    i32 chroma_width = width >> 1;
+    for(i32 row=row_begin; row < row_end; row += 2){
+        ui32 *row0 = (ui32 *)(src + ((i64)row * src_pitch));
+        ui32 *row1 = (ui32 *)(src + ((i64)(row + 1) * src_pitch));
+        ui8 *y0 = y_plane + ((i64)row * width);
+        ui8 *y1 = y0 + width;
+        ui8 *u = u_plane + ((i64)(row >> 1) * chroma_width);
+        ui8 *v = v_plane + ((i64)(row >> 1) * chroma_width);
+
+        i32 x = 0;
+        if(path == YUV_PATH_AVX2){
+            x = yuv420_avx2(c, row0, row1, y0, y1, u, v, width);
+        }
+        if(path >= YUV_PATH_SSE2){
+            x += yuv420_sse2(c, row0 + x, row1 + x, y0 + x, y1 + x, u + (x >> 1), v + (x >> 1), width - x);
+        }
+        yuv420_scalar(c, row0, row1, y0, y1, u, v, x, width);
+    }
+}
+
+#define YUV_H
+#endif
@@ -0,0 +1,6 @@
+@echo off
+
+rem golden image regression check, see code\win_golden.c
+pushd ..\build
+call win_platform.exe -golden %*
+popd